@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "plugin.h"
+#include "affinity.h"
+#include "float_mode.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace {
+	/// <summary>
+	/// CPU counters of one thread, written only by that thread and read by GetThreadCpuStats without stopping it.
+	/// </summary>
+	struct ThreadEntry {
+		uint32_t thread_id = 0;
+		int is_worker = 0;
+		std::atomic<int> last_cpu{ -1 };
+		std::atomic<int> cpu_changes{ 0 };
+		std::atomic<long long> samples{ 0 };
+	};
+
+	std::mutex registry_mutex;                 // Guards registry; sampling itself takes no lock
+	std::vector<ThreadEntry*> registry;        // Every live thread that has called into the plugin
+	thread_local bool is_worker_thread = false;
+	std::atomic<unsigned> options_generation{ 0 };   // Incremented by workerOptionsChanged
+	thread_local unsigned applied_generation = 0;     // options_generation when the calling worker last applied the options
+	thread_local bool worker_pinned = false;          // Whether the calling worker is restricted to worker_cpus
+
+	/// <summary>
+	/// Adds the owning thread's entry to the registry and removes it when the thread exits.
+	/// </summary>
+	struct ThreadRegistration {
+		ThreadEntry entry;
+
+		ThreadRegistration() {
+			entry.thread_id = GetCurrentThreadId();
+			entry.is_worker = is_worker_thread ? 1 : 0;
+			std::lock_guard<std::mutex> lock(registry_mutex);
+			registry.push_back(&entry);
+		}
+
+		~ThreadRegistration() {
+			std::lock_guard<std::mutex> lock(registry_mutex);
+			registry.erase(std::find(registry.begin(), registry.end(), &entry));
+		}
+	};
+
+	/// <summary>
+	/// Get the calling thread's entry, registering it on first use.
+	/// </summary>
+	ThreadEntry& currentEntry() {
+		thread_local ThreadRegistration registration;
+		return registration.entry;
+	}
+
+	/// <summary>
+	/// Apply the loaded model's worker options to the calling worker thread.
+	/// </summary>
+	void applyWorkerOptions() {
+		// Read the generation first, so a model published while this runs is picked up by the next refresh
+		applied_generation = options_generation.load();
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		LoadOptions options = model ? model->options : LoadOptions();
+
+		if (pinCurrentThread(options.worker_cpus)) {
+			worker_pinned = true;
+		}
+		else if (worker_pinned) {
+			// The new model has no worker_cpus; let the thread run anywhere the process may
+			DWORD_PTR process_mask, system_mask;
+			if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) SetThreadAffinityMask(GetCurrentThread(), process_mask);
+			worker_pinned = false;
+		}
+		setDenormalsAsZero(options.denormals_as_zero);
+	}
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+	if (cpus.empty()) return false;
+
+	// A thread's affinity is limited to a single processor group
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = static_cast<WORD>(cpus[0] / 64);
+	for (int cpu : cpus) {
+		if (cpu / 64 == affinity.Group) affinity.Mask |= static_cast<ULONG_PTR>(1) << (cpu % 64);
+	}
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+std::string ortThreadAffinities(const std::vector<int>& cpus) {
+	std::string affinities;
+	for (size_t i = 0; i < cpus.size(); i++) {
+		if (i > 0) affinities += ';';
+		affinities += std::to_string(cpus[i] + 1);
+	}
+	return affinities;
+}
+
+void initWorkerThread() {
+	is_worker_thread = true;
+	applyWorkerOptions();
+	sampleThreadCpu();
+}
+
+void refreshWorkerThread() {
+	if (is_worker_thread && applied_generation != options_generation.load(std::memory_order_relaxed)) applyWorkerOptions();
+}
+
+void workerOptionsChanged() {
+	options_generation++;
+}
+
+void sampleThreadCpu() {
+	ThreadEntry& entry = currentEntry();
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+	int cpu = processor.Group * 64 + processor.Number;
+
+	// Only this thread writes last_cpu, so a relaxed read sees its own latest value
+	int last_cpu = entry.last_cpu.load(std::memory_order_relaxed);
+	if (last_cpu >= 0 && last_cpu != cpu) entry.cpu_changes.fetch_add(1, std::memory_order_relaxed);
+	entry.last_cpu.store(cpu, std::memory_order_relaxed);
+	entry.samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" {
+	/// <summary>
+	/// Report the processor each live plugin worker and caller thread last ran on. Threads that have exited are dropped.
+	/// </summary>
+	/// <param name="stats">Array receiving up to max_threads entries.</param>
+	/// <param name="max_threads">Capacity of the stats array.</param>
+	/// <returns>The number of threads seen, which may exceed max_threads.</returns>
+	DLLExport int GetThreadCpuStats(ThreadCpuStats* stats, int max_threads) {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		for (int i = 0; i < max_threads && i < static_cast<int>(registry.size()); i++) {
+			const ThreadEntry& entry = *registry[i];
+			stats[i].thread_id = entry.thread_id;
+			stats[i].is_worker = entry.is_worker;
+			stats[i].last_cpu = entry.last_cpu.load(std::memory_order_relaxed);
+			stats[i].cpu_changes = entry.cpu_changes.load(std::memory_order_relaxed);
+			stats[i].samples = entry.samples.load(std::memory_order_relaxed);
+		}
+		return static_cast<int>(registry.size());
+	}
+
+	/// <summary>
+	/// Reset the processor change and sample counters of every recorded thread, e.g., after changing the affinity load options.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void ResetThreadCpuStats() {
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		for (ThreadEntry* entry : registry) {
+			entry->cpu_changes = 0;
+			entry->samples = 0;
+		}
+	}
+}
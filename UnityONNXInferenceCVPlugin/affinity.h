@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// CPU placement of one thread that has called into the plugin.
+/// </summary>
+struct ThreadCpuStats {
+	uint32_t thread_id;               // Operating system thread ID
+	int is_worker;                    // 1 for threads created by the plugin, 0 for caller threads (e.g., Unity's)
+	int last_cpu;                     // Logical processor the thread last ran on
+	int cpu_changes;                  // Number of times the observed processor changed
+	long long samples;                // Number of times the processor was sampled
+};
+
+/// <summary>
+/// Restrict the calling thread to a set of logical processors. All processors must be in the same
+/// processor group as the first one (groups hold up to 64 processors); others are ignored.
+/// </summary>
+/// <param name="cpus">Zero-based logical processor indices. An empty set leaves the affinity unchanged.</param>
+/// <returns>True if the affinity was applied.</returns>
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+/// <summary>
+/// Build an ONNX Runtime intra_op_thread_affinities value that pins one intra-op thread to each processor.
+/// </summary>
+/// <param name="cpus">Zero-based logical processor indices.</param>
+/// <returns>The affinity string, using ONNX Runtime's one-based processor IDs.</returns>
+std::string ortThreadAffinities(const std::vector<int>& cpus);
+
+/// <summary>
+/// Prepare a thread created by the plugin: apply the worker_cpus and denormals_as_zero load options
+/// and register the thread for CPU reporting.
+/// </summary>
+void initWorkerThread();
+
+/// <summary>
+/// Reapply the loaded model's worker_cpus and denormals_as_zero options on a thread prepared with
+/// initWorkerThread, if a model has been published since the thread last applied them. Long-lived
+/// workers call it before each task; it costs one atomic load when nothing changed.
+/// </summary>
+void refreshWorkerThread();
+
+/// <summary>
+/// Make long-lived workers reapply the worker load options before their next task. Called whenever a model is published.
+/// </summary>
+void workerOptionsChanged();
+
+/// <summary>
+/// Record which processor the calling thread is running on, for GetThreadCpuStats. Takes no lock after the
+/// thread's first call.
+/// </summary>
+void sampleThreadCpu();
@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "alloc_count.h"
+
+#ifdef PLUGIN_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	std::atomic<bool> counting{ false };
+	std::atomic<long long> allocation_count{ 0 };
+}
+
+void beginAllocationCount() {
+	allocation_count = 0;
+	counting = true;
+}
+
+long long endAllocationCount() {
+	counting = false;
+	return allocation_count;
+}
+
+// Replacements for the plugin's global operator new and delete; the array and nothrow forms forward to these
+void* operator new(size_t size) {
+	if (counting.load(std::memory_order_relaxed)) allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+#else
+void beginAllocationCount() {
+}
+
+long long endAllocationCount() {
+	return -1;
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+/// <summary>
+/// Start counting calls to operator new made by the plugin's code, on any thread. Counting is built only
+/// into configurations that define PLUGIN_COUNT_ALLOCATIONS (the Debug builds), so shipping builds keep
+/// the default operator new. Allocations made inside ONNX Runtime's own module or with malloc are not seen.
+/// </summary>
+void beginAllocationCount();
+
+/// <summary>
+/// Stop counting allocations.
+/// </summary>
+/// <returns>The number of allocations since beginAllocationCount, or -1 if counting is not built in.</returns>
+long long endAllocationCount();
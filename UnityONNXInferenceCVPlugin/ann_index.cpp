@@ -0,0 +1,585 @@
+#include "pch.h"
+#include "plugin.h"
+#include "ann_index.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define ANN_USE_AVX2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define ANN_USE_NEON
+#endif
+
+namespace {
+	const uint32_t code_alignment = 32;       // Code bytes per SIMD step; codes are zero-padded to a multiple of it
+	const uint64_t section_alignment = 64;    // Sections of index files start on cache lines
+	const int max_node_level = 15;            // Levels are stored in a byte; 15 covers far more nodes than uint32 indices
+	const uint32_t no_upper_links = 0xFFFFFFFFu;
+
+	/// <summary>
+	/// Dot product of two int8 codes padded to a multiple of 32 bytes.
+	/// </summary>
+	int32_t dotCodes(const int8_t* a, const int8_t* b, uint32_t stride) {
+#if defined(ANN_USE_AVX2)
+		if (cpuHasAvx2()) {
+			// Widen 16 bytes at a time to int16, then multiply and add pairs into int32 lanes
+			__m256i acc = _mm256_setzero_si256();
+			for (uint32_t i = 0; i < stride; i += 16) {
+				__m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+				__m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+				acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+			}
+			__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+			return _mm_cvtsi128_si32(sum);
+		}
+#elif defined(ANN_USE_NEON)
+		int32x4_t acc = vdupq_n_s32(0);
+		for (uint32_t i = 0; i < stride; i += 16) {
+			int8x16_t va = vld1q_s8(a + i);
+			int8x16_t vb = vld1q_s8(b + i);
+			acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+			acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+		}
+		return vaddvq_s32(acc);
+#endif
+		int32_t sum = 0;
+		for (uint32_t i = 0; i < stride; i++) sum += a[i] * b[i];
+		return sum;
+	}
+
+	/// <summary>
+	/// Marks the nodes a search has visited. Each search takes a new generation, so the marks never need clearing.
+	/// </summary>
+	struct VisitedSet {
+		std::vector<uint32_t> marks;
+		uint32_t generation = 0;
+
+		void Begin(uint64_t node_count) {
+			if (marks.size() < node_count) marks.resize(static_cast<size_t>(node_count), 0);
+			if (++generation == 0) {
+				std::fill(marks.begin(), marks.end(), 0);
+				generation = 1;
+			}
+		}
+
+		/// <returns>True if the node had not been visited yet.</returns>
+		bool Visit(uint32_t node) {
+			if (marks[node] == generation) return false;
+			marks[node] = generation;
+			return true;
+		}
+	};
+
+	thread_local VisitedSet visited;
+
+	/// <summary>
+	/// Round up to a multiple of an alignment.
+	/// </summary>
+	uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+AnnIndex::AnnIndex(int max_links, int ef_construction)
+	: max_links(static_cast<uint32_t>(std::max(max_links, 2))),
+	ef_construction(static_cast<uint32_t>(std::max(ef_construction, 1))),
+	level_multiplier(1.0 / std::log(static_cast<double>(std::max(max_links, 2)))),
+	level_generator(42) {}
+
+const uint32_t* AnnIndex::links(uint32_t node, int level) const {
+	if (level == 0) return base_links + static_cast<size_t>(node) * baseLinkStride();
+	return upper_links + upper_starts[node] + static_cast<size_t>(level - 1) * upperLinkStride();
+}
+
+uint32_t* AnnIndex::mutableLinks(uint32_t node, int level) {
+	// Only called once the index owns its sections
+	return const_cast<uint32_t*>(links(node, level));
+}
+
+float AnnIndex::similarity(const int8_t* query_code, float query_scale, uint32_t node) const {
+	return query_scale * scales[node] * static_cast<float>(dotCodes(query_code, code(node), code_stride));
+}
+
+float AnnIndex::nodeSimilarity(uint32_t a, uint32_t b) const {
+	return similarity(code(a), scales[a], b);
+}
+
+void AnnIndex::quantize(const float* embedding, int8_t* code_out, float& scale) const {
+	// Symmetric quantization with one scale per embedding, mapping the largest magnitude to 127
+	float largest = 0.0f;
+	for (uint32_t i = 0; i < dimension; i++) largest = std::max(largest, std::abs(embedding[i]));
+	scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+	float inverse = 1.0f / scale;
+	for (uint32_t i = 0; i < dimension; i++) code_out[i] = static_cast<int8_t>(std::lround(embedding[i] * inverse));
+	std::fill(code_out + dimension, code_out + code_stride, static_cast<int8_t>(0));
+}
+
+uint32_t AnnIndex::greedyDescend(const int8_t* query_code, float query_scale, uint32_t entry, int from_level, int to_level) const {
+	// Above the target level, a single nearest candidate is enough to find the way down
+	uint32_t current = entry;
+	float current_similarity = similarity(query_code, query_scale, current);
+	for (int level = from_level; level > to_level; level--) {
+		bool improved = true;
+		while (improved) {
+			improved = false;
+			const uint32_t* neighbors = links(current, level);
+			for (uint32_t i = 1; i <= neighbors[0]; i++) {
+				float s = similarity(query_code, query_scale, neighbors[i]);
+				if (s > current_similarity) {
+					current_similarity = s;
+					current = neighbors[i];
+					improved = true;
+				}
+			}
+		}
+	}
+	return current;
+}
+
+std::vector<AnnIndex::Candidate> AnnIndex::searchLevel(const int8_t* query_code, float query_scale, uint32_t entry, size_t ef, int level) const {
+	visited.Begin(count);
+	visited.Visit(entry);
+
+	// Candidates to expand, most similar first, and the ef best found so far, least similar first
+	std::priority_queue<Candidate> frontier;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> best;
+	float entry_similarity = similarity(query_code, query_scale, entry);
+	frontier.push({ entry_similarity, entry });
+	best.push({ entry_similarity, entry });
+
+	while (!frontier.empty()) {
+		Candidate current = frontier.top();
+		if (best.size() >= ef && current.first < best.top().first) break;
+		frontier.pop();
+
+		const uint32_t* neighbors = links(current.second, level);
+		for (uint32_t i = 1; i <= neighbors[0]; i++) {
+			uint32_t neighbor = neighbors[i];
+			if (!visited.Visit(neighbor)) continue;
+			float s = similarity(query_code, query_scale, neighbor);
+			if (best.size() < ef || s > best.top().first) {
+				frontier.push({ s, neighbor });
+				best.push({ s, neighbor });
+				if (best.size() > ef) best.pop();
+			}
+		}
+	}
+
+	std::vector<Candidate> found;
+	found.reserve(best.size());
+	while (!best.empty()) {
+		found.push_back(best.top());
+		best.pop();
+	}
+	std::reverse(found.begin(), found.end());
+	return found;
+}
+
+std::vector<uint32_t> AnnIndex::selectNeighbors(std::vector<Candidate> candidates, size_t max_count) const {
+	// The HNSW heuristic: keep a candidate only if it is closer to the new node than to every neighbor kept so far,
+	// which spreads the links over different directions instead of one dense cluster
+	std::sort(candidates.begin(), candidates.end(), std::greater<Candidate>());
+	std::vector<uint32_t> selected;
+	for (const Candidate& candidate : candidates) {
+		if (selected.size() >= max_count) break;
+		bool diverse = true;
+		for (uint32_t kept : selected) {
+			if (nodeSimilarity(candidate.second, kept) > candidate.first) {
+				diverse = false;
+				break;
+			}
+		}
+		if (diverse) selected.push_back(candidate.second);
+	}
+	return selected;
+}
+
+void AnnIndex::connect(uint32_t node, uint32_t neighbor, int level) {
+	uint32_t* neighbor_links = mutableLinks(neighbor, level);
+	uint32_t capacity = level == 0 ? 2 * max_links : max_links;
+	if (neighbor_links[0] < capacity) {
+		neighbor_links[++neighbor_links[0]] = node;
+		return;
+	}
+
+	// The neighbor is full: choose its links again from its current links and the new node
+	std::vector<Candidate> candidates;
+	candidates.reserve(capacity + 1);
+	candidates.push_back({ nodeSimilarity(neighbor, node), node });
+	for (uint32_t i = 1; i <= neighbor_links[0]; i++) {
+		candidates.push_back({ nodeSimilarity(neighbor, neighbor_links[i]), neighbor_links[i] });
+	}
+	std::vector<uint32_t> selected = selectNeighbors(std::move(candidates), capacity);
+	neighbor_links[0] = static_cast<uint32_t>(selected.size());
+	std::copy(selected.begin(), selected.end(), neighbor_links + 1);
+}
+
+bool AnnIndex::Add(int64_t id, const float* embedding, int embedding_dimension) {
+	if (embedding_dimension <= 0) return false;
+	std::vector<float> normalized(embedding, embedding + embedding_dimension);
+	if (!normalizeEmbedding(normalized.data(), normalized.size())) return false;
+
+	std::unique_lock<std::shared_timed_mutex> lock(mutex);
+	if (count == 0 && dimension == 0) {
+		dimension = static_cast<uint32_t>(embedding_dimension);
+		code_stride = static_cast<uint32_t>(alignUp(dimension, code_alignment));
+	}
+	if (static_cast<uint32_t>(embedding_dimension) != dimension || count >= no_upper_links) return false;
+	detach();
+
+	// Draw the node's top level from the exponentially decaying distribution of the HNSW paper
+	std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+	int level = std::min(static_cast<int>(-std::log(uniform(level_generator)) * level_multiplier), max_node_level);
+
+	// Append the node's sections
+	uint32_t node = static_cast<uint32_t>(count);
+	float scale;
+	owned_codes.resize(owned_codes.size() + code_stride);
+	quantize(normalized.data(), owned_codes.data() + static_cast<size_t>(node) * code_stride, scale);
+	owned_ids.push_back(id);
+	owned_scales.push_back(scale);
+	owned_levels.push_back(static_cast<uint8_t>(level));
+	owned_base_links.resize(owned_base_links.size() + baseLinkStride(), 0);
+	owned_upper_starts.push_back(level > 0 ? static_cast<uint32_t>(owned_upper_links.size()) : no_upper_links);
+	owned_upper_links.resize(owned_upper_links.size() + static_cast<size_t>(level) * upperLinkStride(), 0);
+	upper_link_count = owned_upper_links.size();
+	count++;
+	refreshViews();
+
+	if (node == 0) {
+		entry_point = node;
+		max_level = level;
+		return true;
+	}
+
+	// Find the way down to the node's top level, then link it on every level it shares with the graph
+	const int8_t* node_code = code(node);
+	uint32_t entry = greedyDescend(node_code, scale, entry_point, max_level, level);
+	for (int l = std::min(level, max_level); l >= 0; l--) {
+		std::vector<Candidate> candidates = searchLevel(node_code, scale, entry, ef_construction, l);
+		entry = candidates.front().second;
+
+		std::vector<uint32_t> neighbors = selectNeighbors(candidates, max_links);
+		uint32_t* node_links = mutableLinks(node, l);
+		node_links[0] = static_cast<uint32_t>(neighbors.size());
+		std::copy(neighbors.begin(), neighbors.end(), node_links + 1);
+		for (uint32_t neighbor : neighbors) connect(node, neighbor, l);
+	}
+
+	if (level > max_level) {
+		entry_point = node;
+		max_level = level;
+	}
+	return true;
+}
+
+int AnnIndex::Search(const float* query, int query_dimension, int k, int ef_search, GalleryMatch* matches) const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	if (k <= 0 || count == 0 || static_cast<uint32_t>(query_dimension) != dimension) return 0;
+
+	thread_local std::vector<int8_t> query_code;
+	query_code.resize(code_stride);
+	float query_scale;
+	quantize(query, query_code.data(), query_scale);
+
+	uint32_t entry = greedyDescend(query_code.data(), query_scale, entry_point, max_level, 0);
+	size_t ef = static_cast<size_t>(std::max(ef_search, k));
+	std::vector<Candidate> found = searchLevel(query_code.data(), query_scale, entry, ef, 0);
+
+	int written = std::min(k, static_cast<int>(found.size()));
+	for (int i = 0; i < written; i++) matches[i] = { ids[found[i].second], found[i].first };
+	return written;
+}
+
+void AnnIndex::detach() {
+	// A mapped index is copied into memory before it is changed
+	if (!mapping.Data()) return;
+	owned_ids.assign(ids, ids + count);
+	owned_scales.assign(scales, scales + count);
+	owned_levels.assign(levels, levels + count);
+	owned_codes.assign(codes, codes + count * code_stride);
+	owned_base_links.assign(base_links, base_links + count * baseLinkStride());
+	owned_upper_starts.assign(upper_starts, upper_starts + count);
+	owned_upper_links.assign(upper_links, upper_links + upper_link_count);
+	mapping.Close();
+	refreshViews();
+}
+
+void AnnIndex::refreshViews() {
+	ids = owned_ids.data();
+	scales = owned_scales.data();
+	levels = owned_levels.data();
+	codes = owned_codes.data();
+	base_links = owned_base_links.data();
+	upper_starts = owned_upper_starts.data();
+	upper_links = owned_upper_links.data();
+}
+
+void AnnIndex::reset() {
+	mapping.Close();
+	owned_ids.clear();
+	owned_scales.clear();
+	owned_levels.clear();
+	owned_codes.clear();
+	owned_base_links.clear();
+	owned_upper_starts.clear();
+	owned_upper_links.clear();
+	refreshViews();
+	dimension = 0;
+	code_stride = 0;
+	entry_point = 0;
+	max_level = -1;
+	count = 0;
+	upper_link_count = 0;
+}
+
+bool AnnIndex::Save(const std::string& path) const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+
+	AnnIndexHeader header = {};
+	std::memcpy(header.magic, ann_file_magic, sizeof(header.magic));
+	header.version = ann_file_version;
+	header.dimension = dimension;
+	header.code_stride = code_stride;
+	header.max_links = max_links;
+	header.ef_construction = ef_construction;
+	header.entry_point = entry_point;
+	header.max_level = max_level;
+	header.count = count;
+	header.upper_link_count = upper_link_count;
+
+	const void* sections[ann_section_count] = { ids, scales, levels, codes, base_links, upper_starts, upper_links };
+	uint64_t sizes[ann_section_count] = {
+		count * sizeof(int64_t), count * sizeof(float), count, count * code_stride,
+		count * baseLinkStride() * sizeof(uint32_t), count * sizeof(uint32_t), upper_link_count * sizeof(uint32_t) };
+	uint64_t offset = alignUp(sizeof(AnnIndexHeader), section_alignment);
+	for (int s = 0; s < ann_section_count; s++) {
+		header.offsets[s] = offset;
+		offset = alignUp(offset + sizes[s], section_alignment);
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) return false;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	const char padding[section_alignment] = {};
+	uint64_t written = sizeof(header);
+	for (int s = 0; s < ann_section_count; s++) {
+		file.write(padding, static_cast<std::streamsize>(header.offsets[s] - written));
+		if (sizes[s] > 0) file.write(static_cast<const char*>(sections[s]), static_cast<std::streamsize>(sizes[s]));
+		written = header.offsets[s] + sizes[s];
+	}
+	return static_cast<bool>(file);
+}
+
+bool AnnIndex::Open(const std::string& path) {
+	std::unique_lock<std::shared_timed_mutex> lock(mutex);
+	reset();
+	if (!mapping.Open(path) || mapping.Size() < sizeof(AnnIndexHeader)) {
+		mapping.Close();
+		return false;
+	}
+
+	// Check the header and that every section lies inside the file before pointing into it
+	AnnIndexHeader header;
+	std::memcpy(&header, mapping.Data(), sizeof(header));
+	bool valid = std::memcmp(header.magic, ann_file_magic, sizeof(header.magic)) == 0
+		&& header.version == ann_file_version
+		&& header.code_stride % code_alignment == 0 && header.code_stride >= header.dimension
+		&& header.max_links >= 2 && header.count < no_upper_links
+		&& (header.count == 0 || (header.entry_point < header.count && header.max_level >= 0 && header.max_level <= max_node_level));
+	uint64_t sizes[ann_section_count] = {
+		header.count * sizeof(int64_t), header.count * sizeof(float), header.count, header.count * header.code_stride,
+		header.count * (1 + 2 * static_cast<uint64_t>(header.max_links)) * sizeof(uint32_t), header.count * sizeof(uint32_t),
+		header.upper_link_count * sizeof(uint32_t) };
+	for (int s = 0; valid && s < ann_section_count; s++) {
+		valid = header.offsets[s] % section_alignment == 0 && header.offsets[s] <= mapping.Size() && sizes[s] <= mapping.Size() - header.offsets[s];
+	}
+	if (!valid) {
+		mapping.Close();
+		return false;
+	}
+
+	const uint8_t* data = mapping.Data();
+	ids = reinterpret_cast<const int64_t*>(data + header.offsets[0]);
+	scales = reinterpret_cast<const float*>(data + header.offsets[1]);
+	levels = data + header.offsets[2];
+	codes = reinterpret_cast<const int8_t*>(data + header.offsets[3]);
+	base_links = reinterpret_cast<const uint32_t*>(data + header.offsets[4]);
+	upper_starts = reinterpret_cast<const uint32_t*>(data + header.offsets[5]);
+	upper_links = reinterpret_cast<const uint32_t*>(data + header.offsets[6]);
+	dimension = header.dimension;
+	code_stride = header.code_stride;
+	max_links = header.max_links;
+	ef_construction = header.ef_construction;
+	level_multiplier = 1.0 / std::log(static_cast<double>(max_links));
+	entry_point = header.entry_point;
+	max_level = header.max_level;
+	count = header.count;
+	upper_link_count = header.upper_link_count;
+	return true;
+}
+
+int AnnIndex::Size() const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	return static_cast<int>(count);
+}
+
+int AnnIndex::Dimension() const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	return static_cast<int>(dimension);
+}
+
+uint64_t AnnIndex::Bytes() const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	return count * (sizeof(int64_t) + sizeof(float) + 1 + code_stride + (baseLinkStride() + 1) * sizeof(uint32_t))
+		+ upper_link_count * sizeof(uint32_t);
+}
+
+namespace {
+	/// <summary>
+	/// Get the loaded model's ANN index.
+	/// </summary>
+	/// <returns>The index, or null if no model is loaded or it has no index.</returns>
+	std::shared_ptr<AnnIndex> loadedAnnIndex() {
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		return model ? std::atomic_load(&model->ann_index) : nullptr;
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Give the loaded model an empty approximate nearest-neighbor index, replacing any it has.
+	/// Like the gallery, the index belongs to the model and is dropped when another model is loaded or reloaded.
+	/// </summary>
+	/// <param name="max_links">Neighbors per node (HNSW's M), e.g., 16; from 2 to 64.</param>
+	/// <param name="ef_construction">Candidates considered when inserting, e.g., 200.</param>
+	/// <returns>1 if the index was created, 0 if no model is loaded or the settings are out of range.</returns>
+	DLLExport int CreateAnnIndex(int max_links, int ef_construction) {
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model || max_links < 2 || max_links > 64 || ef_construction < 1) return 0;
+		std::atomic_store(&model->ann_index, std::make_shared<AnnIndex>(max_links, ef_construction));
+		return 1;
+	}
+
+	/// <summary>
+	/// Memory-map an index file saved by SaveAnnIndex as the loaded model's index. The index is searched straight
+	/// from the file's pages; adding embeddings copies it into memory first.
+	/// The header and section bounds are checked, but the graph itself is trusted, so only open files written by SaveAnnIndex.
+	/// </summary>
+	/// <param name="path">Path of the index file.</param>
+	/// <returns>1 if the index was opened, 0 if no model is loaded or the file cannot be mapped or is not an index file.</returns>
+	DLLExport int OpenAnnIndex(const char* path) {
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return 0;
+		std::shared_ptr<AnnIndex> index = std::make_shared<AnnIndex>(16, 200);
+		if (!index->Open(path)) return 0;
+		std::atomic_store(&model->ann_index, index);
+		return 1;
+	}
+
+	/// <summary>
+	/// Save the loaded model's index to a file that OpenAnnIndex can map.
+	/// </summary>
+	/// <param name="path">Path of the index file, which is replaced.</param>
+	/// <returns>1 if the file was written, 0 if there is no index or the write failed.</returns>
+	DLLExport int SaveAnnIndex(const char* path) {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		return index && index->Save(path) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Drop the loaded model's index, unmapping its file if it was opened from one.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void CloseAnnIndex() {
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (model) std::atomic_store(&model->ann_index, std::shared_ptr<AnnIndex>());
+	}
+
+	/// <summary>
+	/// Add an embedding to the index.
+	/// </summary>
+	/// <param name="id">Identifier returned by searches; several embeddings may share one.</param>
+	/// <param name="embedding">The embedding; it is normalized and quantized when stored.</param>
+	/// <param name="dimension">Number of elements, which must match the index's embeddings.</param>
+	/// <returns>1 if the embedding was added, 0 if there is no index, the dimension differs, or the embedding is all zeros.</returns>
+	DLLExport int AddAnnEmbedding(long long id, const float* embedding, int dimension) {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		return index && index->Add(id, embedding, dimension) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Run the loaded model on an image and add its embedding to the index.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="id">Identifier returned by searches.</param>
+	/// <returns>1 if the embedding was added, 0 if there is no index, the run failed, or the embedding does not fit the index.</returns>
+	DLLExport int AddAnnImage(byte* image_data, long long id) {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		bool added = false;
+		if (index) {
+			runEmbedding(image_data, [&](const float* embedding, int dimension) { added = index->Add(id, embedding, dimension); });
+		}
+		return added ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Get the number of embeddings in the index.
+	/// </summary>
+	/// <returns>The number of embeddings, or 0 if there is no index.</returns>
+	DLLExport int GetAnnIndexSize() {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		return index ? index->Size() : 0;
+	}
+
+	/// <summary>
+	/// Find the indexed embeddings most similar to an embedding computed elsewhere.
+	/// </summary>
+	/// <param name="query">The query embedding.</param>
+	/// <param name="dimension">Number of elements in the query.</param>
+	/// <param name="top_k">Most matches to return.</param>
+	/// <param name="ef_search">Candidates kept while searching, e.g., 64; raise it for better recall.</param>
+	/// <param name="matches">Receives up to top_k matches by descending approximate cosine similarity.</param>
+	/// <returns>The number of matches, or -1 if there is no index or the query is all zeros.</returns>
+	DLLExport int SearchAnnIndex(const float* query, int dimension, int top_k, int ef_search, GalleryMatch* matches) {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		if (!index || dimension <= 0) return -1;
+		std::vector<float> normalized(query, query + dimension);
+		if (!normalizeEmbedding(normalized.data(), normalized.size())) return -1;
+		return index->Search(normalized.data(), dimension, top_k, ef_search, matches);
+	}
+
+	/// <summary>
+	/// Run the loaded embedding model on one frame, normalize the embedding in place and return its best matches
+	/// from the approximate index.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="top_k">Most matches to return.</param>
+	/// <param name="ef_search">Candidates kept while searching, e.g., 64; raise it for better recall.</param>
+	/// <param name="matches">Receives up to top_k matches by descending approximate cosine similarity.</param>
+	/// <param name="embedding">Receives the normalized embedding, or nullptr.</param>
+	/// <param name="length">Capacity of embedding; the embedding is truncated to fit.</param>
+	/// <returns>The number of matches, or -1 if there is no index, the run failed, or the embedding is all zeros.</returns>
+	DLLExport int PerformInferenceAnnSearch(byte* image_data, int top_k, int ef_search, GalleryMatch* matches, float* embedding, int length) {
+		std::shared_ptr<AnnIndex> index = loadedAnnIndex();
+		if (!index) return -1;
+
+		int found = 0;
+		bool ran = runEmbedding(image_data, [&](const float* normalized, int dimension) {
+			if (embedding) std::copy(normalized, normalized + std::min(dimension, std::max(length, 0)), embedding);
+			found = index->Search(normalized, dimension, top_k, ef_search, matches);
+		});
+		return ran ? found : -1;
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "external_data.h"
+#include "gallery.h"
+#include <cstdint>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// ANN index file layout (little-endian), designed to be memory-mapped and searched in place:
+//   header:   AnnIndexHeader
+//   sections: each at the 64-byte aligned offset recorded in the header
+//     ids          int64[count]                     identifier of each node
+//     scales       float[count]                     dequantization scale of each node's code
+//     levels       uint8[count]                     top graph level of each node
+//     codes        int8[count][code_stride]         quantized embeddings, zero-padded
+//     base_links   uint32[count][1 + 2 * max_links] level 0 neighbors of each node: count, then node indices
+//     upper_starts uint32[count]                    start in upper_links of each node's level 1 list
+//     upper_links  uint32[upper_link_count]         lists of levels 1 and up, 1 + max_links entries per level
+const char ann_file_magic[4] = { 'O', 'C', 'V', 'A' };
+const uint32_t ann_file_version = 1;
+const int ann_section_count = 7;
+
+/// <summary>
+/// Header at the start of an ANN index file.
+/// </summary>
+struct AnnIndexHeader {
+	char magic[4];                    // "OCVA"
+	uint32_t version;                 // ann_file_version
+	uint32_t dimension;               // Elements per embedding
+	uint32_t code_stride;             // Bytes per quantized embedding, a multiple of 32
+	uint32_t max_links;               // Neighbors per node above level 0; level 0 allows twice as many
+	uint32_t ef_construction;         // Candidate list size used while inserting
+	uint32_t entry_point;             // Node that searches start from
+	int32_t max_level;                // Level of the entry point
+	uint64_t count;                   // Number of nodes
+	uint64_t upper_link_count;        // Entries in the upper_links section
+	uint64_t offsets[ann_section_count]; // Byte offset of each section from the start of the file
+};
+
+static_assert(sizeof(AnnIndexHeader) == 104, "ANN index header layout changed");
+
+/// <summary>
+/// Approximate nearest-neighbor index for galleries too large to search exhaustively: a hierarchical navigable
+/// small world (HNSW) graph over embeddings quantized to int8 with one scale per embedding. Embeddings are added
+/// incrementally; the index can be saved and memory-mapped back, in which case it is searched straight from the
+/// mapping and only copied into memory if more embeddings are added. Searches may run concurrently with each other;
+/// additions wait for running searches. Identifiers need not be unique, e.g., for several views of one person.
+/// </summary>
+class AnnIndex {
+public:
+	/// <param name="max_links">Neighbors per node above level 0 (M); more improves recall at the cost of memory and speed.</param>
+	/// <param name="ef_construction">Candidates considered when linking a new node; more builds a better graph more slowly.</param>
+	AnnIndex(int max_links, int ef_construction);
+
+	AnnIndex(const AnnIndex&) = delete;
+	AnnIndex& operator=(const AnnIndex&) = delete;
+
+	/// <summary>
+	/// Add an embedding. The first embedding sets the dimension.
+	/// </summary>
+	/// <param name="id">Identifier returned by searches.</param>
+	/// <param name="embedding">The embedding, which is normalized and quantized on the way in.</param>
+	/// <param name="dimension">Number of elements.</param>
+	/// <returns>False if the dimension differs from the index's, the embedding has no direction, or the index is full.</returns>
+	bool Add(int64_t id, const float* embedding, int dimension);
+
+	/// <summary>
+	/// Find the embeddings most similar to a query.
+	/// </summary>
+	/// <param name="query">The query, already normalized.</param>
+	/// <param name="dimension">Number of elements in the query.</param>
+	/// <param name="k">Most matches to return.</param>
+	/// <param name="ef_search">Candidates kept while searching, at least k; more improves recall at the cost of speed.</param>
+	/// <param name="matches">Receives up to k matches by descending approximate cosine similarity.</param>
+	/// <returns>Number of matches written; 0 if the dimension differs from the index's.</returns>
+	int Search(const float* query, int dimension, int k, int ef_search, GalleryMatch* matches) const;
+
+	/// <returns>False if the file could not be written.</returns>
+	bool Save(const std::string& path) const;
+
+	/// <summary>
+	/// Replace the contents with a memory-mapped index file.
+	/// </summary>
+	/// <returns>False if the file cannot be mapped or is not a valid index file, in which case the index is left empty.</returns>
+	bool Open(const std::string& path);
+
+	int Size() const;
+	int Dimension() const;
+
+	/// <returns>Bytes held by the index's sections, whether in memory or mapped.</returns>
+	uint64_t Bytes() const;
+
+private:
+	// A node and its similarity to a query
+	typedef std::pair<float, uint32_t> Candidate;
+
+	uint32_t baseLinkStride() const { return 1 + 2 * max_links; }
+	uint32_t upperLinkStride() const { return 1 + max_links; }
+	const uint32_t* links(uint32_t node, int level) const;
+	uint32_t* mutableLinks(uint32_t node, int level);
+	const int8_t* code(uint32_t node) const { return codes + static_cast<size_t>(node) * code_stride; }
+	float similarity(const int8_t* query_code, float query_scale, uint32_t node) const;
+	float nodeSimilarity(uint32_t a, uint32_t b) const;
+
+	void quantize(const float* embedding, int8_t* code_out, float& scale) const;
+	uint32_t greedyDescend(const int8_t* query_code, float query_scale, uint32_t entry, int from_level, int to_level) const;
+	std::vector<Candidate> searchLevel(const int8_t* query_code, float query_scale, uint32_t entry, size_t ef, int level) const;
+	std::vector<uint32_t> selectNeighbors(std::vector<Candidate> candidates, size_t max_count) const;
+	void connect(uint32_t node, uint32_t neighbor, int level);
+
+	void detach();
+	void refreshViews();
+	void reset();
+
+	mutable std::shared_timed_mutex mutex;
+	uint32_t max_links;
+	uint32_t ef_construction;
+	double level_multiplier;          // 1 / ln(max_links), the expected level spacing of the HNSW paper
+	std::mt19937 level_generator;
+	uint32_t dimension = 0;
+	uint32_t code_stride = 0;
+	uint32_t entry_point = 0;
+	int max_level = -1;
+	uint64_t count = 0;
+	uint64_t upper_link_count = 0;
+
+	// Sections owned in memory, empty while the index is mapped
+	std::vector<int64_t> owned_ids;
+	std::vector<float> owned_scales;
+	std::vector<uint8_t> owned_levels;
+	std::vector<int8_t> owned_codes;
+	std::vector<uint32_t> owned_base_links;
+	std::vector<uint32_t> owned_upper_starts;
+	std::vector<uint32_t> owned_upper_links;
+	MappedFile mapping;
+
+	// Views of the sections, in the owned vectors or the mapping
+	const int64_t* ids = nullptr;
+	const float* scales = nullptr;
+	const uint8_t* levels = nullptr;
+	const int8_t* codes = nullptr;
+	const uint32_t* base_links = nullptr;
+	const uint32_t* upper_starts = nullptr;
+	const uint32_t* upper_links = nullptr;
+};
@@ -0,0 +1,592 @@
+#include "pch.h"
+#include "plugin.h"
+#include "affinity.h"
+#include "batch.h"
+#include "detection_file.h"
+#include "task_pool.h"
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+	/// <summary>
+	/// Image file formats read by the batch driver.
+	/// </summary>
+	enum class ImageFormat {
+		Unsupported,
+		Ppm,                          // Binary PPM (P6) with 8-bit samples, parsed directly
+		Raw,                          // Headerless interleaved RGB bytes of exactly the model's image size
+		Wic                           // PNG, JPEG or BMP, decoded with the Windows Imaging Component
+	};
+
+	/// <summary>
+	/// Pick a decoder from a file's extension.
+	/// </summary>
+	ImageFormat imageFormat(const std::wstring& name) {
+		size_t dot = name.find_last_of(L'.');
+		if (dot == std::wstring::npos) return ImageFormat::Unsupported;
+
+		std::wstring extension = name.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+		if (extension == L"ppm") return ImageFormat::Ppm;
+		if (extension == L"raw" || extension == L"rgb") return ImageFormat::Raw;
+		if (extension == L"png" || extension == L"jpg" || extension == L"jpeg" || extension == L"bmp") return ImageFormat::Wic;
+		return ImageFormat::Unsupported;
+	}
+
+	/// <summary>
+	/// List the supported image files in a directory, sorted by name.
+	/// </summary>
+	/// <returns>False if the directory could not be read.</returns>
+	bool listImages(const std::wstring& directory, std::vector<std::wstring>& names) {
+		WIN32_FIND_DATAW find_data;
+		HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &find_data);
+		if (find == INVALID_HANDLE_VALUE) return false;
+
+		do {
+			if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+			if (imageFormat(find_data.cFileName) != ImageFormat::Unsupported) names.push_back(find_data.cFileName);
+		} while (FindNextFileW(find, &find_data));
+		FindClose(find);
+
+		std::sort(names.begin(), names.end());
+		return true;
+	}
+
+	/// <summary>
+	/// Convert a wide string to UTF-8.
+	/// </summary>
+	std::string wstringToUtf8(const std::wstring& wstr) {
+		int size = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), static_cast<int>(wstr.size()), nullptr, 0, nullptr, nullptr);
+		std::string str(size, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), static_cast<int>(wstr.size()), &str[0], size, nullptr, nullptr);
+		return str;
+	}
+
+	/// <summary>
+	/// Read the next whitespace-delimited header token of a PPM file, skipping comments.
+	/// </summary>
+	bool readPpmToken(std::ifstream& file, std::string& token) {
+		token.clear();
+		int c;
+		while ((c = file.get()) != EOF) {
+			if (c == '#') {
+				while ((c = file.get()) != EOF && c != '\n') {}
+			}
+			else if (!isspace(c)) {
+				token.push_back(static_cast<char>(c));
+				break;
+			}
+		}
+		while ((c = file.peek()) != EOF && !isspace(c)) token.push_back(static_cast<char>(file.get()));
+		return !token.empty();
+	}
+
+	/// <summary>
+	/// Decode a binary PPM file into interleaved RGB bytes.
+	/// </summary>
+	bool decodePpm(const std::wstring& path, const LoadedModel& model, std::vector<byte>& rgb) {
+		std::ifstream file(path, std::ios::binary);
+		std::string magic, width, height, max_value;
+		if (!readPpmToken(file, magic) || !readPpmToken(file, width) || !readPpmToken(file, height) || !readPpmToken(file, max_value)) return false;
+		if (magic != "P6" || std::atoi(width.c_str()) != model.input_w || std::atoi(height.c_str()) != model.input_h || max_value != "255") return false;
+
+		// A single whitespace character separates the header from the samples
+		file.get();
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(rgb.data()), rgb.size()));
+	}
+
+	/// <summary>
+	/// Read a headerless RGB file, which must hold exactly one image of the model's dimensions.
+	/// </summary>
+	bool decodeRaw(const std::wstring& path, std::vector<byte>& rgb) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file || static_cast<size_t>(file.tellg()) != rgb.size()) return false;
+		file.seekg(0);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(rgb.data()), rgb.size()));
+	}
+
+	/// <summary>
+	/// Decode an image with the Windows Imaging Component into interleaved RGB bytes.
+	/// </summary>
+	bool decodeWic(IWICImagingFactory* factory, const std::wstring& path, const LoadedModel& model, std::vector<byte>& rgb) {
+		ComPtr<IWICBitmapDecoder> decoder;
+		ComPtr<IWICBitmapFrameDecode> frame;
+		ComPtr<IWICFormatConverter> converter;
+		UINT width, height;
+
+		if (FAILED(factory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder))) return false;
+		if (FAILED(decoder->GetFrame(0, &frame)) || FAILED(frame->GetSize(&width, &height))) return false;
+		if (static_cast<int>(width) != model.input_w || static_cast<int>(height) != model.input_h) return false;
+
+		// Let WIC convert palette, grayscale, alpha and 16-bit formats to 8-bit RGB
+		if (FAILED(factory->CreateFormatConverter(&converter))) return false;
+		if (FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat24bppRGB, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom))) return false;
+		return SUCCEEDED(converter->CopyPixels(nullptr, model.input_w * n_channels, static_cast<UINT>(rgb.size()), rgb.data()));
+	}
+
+	/// <summary>
+	/// Reverse the row order of an interleaved RGB image in place.
+	/// </summary>
+	void flipRows(const LoadedModel& model, std::vector<byte>& rgb) {
+		size_t stride = static_cast<size_t>(model.input_w) * n_channels;
+		for (int top = 0, bottom = model.input_h - 1; top < bottom; top++, bottom--) {
+			std::swap_ranges(rgb.begin() + top * stride, rgb.begin() + (top + 1) * stride, rgb.begin() + bottom * stride);
+		}
+	}
+
+	/// <summary>
+	/// Decode an image file, flip it if requested, and preprocess it into a model input buffer.
+	/// Runs on task pool threads, which keep their own decode buffer and WIC factory.
+	/// </summary>
+	bool decodeImage(const std::wstring& path, ImageFormat format, bool flip, const LoadedModel& model, void* input) {
+		thread_local std::vector<byte> rgb;
+		thread_local ComPtr<IWICImagingFactory> factory;
+		rgb.resize(static_cast<size_t>(model.n_pixels) * n_channels);
+
+		bool decoded = false;
+		switch (format) {
+		case ImageFormat::Ppm: decoded = decodePpm(path, model, rgb); break;
+		case ImageFormat::Raw: decoded = decodeRaw(path, rgb); break;
+		case ImageFormat::Wic:
+			if (!factory) CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+			decoded = factory && decodeWic(factory.Get(), path, model, rgb);
+			break;
+		default: break;
+		}
+		if (!decoded) return false;
+
+		if (flip) flipRows(model, rgb);
+		preprocessInput(rgb.data(), input, model.input_type, model.n_pixels);
+		return true;
+	}
+
+	/// <summary>
+	/// Bounded queue of preprocessed images between the decode tasks and the inference loop.
+	/// Images are written into a fixed set of slots, and the inference loop starts a decode task for
+	/// each slot it frees, so decoding never gets more than the slot count ahead of inference.
+	/// </summary>
+	class PrefetchQueue {
+	public:
+		PrefetchQueue(int slot_count, size_t slot_bytes)
+			: slots(slot_count, std::vector<uint8_t>(slot_bytes)) {}
+
+		uint8_t* Slot(int slot) { return slots[slot].data(); }
+		int SlotCount() const { return static_cast<int>(slots.size()); }
+
+		/// <summary>
+		/// Record that a decode task has been started for a slot.
+		/// </summary>
+		void BeginDecode() {
+			std::lock_guard<std::mutex> lock(mutex);
+			decoding++;
+		}
+
+		/// <summary>
+		/// Hand a filled slot to the inference loop, ending its decode task.
+		/// </summary>
+		void Push(int image_index, int slot) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ready.push_back({ image_index, slot });
+				decoding--;
+			}
+			item_ready.notify_one();
+		}
+
+		/// <summary>
+		/// End a decode task that ran out of images before filling its slot.
+		/// </summary>
+		void EndDecode() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				decoding--;
+			}
+			item_ready.notify_one();
+		}
+
+		/// <summary>
+		/// Wait for a full batch of images, or whatever remains once every decode task has finished.
+		/// </summary>
+		/// <param name="items">Receives (image index, slot) pairs; left empty once every image has been consumed.</param>
+		void PopBatch(size_t max_count, std::vector<std::pair<int, int>>& items) {
+			std::unique_lock<std::mutex> lock(mutex);
+			item_ready.wait(lock, [&]() { return ready.size() >= max_count || decoding == 0; });
+			items.clear();
+			while (!ready.empty() && items.size() < max_count) {
+				items.push_back(ready.front());
+				ready.pop_front();
+			}
+		}
+
+		/// <summary>
+		/// Wait for every decode task to finish, so the slots can be released.
+		/// </summary>
+		void WaitIdle() {
+			std::unique_lock<std::mutex> lock(mutex);
+			item_ready.wait(lock, [this]() { return decoding == 0; });
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable item_ready;
+		std::vector<std::vector<uint8_t>> slots;
+		std::deque<std::pair<int, int>> ready;
+		int decoding = 0;                 // Decode tasks started and not yet finished
+	};
+
+	/// <summary>
+	/// Get the leading dimension of the session's input.
+	/// </summary>
+	/// <returns>The batch size the model requires, or a non-positive value if it accepts any batch size.</returns>
+	int64_t inputBatchDimension(OrtSession* session) {
+		OrtTypeInfo* type_info;
+		checkStatus(ort->SessionGetInputTypeInfo(session, 0, &type_info));
+
+		const OrtTensorTypeAndShapeInfo* tensor_info;
+		size_t dim_count = 0;
+		int64_t batch = 1;
+		ort->CastTypeInfoToTensorInfo(type_info, &tensor_info);
+		if (tensor_info) ort->GetDimensionsCount(tensor_info, &dim_count);
+		if (dim_count > 0) {
+			std::vector<int64_t> shape(dim_count);
+			ort->GetDimensions(tensor_info, shape.data(), dim_count);
+			batch = shape[0];
+		}
+		ort->ReleaseTypeInfo(type_info);
+		return batch;
+	}
+
+	/// <summary>
+	/// Write a plain value to a binary stream.
+	/// </summary>
+	template <typename T>
+	void writeValue(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/// <summary>
+	/// Receives the per-image outputs of a directory run.
+	/// </summary>
+	class BatchSink {
+	public:
+		virtual ~BatchSink() = default;
+
+		/// <summary>
+		/// Called once with the model being run and the images to be processed, in directory order, before any output.
+		/// </summary>
+		virtual bool Begin(const LoadedModel& model, const std::vector<std::wstring>& names) = 0;
+
+		/// <summary>
+		/// Called with each image's output converted to float: on the inference thread, or on task pool
+		/// threads for sinks that accept concurrent writes.
+		/// </summary>
+		virtual void Write(int image_index, const float* output, size_t count) = 0;
+
+		/// <summary>
+		/// Whether Write may be called for several images at once.
+		/// </summary>
+		virtual bool ConcurrentWrites() const { return false; }
+
+		/// <summary>
+		/// Called once after the last output.
+		/// </summary>
+		/// <returns>False if any output could not be written.</returns>
+		virtual bool End(size_t output_count, int record_count) = 0;
+	};
+
+	/// <summary>
+	/// Writes raw outputs to a batch results file (see batch.h).
+	/// </summary>
+	class ResultsFileSink : public BatchSink {
+	public:
+		explicit ResultsFileSink(const char* path) : results(path, std::ios::binary | std::ios::trunc) {}
+
+		bool Begin(const LoadedModel&, const std::vector<std::wstring>& names) override {
+			if (!results) return false;
+
+			// Write the header and name table; the output size and record count are filled in at the end
+			results.write(batch_results_magic, sizeof(batch_results_magic));
+			writeValue(results, batch_results_version);
+			writeValue(results, static_cast<uint32_t>(names.size()));
+			counts_position = results.tellp();
+			writeValue(results, static_cast<uint32_t>(0));
+			writeValue(results, static_cast<uint32_t>(0));
+			for (const std::wstring& name : names) {
+				std::string utf8_name = wstringToUtf8(name);
+				writeValue(results, static_cast<uint16_t>(utf8_name.size()));
+				results.write(utf8_name.data(), utf8_name.size());
+			}
+			return static_cast<bool>(results);
+		}
+
+		void Write(int image_index, const float* output, size_t count) override {
+			writeValue(results, static_cast<uint32_t>(image_index));
+			results.write(reinterpret_cast<const char*>(output), count * sizeof(float));
+		}
+
+		bool End(size_t output_count, int record_count) override {
+			results.seekp(counts_position);
+			writeValue(results, static_cast<uint32_t>(output_count));
+			writeValue(results, static_cast<uint32_t>(record_count));
+			results.close();
+			return static_cast<bool>(results);
+		}
+
+	private:
+		std::ofstream results;
+		std::streampos counts_position;
+	};
+
+	/// <summary>
+	/// Decodes YOLOX outputs, applies non-maximum suppression and appends the detections to a detection file.
+	/// </summary>
+	class DetectionFileSink : public BatchSink {
+	public:
+		DetectionFileSink(const char* path, float score_threshold, float iou_threshold)
+			: path(path), score_threshold(score_threshold), iou_threshold(iou_threshold) {}
+
+		bool Begin(const LoadedModel& model, const std::vector<std::wstring>&) override {
+			image_width = model.input_w;
+			image_height = model.input_h;
+			return writer.Open(path, true);
+		}
+
+		void Write(int image_index, const float* output, size_t count) override {
+			// Reused between images decoded on the same thread
+			thread_local std::vector<Detection> detections;
+			if (!decodeYoloxOutput(output, count, image_width, image_height, score_threshold, detections)) {
+				failed = true;
+				return;
+			}
+			nonMaxSuppression(detections, iou_threshold);
+			if (!writer.Append(image_index, detections.data(), static_cast<int>(detections.size()))) failed = true;
+		}
+
+		// Decoding and suppression run in parallel; the writer serializes appends
+		bool ConcurrentWrites() const override { return true; }
+
+		bool End(size_t, int) override {
+			writer.Close();
+			return !failed;
+		}
+
+	private:
+		std::string path;
+		float score_threshold;
+		float iou_threshold;
+		int image_width = 0;              // Dimensions of the model's input, set by Begin
+		int image_height = 0;
+		DetectionFileWriter writer;
+		std::atomic<bool> failed{ false };
+	};
+
+	/// <summary>
+	/// Run the loaded model over every image in a directory and pass each output to a sink.
+	/// Images are decoded and preprocessed by task pool workers ahead of inference and run in batches.
+	/// </summary>
+	/// <returns>The number of images processed, or -1 if no model is loaded, the directory or sink failed, or a session run failed.</returns>
+	int runImageDirectory(const char* directory, int batch_size, int decode_threads, int flip_rows, BatchSink& sink, BatchStats* stats) {
+		*stats = {};
+
+		// Hold the model for the whole run, so a reload cannot release its session underneath
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return -1;
+		OrtSession* session = model->replicas.front()->session;
+
+		std::vector<std::wstring> names;
+		std::wstring directory_path = stringToWstring(directory);
+		if (!listImages(directory_path, names)) return -1;
+
+		// Models exported with a fixed batch size must always be run with exactly that many images
+		int64_t model_batch;
+		try {
+			model_batch = inputBatchDimension(session);
+		}
+		catch (const std::exception&) {
+			return -1;
+		}
+		bool fixed_batch = model_batch > 0;
+		batch_size = fixed_batch ? static_cast<int>(model_batch) : std::max(batch_size, 1);
+
+		stats->image_count = static_cast<int>(names.size());
+		stats->batch_size = batch_size;
+		if (!sink.Begin(*model, names)) return -1;
+
+		// Decode on the shared task pool unless the caller asked for dedicated workers
+		std::unique_ptr<TaskPool> dedicated_pool;
+		if (decode_threads > 0) {
+			dedicated_pool = std::make_unique<TaskPool>(decode_threads, []() {
+				initWorkerThread();
+				CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+			});
+		}
+		TaskPool& pool = dedicated_pool ? *dedicated_pool : sharedTaskPool();
+
+		// Two batches of slots let decoding run a full batch ahead of inference
+		size_t image_bytes = inputTensorBytes(model->input_type, model->n_pixels);
+		PrefetchQueue queue(batch_size * 2, image_bytes);
+		int image_count = static_cast<int>(names.size());
+		std::atomic<int> next_image{ 0 };
+		std::atomic<int> failed{ 0 };
+
+		// Create a memory info instance for the batched input tensors
+		OrtMemoryInfo* memory_info;
+		ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info);
+
+		auto start = std::chrono::steady_clock::now();
+
+		// Each decode task claims the next image in directory order and preprocesses it into its slot,
+		// moving on to the following image if one fails to decode
+		auto startDecode = [&](int slot) {
+			queue.BeginDecode();
+			pool.Submit([&, slot]() {
+				int index;
+				while ((index = next_image++) < image_count) {
+					if (decodeImage(directory_path + L"\\" + names[index], imageFormat(names[index]), flip_rows != 0, *model, queue.Slot(slot))) {
+						queue.Push(index, slot);
+						return;
+					}
+					failed++;
+				}
+				queue.EndDecode();
+			});
+		};
+		for (int slot = 0; slot < queue.SlotCount(); slot++) startDecode(slot);
+
+		// Gather batches into one contiguous input and run them on the calling thread
+		std::vector<uint8_t> batch_input(image_bytes * batch_size);
+		std::vector<std::pair<int, int>> items;
+		std::vector<std::vector<float>> records(sink.ConcurrentWrites() ? batch_size : 1);
+		size_t output_count = 0;
+		double run_ms = 0.0;
+		bool run_failed = false;
+
+		const char* input_names[] = { model->input_name.c_str() };
+		const char* output_names[] = { model->output_name.c_str() };
+		ONNXTensorElementDataType output_type = model->output_type;
+		size_t element_size = (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) ? sizeof(uint16_t) : sizeof(float);
+
+		for (queue.PopBatch(batch_size, items); !items.empty(); queue.PopBatch(batch_size, items)) {
+			for (size_t i = 0; i < items.size(); i++) {
+				std::memcpy(batch_input.data() + i * image_bytes, queue.Slot(items[i].second), image_bytes);
+				startDecode(items[i].second);
+			}
+
+			// A fixed-size final batch is padded with the previous batch's images, whose outputs are discarded
+			int64_t run_batch = fixed_batch ? batch_size : static_cast<int64_t>(items.size());
+			int64_t input_shape[] = { run_batch, n_channels, model->input_h, model->input_w };
+			OrtValue* input_tensor = nullptr;
+			OrtValue* output_tensor = nullptr;
+			ort->CreateTensorWithDataAsOrtValue(memory_info, batch_input.data(), image_bytes * run_batch, input_shape, 4, model->input_type, &input_tensor);
+
+			auto run_start = std::chrono::steady_clock::now();
+			OrtStatus* status = ort->Run(session, nullptr, input_names, (const OrtValue* const*)&input_tensor, 1, output_names, 1, &output_tensor);
+			run_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - run_start).count();
+			ort->ReleaseValue(input_tensor);
+			stats->batch_count++;
+
+			if (status) {
+				ort->ReleaseStatus(status);
+				if (output_tensor) ort->ReleaseValue(output_tensor);
+				run_failed = true;
+				break;
+			}
+
+			// Split the batched output evenly between the images
+			OrtTensorTypeAndShapeInfo* output_info;
+			size_t total_count;
+			ort->GetTensorTypeAndShape(output_tensor, &output_info);
+			ort->GetTensorShapeElementCount(output_info, &total_count);
+			ort->ReleaseTensorTypeAndShapeInfo(output_info);
+			output_count = total_count / run_batch;
+
+			uint8_t* out_data;
+			ort->GetTensorMutableData(output_tensor, reinterpret_cast<void**>(&out_data));
+			if (sink.ConcurrentWrites()) {
+				// Postprocess the batch's images as parallel tasks, helping from this thread
+				TaskGroup group(pool);
+				for (size_t i = 0; i < items.size(); i++) {
+					group.Run([&, i]() {
+						records[i].resize(output_count);
+						writeOutput(out_data + i * output_count * element_size, output_count, records[i].data(), output_type);
+						sink.Write(items[i].first, records[i].data(), output_count);
+					});
+				}
+				group.Wait();
+			}
+			else {
+				records[0].resize(output_count);
+				for (size_t i = 0; i < items.size(); i++) {
+					writeOutput(out_data + i * output_count * element_size, output_count, records[0].data(), output_type);
+					sink.Write(items[i].first, records[0].data(), output_count);
+				}
+			}
+			ort->ReleaseValue(output_tensor);
+			stats->processed_count += static_cast<int>(items.size());
+		}
+
+		// Stop claiming images and let decode tasks still in flight finish with the slots
+		next_image = image_count;
+		queue.WaitIdle();
+		ort->ReleaseMemoryInfo(memory_info);
+
+		bool sink_succeeded = sink.End(output_count, stats->processed_count);
+
+		stats->failed_count = failed;
+		stats->elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats->images_per_second = stats->elapsed_seconds > 0.0 ? stats->processed_count / stats->elapsed_seconds : 0.0;
+		stats->mean_run_ms = stats->batch_count > 0 ? run_ms / stats->batch_count : 0.0;
+
+		if (run_failed || !sink_succeeded) return -1;
+		return stats->processed_count;
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Run the loaded model over every image in a directory and write the outputs to a binary results file.
+	/// Images are decoded and preprocessed on task pool workers ahead of inference and run in batches.
+	/// Every image must match the dimensions the model was loaded with.
+	/// </summary>
+	/// <param name="directory">Directory of .png, .jpg, .bmp, .ppm or .raw (interleaved RGB) images.</param>
+	/// <param name="results_path">Path of the results file to write (see batch.h for the layout).</param>
+	/// <param name="batch_size">Images per session run. Ignored if the model's batch dimension is fixed.</param>
+	/// <param name="decode_threads">Number of workers in a decode pool dedicated to the run, or 0 to use the plugin's shared task pool.</param>
+	/// <param name="flip_rows">Nonzero to flip images vertically, matching the bottom-up row order of Unity textures.</param>
+	/// <param name="stats">Receives the image counts and throughput.</param>
+	/// <returns>The number of images processed, or -1 if no model is loaded, a file could not be opened, or a session run failed.</returns>
+	DLLExport int ProcessImageDirectory(const char* directory, const char* results_path, int batch_size, int decode_threads, int flip_rows, BatchStats* stats) {
+		ResultsFileSink sink(results_path);
+		return runImageDirectory(directory, batch_size, decode_threads, flip_rows, sink, stats);
+	}
+
+	/// <summary>
+	/// Run a YOLOX model over every image in a directory and write the detections to a memory-mappable
+	/// detection file (see detection_file.h). Image indices follow the directory's name order.
+	/// </summary>
+	/// <param name="directory">Directory of .png, .jpg, .bmp, .ppm or .raw (interleaved RGB) images.</param>
+	/// <param name="detections_path">Path of the detection file to create.</param>
+	/// <param name="batch_size">Images per session run. Ignored if the model's batch dimension is fixed.</param>
+	/// <param name="decode_threads">Number of workers in a decode pool dedicated to the run, or 0 to use the plugin's shared task pool.</param>
+	/// <param name="flip_rows">Nonzero to flip images vertically, matching the bottom-up row order of Unity textures.</param>
+	/// <param name="score_threshold">Minimum score of a detection.</param>
+	/// <param name="iou_threshold">Overlap above which the lower-scoring of two boxes is suppressed.</param>
+	/// <param name="stats">Receives the image counts and throughput.</param>
+	/// <returns>The number of images processed, or -1 if no model is loaded, a file could not be opened, a session run failed, or the output is not a YOLOX head.</returns>
+	DLLExport int ProcessImageDirectoryDetections(const char* directory, const char* detections_path, int batch_size, int decode_threads, int flip_rows, float score_threshold, float iou_threshold, BatchStats* stats) {
+		DetectionFileSink sink(detections_path, score_threshold, iou_threshold);
+		return runImageDirectory(directory, batch_size, decode_threads, flip_rows, sink, stats);
+	}
+}
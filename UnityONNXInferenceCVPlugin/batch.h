@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// Batch results file layout:
+//   header:  magic "OCVB", uint32 version, uint32 image count, uint32 output elements per image, uint32 record count
+//   names:   image count entries of uint16 byte length + UTF-8 file name, in directory order
+//   records: record count entries of uint32 image index + output elements as float32
+// Records follow completion order; images that fail to decode have no record.
+const char batch_results_magic[4] = { 'O', 'C', 'V', 'B' };
+const uint32_t batch_results_version = 1;
+
+/// <summary>
+/// Summary of a ProcessImageDirectory run.
+/// </summary>
+struct BatchStats {
+	int image_count;                  // Supported image files found in the directory
+	int processed_count;              // Images decoded, run and written to the results file
+	int failed_count;                 // Images skipped because they failed to decode or did not match the model's image dimensions
+	int batch_count;                  // Session runs
+	int batch_size;                   // Images per session run, after applying the model's batch dimension
+	double elapsed_seconds;           // Wall-clock time from the first decode to the last record written
+	double images_per_second;         // processed_count / elapsed_seconds
+	double mean_run_ms;               // Mean time per session run
+};
@@ -0,0 +1,788 @@
+#include "pch.h"
+#include "plugin.h"
+#include "affinity.h"
+#include "alloc_count.h"
+#include "ann_index.h"
+#include "mask_encoding.h"
+#include "numa.h"
+#include "segmentation.h"
+#include "task_pool.h"
+#include <psapi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+	const int warmup_iterations = 3;  // Untimed iterations run before each stage to warm caches and arenas
+
+	/// <summary>
+	/// Timing summary for one benchmark stage.
+	/// </summary>
+	struct StageResult {
+		std::string name;                 // "<model>/<stage>"
+		double median_us;                 // Median time per iteration
+		double p90_us;                    // 90th percentile time per iteration
+		double min_us;                    // Fastest iteration
+		double baseline_median_us = -1.0; // Median from the baseline file, or -1 if the stage is new
+		bool regressed = false;           // Whether the median exceeds the baseline by more than the tolerance
+	};
+
+	/// <summary>
+	/// Run a stage repeatedly and summarize its per-iteration time.
+	/// </summary>
+	StageResult timeStage(const std::string& name, int iterations, const std::function<void()>& body) {
+		for (int i = 0; i < warmup_iterations; i++) body();
+
+		std::vector<double> times(iterations);
+		for (int i = 0; i < iterations; i++) {
+			auto start = std::chrono::steady_clock::now();
+			body();
+			auto end = std::chrono::steady_clock::now();
+			times[i] = std::chrono::duration<double, std::micro>(end - start).count();
+		}
+		std::sort(times.begin(), times.end());
+
+		StageResult result;
+		result.name = name;
+		result.median_us = times[times.size() / 2];
+		result.p90_us = times[std::min(times.size() - 1, static_cast<size_t>(times.size() * 0.9))];
+		result.min_us = times.front();
+		return result;
+	}
+
+	/// <summary>
+	/// Split a separator-delimited list, skipping empty entries.
+	/// </summary>
+	std::vector<std::string> splitList(const std::string& list, char separator) {
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, separator)) {
+			if (!item.empty()) items.push_back(item);
+		}
+		return items;
+	}
+
+	/// <summary>
+	/// Get a model's file name without its directory or extension.
+	/// </summary>
+	std::string modelStem(const std::string& path) {
+		size_t start = path.find_last_of("/\\");
+		start = (start == std::string::npos) ? 0 : start + 1;
+		size_t end = path.find_last_of('.');
+		if (end == std::string::npos || end < start) end = path.size();
+		return path.substr(start, end - start);
+	}
+
+	/// <summary>
+	/// Read stage medians from a results file written by a previous run.
+	/// </summary>
+	std::map<std::string, double> readBaseline(const std::string& path) {
+		std::map<std::string, double> baseline;
+		std::ifstream file(path);
+		if (!file) return baseline;
+
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		std::string text = buffer.str();
+
+		// Each stage object lists its name before its median
+		const std::string name_key = "\"name\": \"";
+		const std::string median_key = "\"median_us\": ";
+		size_t pos = 0;
+		while ((pos = text.find(name_key, pos)) != std::string::npos) {
+			pos += name_key.size();
+			size_t name_end = text.find('"', pos);
+			size_t median_pos = text.find(median_key, name_end);
+			if (name_end == std::string::npos || median_pos == std::string::npos) break;
+
+			baseline[text.substr(pos, name_end - pos)] = std::atof(text.c_str() + median_pos + median_key.size());
+			pos = median_pos;
+		}
+		return baseline;
+	}
+
+	/// <summary>
+	/// Write stage results as JSON.
+	/// </summary>
+	bool writeResults(const std::string& path, const std::vector<StageResult>& results, float tolerance) {
+		std::ofstream file(path);
+		if (!file) return false;
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\n  \"version\": 1,\n  \"tolerance\": " << tolerance << ",\n  \"stages\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const StageResult& result = results[i];
+			file << "    { \"name\": \"" << result.name << "\""
+				<< ", \"median_us\": " << result.median_us
+				<< ", \"p90_us\": " << result.p90_us
+				<< ", \"min_us\": " << result.min_us
+				<< ", \"baseline_median_us\": " << result.baseline_median_us
+				<< ", \"regressed\": " << (result.regressed ? "true" : "false")
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return static_cast<bool>(file);
+	}
+
+	/// <summary>
+	/// Benchmark every inference stage for the currently loaded model.
+	/// </summary>
+	/// <returns>False if no model is loaded or the session failed to run.</returns>
+	bool benchmarkLoadedModel(const std::string& model_name, int iterations, std::vector<StageResult>& results) {
+		// Hold the model for the whole benchmark, so a reload cannot release its session underneath
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return false;
+		OrtSession* session = model->replicas.front()->session;
+		ONNXTensorElementDataType input_type = model->input_type;
+
+		// Deterministic synthetic frame so runs are comparable
+		std::vector<byte> image(static_cast<size_t>(model->n_pixels) * n_channels);
+		uint32_t seed = 12345;
+		for (byte& value : image) {
+			seed = seed * 1664525u + 1013904223u;
+			value = static_cast<byte>(seed >> 24);
+		}
+		std::vector<uint8_t> input(inputTensorBytes(input_type, model->n_pixels));
+
+		results.push_back(timeStage(model_name + "/preprocess", iterations, [&]() {
+			preprocessInput(image.data(), input.data(), input_type, model->n_pixels);
+		}));
+
+		results.push_back(timeStage(model_name + "/tensor_setup", iterations, [&]() {
+			ort->ReleaseValue(createInputTensor(input.data(), input_type, model->input_w, model->input_h));
+		}));
+
+		// Run the session once up front to validate it and size the output buffer
+		const char* input_names[] = { model->input_name.c_str() };
+		const char* output_names[] = { model->output_name.c_str() };
+		OrtValue* input_tensor = createInputTensor(input.data(), input_type, model->input_w, model->input_h);
+		OrtValue* output_tensor = nullptr;
+		OrtStatus* status = ort->Run(session, nullptr, input_names, (const OrtValue* const*)&input_tensor, 1, output_names, 1, &output_tensor);
+		if (status) {
+			ort->ReleaseStatus(status);
+			ort->ReleaseValue(input_tensor);
+			return false;
+		}
+
+		results.push_back(timeStage(model_name + "/session_run", iterations, [&]() {
+			OrtValue* output = nullptr;
+			ort->Run(session, nullptr, input_names, (const OrtValue* const*)&input_tensor, 1, output_names, 1, &output);
+			if (output) ort->ReleaseValue(output);
+		}));
+
+		// Copy the full output tensor, as PerformInference does
+		OrtTensorTypeAndShapeInfo* output_info;
+		size_t output_count;
+		ort->GetTensorTypeAndShape(output_tensor, &output_info);
+		ort->GetTensorShapeElementCount(output_info, &output_count);
+		ort->ReleaseTensorTypeAndShapeInfo(output_info);
+		std::vector<float> output(output_count);
+
+		results.push_back(timeStage(model_name + "/postprocess", iterations, [&]() {
+			copyOutput(output_tensor, output.data(), static_cast<int>(output.size()), model->output_type);
+		}));
+
+		ort->ReleaseValue(input_tensor);
+		ort->ReleaseValue(output_tensor);
+		return true;
+	}
+
+	/// <summary>
+	/// Read the process's private bytes and working set, in MB.
+	/// </summary>
+	void processMemoryMb(double& private_mb, double& working_set_mb) {
+		PROCESS_MEMORY_COUNTERS_EX counters = {};
+		counters.cb = sizeof(counters);
+		GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
+		private_mb = counters.PrivateUsage / (1024.0 * 1024.0);
+		working_set_mb = counters.WorkingSetSize / (1024.0 * 1024.0);
+	}
+
+	/// <summary>
+	/// Tracks the process's peak private bytes and working set while it is alive by sampling them on a background
+	/// thread. The operating system only records the peak working set over the process lifetime, which earlier loads dominate.
+	/// </summary>
+	class PeakMemorySampler {
+	public:
+		PeakMemorySampler() {
+			processMemoryMb(peak_private_mb, peak_working_set_mb);
+			sampler = std::thread([this]() {
+				while (!stopping) {
+					sample();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			});
+		}
+
+		/// <summary>
+		/// Stop sampling and report the highest private bytes and working set seen, in MB.
+		/// </summary>
+		void Stop(double& private_mb, double& working_set_mb) {
+			stopping = true;
+			if (sampler.joinable()) sampler.join();
+			sample();
+			private_mb = peak_private_mb;
+			working_set_mb = peak_working_set_mb;
+		}
+
+		~PeakMemorySampler() {
+			stopping = true;
+			if (sampler.joinable()) sampler.join();
+		}
+
+	private:
+		void sample() {
+			double private_mb, working_set_mb;
+			processMemoryMb(private_mb, working_set_mb);
+			peak_private_mb = std::max(peak_private_mb, private_mb);
+			peak_working_set_mb = std::max(peak_working_set_mb, working_set_mb);
+		}
+
+		std::atomic<bool> stopping{ false };
+		double peak_private_mb = 0.0;     // Written by the sampler thread until Stop joins it
+		double peak_working_set_mb = 0.0;
+		std::thread sampler;
+	};
+
+	/// <summary>
+	/// Thread pool with one shared, locked FIFO queue: the baseline the work-stealing pool is measured against.
+	/// </summary>
+	class LockedTaskQueue {
+	public:
+		explicit LockedTaskQueue(int worker_count) {
+			for (int i = 0; i < worker_count; i++) {
+				workers.emplace_back([this]() {
+					std::unique_lock<std::mutex> lock(mutex);
+					while (true) {
+						task_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+						if (tasks.empty()) return;
+						std::function<void()> task = std::move(tasks.front());
+						tasks.pop_front();
+						lock.unlock();
+						task();
+						lock.lock();
+					}
+				});
+			}
+		}
+
+		~LockedTaskQueue() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			task_ready.notify_all();
+			for (std::thread& worker : workers) worker.join();
+		}
+
+		void Submit(std::function<void()> task) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				tasks.push_back(std::move(task));
+			}
+			task_ready.notify_one();
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable task_ready;
+		std::deque<std::function<void()>> tasks;
+		std::vector<std::thread> workers;
+		bool stopping = false;
+	};
+
+	std::atomic<uint32_t> spin_sink{ 0 };     // Keeps spinWork from being optimized away
+
+	/// <summary>
+	/// Burn a fixed amount of CPU time, standing in for a pre- or postprocessing task.
+	/// </summary>
+	void spinWork(int iterations) {
+		uint32_t state = static_cast<uint32_t>(iterations);
+		for (int i = 0; i < iterations; i++) state = state * 1664525u + 1013904223u;
+		spin_sink += state;
+	}
+
+	/// <summary>
+	/// Run a mix of uneven tasks resembling per-request pre- and postprocessing: mostly small crops and
+	/// conversions, some medium decodes and a few large NMS passes, each spawning small child tasks.
+	/// </summary>
+	/// <returns>Tasks completed per second.</returns>
+	template <typename Pool>
+	double runMixedTasks(Pool& pool, int task_count) {
+		const int children = 4;
+		std::atomic<int> remaining{ task_count * (1 + children) };
+		std::mutex done_mutex;
+		std::condition_variable done;
+		auto finish = [&]() {
+			if (--remaining == 0) {
+				std::lock_guard<std::mutex> lock(done_mutex);
+				done.notify_all();
+			}
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < task_count; i++) {
+			// 80% small, 15% medium and 5% large tasks, interleaved deterministically
+			int bucket = (i * 37) % 100;
+			int iterations = bucket < 80 ? 500 : bucket < 95 ? 20000 : 200000;
+			pool.Submit([&, iterations]() {
+				spinWork(iterations);
+				for (int c = 0; c < children; c++) {
+					pool.Submit([&]() {
+						spinWork(500);
+						finish();
+					});
+				}
+				finish();
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done.wait(lock, [&]() { return remaining == 0; });
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return task_count * (1 + children) / seconds;
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Benchmark preprocessing, tensor setup, session run and postprocessing for a set of reference models
+	/// and compare the results against a stored baseline. Replaces any currently loaded model.
+	/// </summary>
+	/// <param name="model_paths">Semicolon-separated list of ONNX model paths, run on the CPU provider.</param>
+	/// <param name="image_dims">Dimensions of the synthetic input image [width, height].</param>
+	/// <param name="iterations">Number of timed iterations per stage.</param>
+	/// <param name="results_path">Path of the JSON results file to write.</param>
+	/// <param name="baseline_path">Path of a previous results file to compare against, or an empty string.</param>
+	/// <param name="tolerance">Allowed fractional slowdown of a stage's median (e.g., 0.1 for 10%).</param>
+	/// <returns>The number of regressed stages, or -1 if a model failed to load or run.</returns>
+	DLLExport int RunBenchmarks(const char* model_paths, int image_dims[2], int iterations, const char* results_path, const char* baseline_path, float tolerance) {
+		std::vector<StageResult> results;
+		iterations = std::max(iterations, 1);
+
+		for (const std::string& model_path : splitList(model_paths, ';')) {
+			FreeResources();
+			LoadModel(model_path.c_str(), "CPU", image_dims);
+			if (!benchmarkLoadedModel(modelStem(model_path), iterations, results)) {
+				FreeResources();
+				return -1;
+			}
+		}
+		FreeResources();
+
+		// Flag stages whose median slowed down beyond the tolerance
+		std::map<std::string, double> baseline = readBaseline(baseline_path);
+		int regressions = 0;
+		for (StageResult& result : results) {
+			auto entry = baseline.find(result.name);
+			if (entry == baseline.end()) continue;
+
+			result.baseline_median_us = entry->second;
+			result.regressed = result.median_us > entry->second * (1.0 + tolerance);
+			if (result.regressed) regressions++;
+		}
+
+		if (!writeResults(results_path, results, tolerance)) return -1;
+		return regressions;
+	}
+
+	/// <summary>
+	/// Measure PerformInference throughput on the loaded model with 1..max_threads concurrent callers.
+	/// Disable the result cache first, or every call after the first will be a cache hit.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes, shared by every caller.</param>
+	/// <param name="length">Length of the output array each caller passes to PerformInference.</param>
+	/// <param name="max_threads">Largest number of concurrent callers to measure.</param>
+	/// <param name="frames_per_thread">Number of PerformInference calls made by each caller.</param>
+	/// <param name="throughput">Array of max_threads entries receiving frames per second for 1..max_threads callers.</param>
+	/// <returns></returns>
+	DLLExport void BenchmarkConcurrentInference(byte* image_data, int length, int max_threads, int frames_per_thread, double* throughput) {
+		for (int thread_count = 1; thread_count <= max_threads; thread_count++) {
+			std::vector<std::vector<float>> outputs(thread_count, std::vector<float>(length));
+			std::vector<std::thread> threads;
+
+			auto start = std::chrono::steady_clock::now();
+			for (int t = 0; t < thread_count; t++) {
+				threads.emplace_back([&, t]() {
+					initWorkerThread();
+					for (int i = 0; i < frames_per_thread; i++) {
+						PerformInference(image_data, outputs[t].data(), length);
+					}
+				});
+			}
+			for (std::thread& thread : threads) thread.join();
+			auto end = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count();
+			throughput[thread_count - 1] = thread_count * frames_per_thread / seconds;
+		}
+	}
+
+	/// <summary>
+	/// Count the heap allocations made by warm PerformInference calls on the loaded model, to check that
+	/// steady-state inference allocates nothing; the expected result is 0. Counts operator new in the plugin's
+	/// own code, not allocations inside ONNX Runtime, and only in builds with PLUGIN_COUNT_ALLOCATIONS (the Debug
+	/// configurations). Disable the result cache first, or every counted call will be a cache hit.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="length">Length of the output array passed to PerformInference.</param>
+	/// <param name="warmup">Number of uncounted calls made first, which fill ONNX Runtime's arenas and the plugin's lazily sized buffers.</param>
+	/// <param name="iterations">Number of counted calls.</param>
+	/// <returns>The number of allocations made during the counted calls, or -1 if no model is loaded or counting is not built in.</returns>
+	DLLExport long long CountSteadyStateAllocations(byte* image_data, int length, int warmup, int iterations) {
+		if (!std::atomic_load(&loaded_model)) return -1;
+		std::vector<float> output(length);
+
+		for (int i = 0; i < warmup; i++) PerformInference(image_data, output.data(), length);
+		beginAllocationCount();
+		for (int i = 0; i < iterations; i++) PerformInference(image_data, output.data(), length);
+		return endAllocationCount();
+	}
+
+	/// <summary>
+	/// Compare PerformInference latency with and without the denormals_as_zero load option.
+	/// Replaces any currently loaded model.
+	/// </summary>
+	/// <param name="model_path">Path to the ONNX model file, run on the CPU provider.</param>
+	/// <param name="image_dims">Dimensions of the synthetic input image [width, height].</param>
+	/// <param name="iterations">Number of timed iterations per mode.</param>
+	/// <param name="median_ms">Array of two entries receiving the median latency with denormals preserved and flushed.</param>
+	/// <returns>0 on success, or -1 if the model failed to load.</returns>
+	DLLExport int BenchmarkDenormalModes(const char* model_path, int image_dims[2], int iterations, double* median_ms) {
+		const char* modes[] = { "denormals_as_zero=0", "denormals_as_zero=1" };
+		std::vector<byte> image(static_cast<size_t>(image_dims[0]) * image_dims[1] * n_channels, 128);
+
+		for (int mode = 0; mode < 2; mode++) {
+			FreeResources();
+			LoadModelWithOptions(model_path, "CPU", image_dims, modes[mode]);
+			if (!std::atomic_load(&loaded_model)) return -1;
+
+			StageResult result = timeStage(modes[mode], std::max(iterations, 1), [&]() {
+				float unused;
+				PerformInference(image.data(), &unused, 0);
+			});
+			median_ms[mode] = result.median_us / 1000.0;
+		}
+
+		FreeResources();
+		return 0;
+	}
+
+	/// <summary>
+	/// Measure PerformInference throughput with callers pinned to every NUMA node at once.
+	/// Load the model with numa_replicas=1 to serve each node from local memory, or without it to compare
+	/// against a single session shared across sockets. Disable the result cache first.
+	/// Also checks where the request buffers ended up, since a buffer bound to the wrong node looks like a slow node.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes, shared by every caller.</param>
+	/// <param name="length">Length of the output array each caller passes to PerformInference.</param>
+	/// <param name="threads_per_node">Number of concurrent callers pinned to each node.</param>
+	/// <param name="frames_per_thread">Number of PerformInference calls made by each caller.</param>
+	/// <param name="throughput">Array of GetNumaNodeCount() entries receiving frames per second completed by each node's callers.</param>
+	/// <param name="local_pages">Receives the fraction of the request buffers' resident pages that are on the node they were
+	/// allocated for, or -1 if the model binds no buffers to a node.</param>
+	/// <returns></returns>
+	DLLExport void BenchmarkNumaThroughput(byte* image_data, int length, int threads_per_node, int frames_per_thread, double* throughput, double* local_pages) {
+		int node_count = numaNodeCount();
+		std::vector<double> node_seconds(static_cast<size_t>(node_count) * threads_per_node);
+		std::vector<std::thread> threads;
+
+		for (int node = 0; node < node_count; node++) {
+			for (int t = 0; t < threads_per_node; t++) {
+				threads.emplace_back([&, node, t]() {
+					// Keep the caller and its output buffer on the node
+					initWorkerThread();
+					pinCurrentThread(numaNodeCpus(node));
+					std::vector<float, NumaAllocator<float>> output(length, 0.0f, NumaAllocator<float>(node));
+
+					auto start = std::chrono::steady_clock::now();
+					for (int i = 0; i < frames_per_thread; i++) {
+						PerformInference(image_data, output.data(), length);
+					}
+					auto end = std::chrono::steady_clock::now();
+					node_seconds[static_cast<size_t>(node) * threads_per_node + t] = std::chrono::duration<double>(end - start).count();
+				});
+			}
+		}
+		for (std::thread& thread : threads) thread.join();
+
+		// Each node's rate is its frames over its slowest caller's time
+		for (int node = 0; node < node_count; node++) {
+			auto first = node_seconds.begin() + static_cast<size_t>(node) * threads_per_node;
+			double seconds = *std::max_element(first, first + threads_per_node);
+			throughput[node] = threads_per_node * frames_per_thread / seconds;
+		}
+
+		// The callers have touched the buffers, so their pages are resident
+		size_t resident_pages = 0;
+		size_t node_pages = 0;
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (model) {
+			for (auto& replica : model->replicas) replica->pool.GetPagePlacement(resident_pages, node_pages);
+		}
+		*local_pages = resident_pages ? static_cast<double>(node_pages) / resident_pages : -1.0;
+	}
+
+	/// <summary>
+	/// Compare the work-stealing task pool used for pre- and postprocessing against a single locked queue
+	/// on a mixed workload of small, medium and large tasks that spawn child tasks.
+	/// </summary>
+	/// <param name="task_count">Number of top-level tasks; each spawns four small child tasks.</param>
+	/// <param name="workers">Worker threads in each pool, or 0 for one per logical processor.</param>
+	/// <param name="tasks_per_second">Array of two entries receiving the throughput of the work-stealing pool and of the locked queue.</param>
+	/// <returns>0 on success, or -1 if task_count is not positive.</returns>
+	DLLExport int BenchmarkTaskPool(int task_count, int workers, double* tasks_per_second) {
+		if (task_count <= 0) return -1;
+		if (workers <= 0) workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+		{
+			TaskPool pool(workers);
+			runMixedTasks(pool, std::min(task_count, 100));
+			tasks_per_second[0] = runMixedTasks(pool, task_count);
+		}
+		{
+			LockedTaskQueue pool(workers);
+			runMixedTasks(pool, std::min(task_count, 100));
+			tasks_per_second[1] = runMixedTasks(pool, task_count);
+		}
+		return 0;
+	}
+
+	/// <summary>
+	/// Load, run and unload a model repeatedly to check that the load path does not leak: private bytes after
+	/// the last cycle may exceed those after the first by at most max_growth_mb. Replaces any currently loaded model.
+	/// </summary>
+	/// <param name="model_path">Path to the ONNX model file.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="image_dims">Dimensions of the synthetic input image [width, height].</param>
+	/// <param name="options">Load options, as for LoadModelWithOptions.</param>
+	/// <param name="cycles">Number of load/unload cycles, e.g., several thousand.</param>
+	/// <param name="max_growth_mb">Largest allowed rise in private bytes from the first cycle to the last, in MB, e.g., 4.</param>
+	/// <param name="memory_mb">Array of four entries receiving the private bytes and working set in MB after the first cycle, then after the last.</param>
+	/// <returns>0 if memory stayed within max_growth_mb, 1 if it grew by more, or -1 if cycles is not positive or a load failed.</returns>
+	DLLExport int SoakLoadUnload(const char* model_path, const char* execution_provider, int image_dims[2], const char* options, int cycles, double max_growth_mb, double* memory_mb) {
+		if (cycles <= 0) return -1;
+		std::vector<byte> image(static_cast<size_t>(image_dims[0]) * image_dims[1] * n_channels, 128);
+
+		for (int cycle = 0; cycle < cycles; cycle++) {
+			std::string message = LoadModelWithOptions(model_path, execution_provider, image_dims, options);
+			if (message != "Model loaded successfully.") return -1;
+
+			float unused;
+			PerformInference(image.data(), &unused, 0);
+			FreeResources();
+
+			// The first cycle pays for one-time allocations, such as ONNX Runtime's kernel registries
+			if (cycle == 0) processMemoryMb(memory_mb[0], memory_mb[1]);
+		}
+		processMemoryMb(memory_mb[2], memory_mb[3]);
+		return (memory_mb[2] - memory_mb[0] > max_growth_mb) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Measure how long a model takes to load and how much memory loading it needs, e.g., to compare an
+	/// LZ4-compressed model file against the uncompressed one, or an external-data model loaded with and
+	/// without map_external_data. Replaces any currently loaded model.
+	/// </summary>
+	/// <param name="model_path">Path to the ONNX model file, which may be compressed.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="image_dims">Dimensions of the input image [width, height].</param>
+	/// <param name="options">Load options, as for LoadModelWithOptions.</param>
+	/// <param name="runs">Number of timed loads, each followed by FreeResources.</param>
+	/// <param name="results">Array of four entries receiving the median load time in ms, the largest rises in private bytes
+	/// and in working set during a load in MB, and the private bytes the loaded model keeps in MB.</param>
+	/// <returns>0 on success, or -1 if runs is not positive or a load failed.</returns>
+	DLLExport int BenchmarkModelLoad(const char* model_path, const char* execution_provider, int image_dims[2], const char* options, int runs, double* results) {
+		if (runs <= 0) return -1;
+
+		// One untimed load creates the runtime context and ONNX Runtime's one-time allocations
+		std::string message = LoadModelWithOptions(model_path, execution_provider, image_dims, options);
+		FreeResources();
+		if (message != "Model loaded successfully.") return -1;
+
+		std::vector<double> load_ms;
+		double private_rise_mb = 0.0;
+		double working_set_rise_mb = 0.0;
+		double resident_mb = 0.0;
+		for (int run = 0; run < runs; run++) {
+			double before_private_mb, before_working_set_mb;
+			processMemoryMb(before_private_mb, before_working_set_mb);
+
+			PeakMemorySampler sampler;
+			auto start = std::chrono::steady_clock::now();
+			message = LoadModelWithOptions(model_path, execution_provider, image_dims, options);
+			load_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			double peak_private_mb, peak_working_set_mb;
+			sampler.Stop(peak_private_mb, peak_working_set_mb);
+			private_rise_mb = std::max(private_rise_mb, peak_private_mb - before_private_mb);
+			working_set_rise_mb = std::max(working_set_rise_mb, peak_working_set_mb - before_working_set_mb);
+
+			double loaded_mb, unused;
+			processMemoryMb(loaded_mb, unused);
+			resident_mb = std::max(resident_mb, loaded_mb - before_private_mb);
+			FreeResources();
+			if (message != "Model loaded successfully.") return -1;
+		}
+
+		std::sort(load_ms.begin(), load_ms.end());
+		results[0] = load_ms[load_ms.size() / 2];
+		results[1] = private_rise_mb;
+		results[2] = working_set_rise_mb;
+		results[3] = resident_mb;
+		return 0;
+	}
+
+	/// <summary>
+	/// Compare the size and latency of instance mask encodings on one frame of the loaded segmentation model:
+	/// float masks at image resolution, as returning them through output_array would need, bit-packed masks
+	/// and run-length encoded masks.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="options">Thresholds and detection limit for PerformInferenceInstanceMasks; the encoding is ignored.</param>
+	/// <param name="iterations">Number of timed iterations of each stage.</param>
+	/// <param name="results">Array of seven entries receiving the bytes per frame of float, bit-packed and run-length encoded masks,
+	/// the median time in ms of PerformInferenceInstanceMasks with bit-packed and with run-length encoded masks, and the median
+	/// time in ms to decode the frame's masks into a label image from each encoding.</param>
+	/// <returns>0 on success, or -1 if iterations is not positive or the model could not be run.</returns>
+	DLLExport int BenchmarkMaskEncodings(byte* image_data, const InstanceMaskOptions* options, int iterations, double* results) {
+		if (iterations <= 0) return -1;
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return -1;
+
+		const MaskEncoding encodings[] = { MaskEncoding::Bits, MaskEncoding::Rle };
+		std::vector<uint8_t> labels(model->n_pixels);
+		int detections = 0;
+		for (int e = 0; e < 2; e++) {
+			InstanceMaskOptions encoding_options = *options;
+			encoding_options.encoding = static_cast<int>(encodings[e]);
+
+			// A first run without buffers measures what the frame needs
+			InstanceMaskInfo info = {};
+			if (PerformInferenceInstanceMasks(image_data, &encoding_options, nullptr, 0, nullptr, 0, &info) < 0) return -1;
+			std::vector<InstanceMask> masks(std::max(info.detections, 1));
+			std::vector<uint8_t> mask_data(std::max(info.mask_bytes, 1));
+
+			bool failed = false;
+			int count = 0;
+			StageResult run = timeStage("masks", iterations, [&]() {
+				count = PerformInferenceInstanceMasks(image_data, &encoding_options, masks.data(), static_cast<int>(masks.size()),
+					mask_data.data(), static_cast<int>(mask_data.size()), &info);
+				failed = failed || count < 0;
+			});
+			if (failed) return -1;
+
+			// Every instance is painted with its own label, as for an overlay
+			StageResult decode = timeStage("decode", iterations, [&]() {
+				std::fill(labels.begin(), labels.end(), static_cast<uint8_t>(0));
+				for (int m = 0; m < count; m++) {
+					DecodeInstanceMask(&masks[m], mask_data.data(), encoding_options.encoding, labels.data(), model->input_w, model->input_h, static_cast<uint8_t>(m + 1), 0);
+				}
+			});
+
+			detections = info.detections;
+			results[1 + e] = info.mask_bytes;
+			results[3 + e] = run.median_us / 1000.0;
+			results[5 + e] = decode.median_us / 1000.0;
+		}
+		results[0] = static_cast<double>(detections) * model->n_pixels * sizeof(float);
+		return 0;
+	}
+
+	/// <summary>
+	/// Measure the recall and latency of the approximate nearest-neighbor index against an exhaustive gallery search
+	/// on synthetic clustered embeddings, for a range of search widths. Needs no loaded model.
+	/// </summary>
+	/// <param name="count">Number of embeddings to index.</param>
+	/// <param name="dimension">Elements per embedding.</param>
+	/// <param name="queries">Number of queries, drawn from the same clusters as the embeddings.</param>
+	/// <param name="top_k">Matches per query; recall is the share of the exact top_k the index also returns.</param>
+	/// <param name="max_links">Neighbors per node of the index.</param>
+	/// <param name="ef_construction">Candidates considered when inserting into the index.</param>
+	/// <param name="ef_values">Search widths to measure.</param>
+	/// <param name="ef_count">Number of search widths.</param>
+	/// <param name="results">Array of 3 + 2 * ef_count entries receiving the build time in ms, the index size in MB, the mean
+	/// time in us of an exhaustive search, then the mean recall and mean time in us of an index search for each search width.</param>
+	/// <returns>0 on success, or -1 if a count is not positive or the index settings are out of range.</returns>
+	DLLExport int BenchmarkAnnIndex(int count, int dimension, int queries, int top_k, int max_links, int ef_construction,
+		const int* ef_values, int ef_count, double* results) {
+		if (count <= 0 || dimension <= 0 || queries <= 0 || top_k <= 0 || ef_count <= 0) return -1;
+		if (max_links < 2 || max_links > 64 || ef_construction < 1) return -1;
+
+		// Embeddings scattered around random cluster centers, like identities seen from several views
+		std::mt19937 generator(1234);
+		std::normal_distribution<float> normal(0.0f, 1.0f);
+		int cluster_count = std::max(1, count / 64);
+		std::vector<float> centers(static_cast<size_t>(cluster_count) * dimension);
+		for (float& value : centers) value = normal(generator);
+		std::uniform_int_distribution<int> pick_cluster(0, cluster_count - 1);
+		auto drawEmbedding = [&](float* embedding) {
+			const float* center = centers.data() + static_cast<size_t>(pick_cluster(generator)) * dimension;
+			for (int i = 0; i < dimension; i++) embedding[i] = center[i] + 0.5f * normal(generator);
+			normalizeEmbedding(embedding, dimension);
+		};
+		std::vector<float> embeddings(static_cast<size_t>(count) * dimension);
+		std::vector<float> query_embeddings(static_cast<size_t>(queries) * dimension);
+		for (int i = 0; i < count; i++) drawEmbedding(embeddings.data() + static_cast<size_t>(i) * dimension);
+		for (int q = 0; q < queries; q++) drawEmbedding(query_embeddings.data() + static_cast<size_t>(q) * dimension);
+
+		EmbeddingGallery gallery;
+		AnnIndex index(max_links, ef_construction);
+		for (int i = 0; i < count; i++) gallery.Add(i, embeddings.data() + static_cast<size_t>(i) * dimension, dimension);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++) index.Add(i, embeddings.data() + static_cast<size_t>(i) * dimension, dimension);
+		results[0] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		results[1] = index.Bytes() / (1024.0 * 1024.0);
+
+		// Exact matches to measure recall against
+		std::vector<GalleryMatch> exact(static_cast<size_t>(queries) * top_k);
+		std::vector<int> exact_counts(queries);
+		start = std::chrono::steady_clock::now();
+		for (int q = 0; q < queries; q++) {
+			exact_counts[q] = gallery.Search(query_embeddings.data() + static_cast<size_t>(q) * dimension, dimension, top_k, exact.data() + static_cast<size_t>(q) * top_k);
+		}
+		results[2] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / queries;
+
+		std::vector<GalleryMatch> approximate(static_cast<size_t>(queries) * top_k);
+		std::vector<int> approximate_counts(queries);
+		for (int e = 0; e < ef_count; e++) {
+			start = std::chrono::steady_clock::now();
+			for (int q = 0; q < queries; q++) {
+				approximate_counts[q] = index.Search(query_embeddings.data() + static_cast<size_t>(q) * dimension, dimension, top_k, ef_values[e],
+					approximate.data() + static_cast<size_t>(q) * top_k);
+			}
+			double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+			double recall = 0.0;
+			for (int q = 0; q < queries; q++) {
+				const GalleryMatch* expected = exact.data() + static_cast<size_t>(q) * top_k;
+				const GalleryMatch* found = approximate.data() + static_cast<size_t>(q) * top_k;
+				int hits = 0;
+				for (int i = 0; i < approximate_counts[q]; i++) {
+					for (int j = 0; j < exact_counts[q]; j++) {
+						if (found[i].id == expected[j].id) {
+							hits++;
+							break;
+						}
+					}
+				}
+				recall += exact_counts[q] > 0 ? static_cast<double>(hits) / exact_counts[q] : 1.0;
+			}
+			results[3 + 2 * e] = recall / queries;
+			results[4 + 2 * e] = elapsed_us / queries;
+		}
+		return 0;
+	}
+}
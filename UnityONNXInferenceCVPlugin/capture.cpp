@@ -0,0 +1,299 @@
+#include "pch.h"
+#include "plugin.h"
+#include "capture.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+	CaptureWriter capture_writer;                 // The active capture file, if any
+	std::atomic<bool> capturing{ false };         // Fast check for the PerformInference hot path
+
+	// Parameters of the most recent LoadModel call, written at the start of every capture
+	std::mutex last_load_mutex;
+	bool has_last_load = false;
+	std::string last_model_path;
+	std::string last_execution_provider;
+	int last_image_dims[2] = { 0, 0 };
+	std::string last_options;
+
+	/// <summary>
+	/// Write a plain value to a binary stream.
+	/// </summary>
+	template <typename T>
+	void writeValue(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/// <summary>
+	/// Write a length-prefixed string to a binary stream.
+	/// </summary>
+	void writeString(std::ofstream& file, const std::string& str) {
+		writeValue(file, static_cast<uint32_t>(str.size()));
+		file.write(str.data(), str.size());
+	}
+
+	/// <summary>
+	/// Read a plain value from a binary stream.
+	/// </summary>
+	template <typename T>
+	bool readValue(std::ifstream& file, T& value) {
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	/// <summary>
+	/// Read a length-prefixed string from a binary stream.
+	/// </summary>
+	bool readString(std::ifstream& file, std::string& str) {
+		uint32_t size;
+		if (!readValue(file, size)) return false;
+		str.resize(size);
+		return static_cast<bool>(file.read(&str[0], size));
+	}
+
+	/// <summary>
+	/// Fold a block of bytes into a running FNV-1a 64-bit hash.
+	/// </summary>
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// Look up a percentile in a sorted list of latencies.
+	/// </summary>
+	double percentile(const std::vector<double>& sorted, double p) {
+		size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+}
+
+bool CaptureWriter::Open(const std::string& path) {
+	std::lock_guard<std::mutex> lock(mutex);
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file) return false;
+
+	// Write the file header
+	file.write(capture_magic, sizeof(capture_magic));
+	writeValue(file, capture_version);
+
+	start_ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+	return true;
+}
+
+void CaptureWriter::Close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_open()) file.close();
+}
+
+bool CaptureWriter::IsOpen() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return file.is_open();
+}
+
+uint64_t CaptureWriter::elapsedNanoseconds() {
+	std::chrono::steady_clock::duration elapsed(std::chrono::steady_clock::now().time_since_epoch().count() - start_ticks);
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void CaptureWriter::WriteLoad(const std::string& model_path, const std::string& execution_provider, int width, int height, const std::string& options) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file.is_open()) return;
+
+	writeValue(file, CaptureRecordType::Load);
+	writeValue(file, elapsedNanoseconds());
+	writeString(file, model_path);
+	writeString(file, execution_provider);
+	writeValue(file, static_cast<int32_t>(width));
+	writeValue(file, static_cast<int32_t>(height));
+	writeString(file, options);
+}
+
+void CaptureWriter::WriteFrame(const uint8_t* image_data, uint32_t byte_count, int output_length) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file.is_open()) return;
+
+	writeValue(file, CaptureRecordType::Frame);
+	writeValue(file, elapsedNanoseconds());
+	writeValue(file, static_cast<int32_t>(output_length));
+	writeValue(file, byte_count);
+	file.write(reinterpret_cast<const char*>(image_data), byte_count);
+}
+
+bool CaptureReader::Open(const std::string& path) {
+	file.open(path, std::ios::binary);
+	if (!file) return false;
+
+	// Validate the file header
+	char magic[sizeof(capture_magic)];
+	if (!file.read(magic, sizeof(magic)) || !readValue(file, version)) return false;
+	return std::equal(magic, magic + sizeof(magic), capture_magic) && (version == 1 || version == capture_version);
+}
+
+bool CaptureReader::Next(CaptureRecord& record) {
+	if (!readValue(file, record.type) || !readValue(file, record.timestamp_ns)) return false;
+
+	switch (record.type) {
+	case CaptureRecordType::Load:
+		record.options.clear();
+		return readString(file, record.model_path)
+			&& readString(file, record.execution_provider)
+			&& readValue(file, record.image_dims[0])
+			&& readValue(file, record.image_dims[1])
+			&& (version < 2 || readString(file, record.options));
+	case CaptureRecordType::Frame: {
+		uint32_t byte_count;
+		if (!readValue(file, record.output_length) || !readValue(file, byte_count)) return false;
+		record.image_data.resize(byte_count);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(record.image_data.data()), byte_count));
+	}
+	default:
+		return false;
+	}
+}
+
+void captureLoad(const char* model_path, const char* execution_provider, int width, int height, const char* options) {
+	{
+		// Remember the parameters so a capture started later can still replay this model
+		std::lock_guard<std::mutex> lock(last_load_mutex);
+		has_last_load = true;
+		last_model_path = model_path;
+		last_execution_provider = execution_provider;
+		last_image_dims[0] = width;
+		last_image_dims[1] = height;
+		last_options = options;
+	}
+
+	if (capturing) capture_writer.WriteLoad(model_path, execution_provider, width, height, options);
+}
+
+void captureFrame(const uint8_t* image_data, uint32_t byte_count, int output_length) {
+	if (capturing) capture_writer.WriteFrame(image_data, byte_count, output_length);
+}
+
+extern "C" {
+	/// <summary>
+	/// Start recording LoadModel parameters and PerformInference frames to a capture file.
+	/// </summary>
+	/// <param name="capture_path">Path of the capture file to create.</param>
+	/// <returns>1 if the capture file was created, 0 otherwise.</returns>
+	DLLExport int StartCapture(const char* capture_path) {
+		capturing = false;
+		capture_writer.Close();
+		if (!capture_writer.Open(capture_path)) return 0;
+
+		// Record the currently loaded model so the capture is self-contained
+		{
+			std::lock_guard<std::mutex> lock(last_load_mutex);
+			if (has_last_load) {
+				capture_writer.WriteLoad(last_model_path, last_execution_provider, last_image_dims[0], last_image_dims[1], last_options);
+			}
+		}
+
+		capturing = true;
+		return 1;
+	}
+
+	/// <summary>
+	/// Stop recording and close the capture file.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void StopCapture() {
+		capturing = false;
+		capture_writer.Close();
+	}
+
+	/// <summary>
+	/// Feed a capture file back through LoadModelWithOptions and PerformInference.
+	/// </summary>
+	/// <param name="capture_path">Path of the capture file to replay.</param>
+	/// <param name="max_speed">Nonzero to replay frames back to back instead of at their recorded times.</param>
+	/// <param name="stats">Receives the latency distribution and output checksum.</param>
+	/// <returns>A message indicating the success or failure of the replay.</returns>
+	DLLExport const char* ReplayCapture(const char* capture_path, int max_speed, ReplayStats* stats) {
+		CaptureReader reader;
+		if (!reader.Open(capture_path)) return "Unable to open capture file.";
+
+		// Pause any active capture so the replay is not recorded
+		bool was_capturing = capturing.exchange(false);
+
+		std::vector<double> latencies;
+		std::vector<float> output;
+		uint64_t checksum = 14695981039346656037ULL;
+		const char* message = "Replay completed successfully.";
+
+		// Wall-clock reference for replaying frames at their recorded times
+		auto replay_start = std::chrono::steady_clock::now();
+		uint64_t first_frame_ns = 0;
+		bool seen_frame = false;
+
+		CaptureRecord record;
+		while (reader.Next(record)) {
+			if (record.type == CaptureRecordType::Load) {
+				// Reload the model with the recorded parameters, including the load options that shape its latency
+				FreeResources();
+				LoadModelWithOptions(record.model_path.c_str(), record.execution_provider.c_str(), record.image_dims, record.options.c_str());
+				if (!std::atomic_load(&loaded_model)) {
+					message = "Failed to load the model recorded in the capture.";
+					break;
+				}
+				continue;
+			}
+
+			std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+			if (!model) {
+				message = "Capture contains frames before any model was loaded.";
+				break;
+			}
+			if (record.image_data.size() != static_cast<size_t>(model->n_pixels) * n_channels) {
+				message = "Capture frame size does not match the loaded model's image dimensions.";
+				break;
+			}
+
+			// Wait until the frame's recorded time unless replaying at max speed
+			if (!seen_frame) {
+				first_frame_ns = record.timestamp_ns;
+				replay_start = std::chrono::steady_clock::now();
+				seen_frame = true;
+			}
+			else if (!max_speed) {
+				std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds(record.timestamp_ns - first_frame_ns));
+			}
+
+			// Time the inference call
+			output.assign(record.output_length, 0.0f);
+			auto start = std::chrono::steady_clock::now();
+			PerformInference(record.image_data.data(), output.data(), record.output_length);
+			auto end = std::chrono::steady_clock::now();
+
+			latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			checksum = fnv1a(checksum, output.data(), output.size() * sizeof(float));
+		}
+
+		if (was_capturing) capturing = true;
+
+		// Summarize the latency distribution
+		*stats = {};
+		stats->frame_count = static_cast<int>(latencies.size());
+		stats->output_checksum = checksum;
+		if (!latencies.empty()) {
+			double total = 0.0;
+			for (double latency : latencies) total += latency;
+			std::sort(latencies.begin(), latencies.end());
+
+			stats->mean_ms = total / latencies.size();
+			stats->min_ms = latencies.front();
+			stats->p50_ms = percentile(latencies, 0.50);
+			stats->p90_ms = percentile(latencies, 0.90);
+			stats->p99_ms = percentile(latencies, 0.99);
+			stats->max_ms = latencies.back();
+		}
+
+		return message;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Capture file layout (little-endian):
+//   header: magic "OCVC", uint32 version
+//   load record:  uint8 type (1), uint64 timestamp_ns, uint32 path length, path bytes,
+//                 uint32 provider length, provider bytes, int32 width, int32 height,
+//                 uint32 options length, load options bytes (version 2 and up)
+//   frame record: uint8 type (2), uint64 timestamp_ns, int32 output length,
+//                 uint32 byte count, raw image bytes
+const char capture_magic[4] = { 'O', 'C', 'V', 'C' };
+const uint32_t capture_version = 2;
+
+enum class CaptureRecordType : uint8_t {
+	Load = 1,
+	Frame = 2
+};
+
+/// <summary>
+/// A single record read back from a capture file.
+/// </summary>
+struct CaptureRecord {
+	CaptureRecordType type;           // Whether this record holds load parameters or a frame
+	uint64_t timestamp_ns;            // Time since the capture started
+	std::string model_path;           // Load records: path passed to LoadModel
+	std::string execution_provider;   // Load records: execution provider passed to LoadModel
+	int image_dims[2];                // Load records: image dimensions passed to LoadModel
+	std::string options;              // Load records: load options string, empty for defaults and in version 1 files
+	int output_length;                // Frame records: length of the output_array passed to PerformInference
+	std::vector<uint8_t> image_data;  // Frame records: raw image bytes passed to PerformInference
+};
+
+/// <summary>
+/// Appends LoadModel/PerformInference parameters to a capture file.
+/// </summary>
+class CaptureWriter {
+public:
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen();
+
+	void WriteLoad(const std::string& model_path, const std::string& execution_provider, int width, int height, const std::string& options);
+	void WriteFrame(const uint8_t* image_data, uint32_t byte_count, int output_length);
+
+private:
+	uint64_t elapsedNanoseconds();
+
+	std::mutex mutex;                 // Serializes writes from concurrent callers
+	std::ofstream file;               // The open capture file
+	int64_t start_ticks = 0;          // Steady clock value when the capture was opened
+};
+
+/// <summary>
+/// Reads records sequentially from a capture file.
+/// </summary>
+class CaptureReader {
+public:
+	/// <summary>
+	/// Open a capture file of the current version or of version 1, whose load records have no options.
+	/// </summary>
+	bool Open(const std::string& path);
+
+	/// <summary>
+	/// Read the next record from the file.
+	/// </summary>
+	/// <returns>False at the end of the file or if the record is truncated.</returns>
+	bool Next(CaptureRecord& record);
+
+private:
+	std::ifstream file;               // The open capture file
+	uint32_t version = 0;             // Version of the open file
+};
+
+/// <summary>
+/// Latency distribution and output checksum gathered while replaying a capture.
+/// </summary>
+struct ReplayStats {
+	int frame_count;                  // Number of frames fed through PerformInference
+	double mean_ms;                   // Mean PerformInference latency
+	double min_ms;                    // Fastest PerformInference call
+	double p50_ms;                    // Median latency
+	double p90_ms;                    // 90th percentile latency
+	double p99_ms;                    // 99th percentile latency
+	double max_ms;                    // Slowest PerformInference call
+	uint64_t output_checksum;         // FNV-1a hash over every output_array, in frame order
+};
+
+// Hooks called by LoadModel and PerformInference while a capture is active
+void captureLoad(const char* model_path, const char* execution_provider, int width, int height, const char* options);
+void captureFrame(const uint8_t* image_data, uint32_t byte_count, int output_length);
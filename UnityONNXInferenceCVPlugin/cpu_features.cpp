@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "cpu_features.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define CPU_FEATURES_X86
+#endif
+
+namespace {
+#ifdef CPU_FEATURES_X86
+	/// <summary>
+	/// Check that the CPU supports AVX and that the operating system saves the AVX registers.
+	/// </summary>
+	bool osSupportsAvx() {
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+	}
+
+	bool detectAvx2() {
+		if (!osSupportsAvx()) return false;
+		int info[4];
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+
+	bool detectF16c() {
+		if (!osSupportsAvx()) return false;
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 29)) != 0;
+	}
+#endif
+}
+
+bool cpuHasAvx2() {
+#ifdef CPU_FEATURES_X86
+	// Detected on first use, so callers may check during static initialization
+	static const bool has_avx2 = detectAvx2();
+	return has_avx2;
+#else
+	return false;
+#endif
+}
+
+bool cpuHasF16c() {
+#ifdef CPU_FEATURES_X86
+	static const bool has_f16c = detectF16c();
+	return has_f16c;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+/// <summary>
+/// Check for AVX2 and operating system support for the AVX registers.
+/// </summary>
+/// <returns>True if AVX2 code paths may run; always false on CPUs other than x86/x64.</returns>
+bool cpuHasAvx2();
+
+/// <summary>
+/// Check for F16C and operating system support for the AVX registers it uses.
+/// </summary>
+/// <returns>True if F16C code paths may run; always false on CPUs other than x86/x64.</returns>
+bool cpuHasF16c();
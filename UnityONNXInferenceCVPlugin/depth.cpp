@@ -0,0 +1,337 @@
+#include "pch.h"
+#include "depth.h"
+#include "cpu_features.h"
+#include "half.h"
+#include "plugin.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define DEPTH_USE_AVX2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define DEPTH_USE_NEON
+#endif
+
+namespace {
+	const int colormap_size = 256;
+	const int histogram_bins = 4096;
+
+	/// <summary>
+	/// Pack a color with components in [0, 1] as RGBA8, red in the lowest byte.
+	/// </summary>
+	uint32_t packColor(float r, float g, float b) {
+		auto channel = [](float value) {
+			return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		};
+		return channel(r) | (channel(g) << 8) | (channel(b) << 16) | 0xFF000000u;
+	}
+
+	/// <summary>
+	/// Evaluate a sixth-degree polynomial fit of a colormap, with coefficients per channel from c0 to c6.
+	/// </summary>
+	uint32_t polynomialColor(const float (&c)[7][3], float t) {
+		float rgb[3];
+		for (int ch = 0; ch < 3; ch++) {
+			rgb[ch] = c[0][ch] + t * (c[1][ch] + t * (c[2][ch] + t * (c[3][ch] + t * (c[4][ch] + t * (c[5][ch] + t * c[6][ch])))));
+		}
+		return packColor(rgb[0], rgb[1], rgb[2]);
+	}
+
+	/// <summary>
+	/// Build the lookup table of a colormap.
+	/// </summary>
+	std::array<uint32_t, colormap_size> buildColormap(DepthColormap colormap) {
+		// Polynomial fits of matplotlib's inferno and viridis colormaps
+		static const float inferno[7][3] = {
+			{ 0.0002189403691192265f, 0.001651004631001012f, -0.01948089843709184f },
+			{ 0.1065134194856116f, 0.5639564367884091f, 3.932712388889277f },
+			{ 11.60249308247187f, -3.972853965665698f, -15.9423941062914f },
+			{ -41.70399613139459f, 17.43639888205313f, 44.35414519872813f },
+			{ 77.162935699427f, -33.40235894210092f, -81.80730925738993f },
+			{ -71.31942824499214f, 32.62606426397723f, 73.20951985803202f },
+			{ 25.13112622477341f, -12.24266895238567f, -23.07032500287172f } };
+		static const float viridis[7][3] = {
+			{ 0.2777273272234177f, 0.005407344544966578f, 0.3340998053353061f },
+			{ 0.1050930431085774f, 1.404613529898575f, 1.384590162594685f },
+			{ -0.3308618287255563f, 0.214847559468213f, 0.09509516302823659f },
+			{ -4.634230498983486f, -5.799100973351585f, -19.33244095627987f },
+			{ 6.228269936347081f, 14.17993336680509f, 56.69055260068105f },
+			{ 4.776384997670288f, -13.74514537774601f, -65.35303263337234f },
+			{ -5.435455855934631f, 4.645852612178535f, 26.3124352495832f } };
+
+		std::array<uint32_t, colormap_size> table;
+		for (int i = 0; i < colormap_size; i++) {
+			float t = i / static_cast<float>(colormap_size - 1);
+			switch (colormap) {
+			case DepthColormap::Turbo: {
+				// Polynomial approximation of Google's Turbo colormap
+				float t2 = t * t, t3 = t2 * t, t4 = t3 * t, t5 = t4 * t;
+				table[i] = packColor(
+					0.13572138f + 4.61539260f * t - 42.66032258f * t2 + 132.13108234f * t3 - 152.94239396f * t4 + 59.28637943f * t5,
+					0.09140261f + 2.19418839f * t + 4.84296658f * t2 - 14.18503333f * t3 + 4.27729857f * t4 + 2.82956604f * t5,
+					0.10667330f + 12.64194608f * t - 60.58204836f * t2 + 110.36276771f * t3 - 89.90310912f * t4 + 27.34824973f * t5);
+				break;
+			}
+			case DepthColormap::Inferno:
+				table[i] = polynomialColor(inferno, t);
+				break;
+			case DepthColormap::Viridis:
+				table[i] = polynomialColor(viridis, t);
+				break;
+			default:
+				table[i] = packColor(t, t, t);
+				break;
+			}
+		}
+		return table;
+	}
+
+	/// <summary>
+	/// Get the lookup table of a colormap, built once.
+	/// </summary>
+	const uint32_t* colormapTable(DepthColormap colormap) {
+		static const std::array<uint32_t, colormap_size> tables[] = {
+			buildColormap(DepthColormap::Gray),
+			buildColormap(DepthColormap::Turbo),
+			buildColormap(DepthColormap::Inferno),
+			buildColormap(DepthColormap::Viridis) };
+		return tables[static_cast<int>(colormap)].data();
+	}
+
+	/// <summary>
+	/// Scale that maps [low, high] to [0, 1]; zero for an empty range, so every pixel maps to 0.
+	/// </summary>
+	float rangeScale(float low, float high) {
+		return (high != low) ? 1.0f / (high - low) : 0.0f;
+	}
+
+	/// <summary>
+	/// Normalize one value, sending NaN to 0.
+	/// </summary>
+	float normalizeDepth(float value, float low, float scale) {
+		float t = (value - low) * scale;
+		return t > 0.0f ? std::min(t, 1.0f) : 0.0f;
+	}
+}
+
+void depthRange(const float* depth, size_t count, float& low, float& high) {
+	size_t i = 0;
+	float minimum = INFINITY;
+	float maximum = -INFINITY;
+#if defined(DEPTH_USE_AVX2)
+	if (cpuHasAvx2() && count >= 32) {
+		// Four accumulators per bound hide the latency of min and max; NaN inputs keep the accumulator
+		__m256 min_acc[4], max_acc[4];
+		for (int a = 0; a < 4; a++) {
+			min_acc[a] = _mm256_set1_ps(INFINITY);
+			max_acc[a] = _mm256_set1_ps(-INFINITY);
+		}
+		for (; i + 32 <= count; i += 32) {
+			for (int a = 0; a < 4; a++) {
+				__m256 v = _mm256_loadu_ps(depth + i + a * 8);
+				min_acc[a] = _mm256_min_ps(v, min_acc[a]);
+				max_acc[a] = _mm256_max_ps(v, max_acc[a]);
+			}
+		}
+		__m256 min_all = _mm256_min_ps(_mm256_min_ps(min_acc[0], min_acc[1]), _mm256_min_ps(min_acc[2], min_acc[3]));
+		__m256 max_all = _mm256_max_ps(_mm256_max_ps(max_acc[0], max_acc[1]), _mm256_max_ps(max_acc[2], max_acc[3]));
+		alignas(32) float mins[8], maxs[8];
+		_mm256_store_ps(mins, min_all);
+		_mm256_store_ps(maxs, max_all);
+		for (int lane = 0; lane < 8; lane++) {
+			minimum = std::min(minimum, mins[lane]);
+			maximum = std::max(maximum, maxs[lane]);
+		}
+	}
+#elif defined(DEPTH_USE_NEON)
+	if (count >= 4) {
+		// The "number" variants return the other operand when one is NaN
+		float32x4_t min_acc = vdupq_n_f32(INFINITY);
+		float32x4_t max_acc = vdupq_n_f32(-INFINITY);
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t v = vld1q_f32(depth + i);
+			min_acc = vminnmq_f32(min_acc, v);
+			max_acc = vmaxnmq_f32(max_acc, v);
+		}
+		minimum = vminnmvq_f32(min_acc);
+		maximum = vmaxnmvq_f32(max_acc);
+	}
+#endif
+	for (; i < count; i++) {
+		if (depth[i] < minimum) minimum = depth[i];
+		if (depth[i] > maximum) maximum = depth[i];
+	}
+
+	// An empty or all-NaN map has no range
+	if (minimum > maximum) minimum = maximum = 0.0f;
+	low = minimum;
+	high = maximum;
+}
+
+void depthPercentileRange(const float* depth, size_t count, float low_percentile, float high_percentile, float& low, float& high) {
+	float minimum, maximum;
+	depthRange(depth, count, minimum, maximum);
+	low = minimum;
+	high = maximum;
+	if (!(maximum > minimum)) return;
+
+	// Histogram of the finite values between the minimum and maximum
+	std::vector<uint32_t> histogram(histogram_bins, 0);
+	float bin_scale = histogram_bins / (maximum - minimum);
+	size_t valid = 0;
+	for (size_t i = 0; i < count; i++) {
+		float value = depth[i];
+		if (!(value >= minimum)) continue;
+		int bin = std::min(static_cast<int>((value - minimum) * bin_scale), histogram_bins - 1);
+		histogram[bin]++;
+		valid++;
+	}
+
+	// The lower bound is the start of the bin holding the lower percentile, the upper bound the end of its bin
+	double low_target = low_percentile / 100.0 * valid;
+	double high_target = high_percentile / 100.0 * valid;
+	double bin_width = (maximum - minimum) / static_cast<double>(histogram_bins);
+	size_t cumulative = 0;
+	bool found_low = false;
+	for (int bin = 0; bin < histogram_bins; bin++) {
+		cumulative += histogram[bin];
+		if (!found_low && cumulative > low_target) {
+			low = static_cast<float>(minimum + bin * bin_width);
+			found_low = true;
+		}
+		if (cumulative >= high_target) {
+			high = static_cast<float>(minimum + (bin + 1) * bin_width);
+			break;
+		}
+	}
+	high = std::min(high, maximum);
+}
+
+void depthToR16(const float* depth, int width, int height, float low, float high, bool flip_rows, uint16_t* texture) {
+	float scale = rangeScale(low, high);
+	for (int y = 0; y < height; y++) {
+		const float* src = depth + static_cast<size_t>(y) * width;
+		uint16_t* dst = texture + static_cast<size_t>(flip_rows ? height - 1 - y : y) * width;
+		int x = 0;
+#if defined(DEPTH_USE_AVX2)
+		if (cpuHasAvx2()) {
+			const __m256 offset = _mm256_set1_ps(low);
+			const __m256 multiplier = _mm256_set1_ps(scale * 65535.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 top = _mm256_set1_ps(65535.0f);
+			const __m256 half = _mm256_set1_ps(0.5f);
+			for (; x + 16 <= width; x += 16) {
+				// max returns the second operand for NaN, so NaN depth maps to 0
+				__m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + x), offset), multiplier), zero), top);
+				__m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + x + 8), offset), multiplier), zero), top);
+				__m256i packed = _mm256_packus_epi32(_mm256_cvttps_epi32(_mm256_add_ps(a, half)), _mm256_cvttps_epi32(_mm256_add_ps(b, half)));
+				// packus interleaves the 128-bit lanes; restore the element order
+				packed = _mm256_permute4x64_epi64(packed, 0xD8);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packed);
+			}
+		}
+#endif
+		for (; x < width; x++) {
+			dst[x] = static_cast<uint16_t>(normalizeDepth(src[x], low, scale) * 65535.0f + 0.5f);
+		}
+	}
+}
+
+void depthToRgba8(const float* depth, int width, int height, float low, float high, DepthColormap colormap, bool flip_rows, uint32_t* texture) {
+	const uint32_t* table = colormapTable(colormap);
+	float scale = rangeScale(low, high);
+	for (int y = 0; y < height; y++) {
+		const float* src = depth + static_cast<size_t>(y) * width;
+		uint32_t* dst = texture + static_cast<size_t>(flip_rows ? height - 1 - y : y) * width;
+		int x = 0;
+#if defined(DEPTH_USE_AVX2)
+		if (cpuHasAvx2()) {
+			const __m256 offset = _mm256_set1_ps(low);
+			const __m256 multiplier = _mm256_set1_ps(scale * (colormap_size - 1));
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 top = _mm256_set1_ps(static_cast<float>(colormap_size - 1));
+			const __m256 half = _mm256_set1_ps(0.5f);
+			for (; x + 8 <= width; x += 8) {
+				__m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(src + x), offset), multiplier), zero), top);
+				__m256i index = _mm256_cvttps_epi32(_mm256_add_ps(t, half));
+				__m256i color = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), color);
+			}
+		}
+#endif
+		for (; x < width; x++) {
+			dst[x] = table[static_cast<int>(normalizeDepth(src[x], low, scale) * (colormap_size - 1) + 0.5f)];
+		}
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Run the loaded depth-estimation model and write its depth map straight into a texture buffer:
+	/// the map is normalized between its minimum and maximum (or two percentiles), then stored as R16 or colorized as RGBA8.
+	/// The model's output must hold a single depth map, e.g., of shape [1, H, W] or [1, 1, H, W].
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="texture">Buffer receiving the texture: 2 bytes per pixel for R16, 4 for RGBA8.</param>
+	/// <param name="texture_pixels">Capacity of the texture buffer in pixels.</param>
+	/// <param name="options">Texture format, colormap and normalization settings.</param>
+	/// <param name="info">Receives the texture dimensions and the depth range used, or nullptr.</param>
+	/// <returns>1 on success, 0 if no model is loaded, the run failed, the options are invalid, or the texture is too small.</returns>
+	DLLExport int PerformInferenceDepth(byte* image_data, void* texture, int texture_pixels, const DepthOutputOptions* options, DepthOutputInfo* info) {
+		if (options->format < 0 || options->format > static_cast<int>(DepthTextureFormat::RGBA8)) return 0;
+		if (options->colormap < 0 || options->colormap > static_cast<int>(DepthColormap::Viridis)) return 0;
+		if (options->low_percentile < 0.0f || options->high_percentile > 100.0f || !(options->low_percentile < options->high_percentile)) return 0;
+
+		bool written = false;
+		bool ran = runModel(image_data, [&](const ModelOutput& output) {
+			// The last two dimensions are the depth map's height and width
+			OrtTensorTypeAndShapeInfo* shape_info;
+			ort->GetTensorTypeAndShape(output.tensor, &shape_info);
+			size_t dim_count = 0;
+			ort->GetDimensionsCount(shape_info, &dim_count);
+			std::vector<int64_t> shape(dim_count);
+			ort->GetDimensions(shape_info, shape.data(), dim_count);
+			ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+			if (dim_count < 2) return;
+			int width = static_cast<int>(shape[dim_count - 1]);
+			int height = static_cast<int>(shape[dim_count - 2]);
+			size_t pixels = static_cast<size_t>(width) * height;
+			if (pixels != output.count || pixels > static_cast<size_t>(texture_pixels)) return;
+
+			// Half-precision maps are widened into the request context's scratch buffer
+			const float* depth = static_cast<const float*>(output.data);
+			thread_local std::vector<float> widened;
+			if (output.element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+				float* buffer = output.context->scratch.data();
+				if (output.context->scratch.size() < pixels) {
+					widened.resize(pixels);
+					buffer = widened.data();
+				}
+				halfToFloat(static_cast<const uint16_t*>(output.data), buffer, pixels);
+				depth = buffer;
+			}
+
+			float low, high;
+			if (options->low_percentile <= 0.0f && options->high_percentile >= 100.0f) depthRange(depth, pixels, low, high);
+			else depthPercentileRange(depth, pixels, options->low_percentile, options->high_percentile, low, high);
+
+			// Inverting swaps the ends of the mapping
+			float from = options->invert ? high : low;
+			float to = options->invert ? low : high;
+			if (static_cast<DepthTextureFormat>(options->format) == DepthTextureFormat::R16) {
+				depthToR16(depth, width, height, from, to, options->flip_rows != 0, static_cast<uint16_t*>(texture));
+			}
+			else {
+				depthToRgba8(depth, width, height, from, to, static_cast<DepthColormap>(options->colormap), options->flip_rows != 0, static_cast<uint32_t*>(texture));
+			}
+
+			if (info) *info = { width, height, low, high };
+			written = true;
+		});
+		return ran && written ? 1 : 0;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Texture layouts PerformInferenceDepth can write.
+/// </summary>
+enum class DepthTextureFormat : int {
+	R16 = 0,                          // One 16-bit unsigned normalized value per pixel (TextureFormat.R16)
+	RGBA8 = 1                         // Colormapped RGBA, 8 bits per channel (TextureFormat.RGBA32)
+};
+
+/// <summary>
+/// Colormaps for RGBA8 depth textures.
+/// </summary>
+enum class DepthColormap : int {
+	Gray = 0,
+	Turbo = 1,
+	Inferno = 2,
+	Viridis = 3
+};
+
+/// <summary>
+/// Settings for PerformInferenceDepth.
+/// </summary>
+struct DepthOutputOptions {
+	int format;                       // DepthTextureFormat
+	int colormap;                     // DepthColormap, used for RGBA8 textures
+	float low_percentile;             // Percentile of the frame's depth values mapped to 0, or 0 for the minimum
+	float high_percentile;            // Percentile mapped to 1, or 100 for the maximum
+	int invert;                       // 1 to map the low end to 1 instead, e.g., to show near points bright with metric depth
+	int flip_rows;                    // 1 to write the bottom row first, as Unity textures expect
+};
+
+/// <summary>
+/// Describes the texture written by PerformInferenceDepth.
+/// </summary>
+struct DepthOutputInfo {
+	int width;                        // Width of the depth map and of the texture
+	int height;                       // Height of the depth map and of the texture
+	float low;                        // Depth value mapped to 0 (or to 1 when inverted)
+	float high;                       // Depth value mapped to 1 (or to 0 when inverted)
+};
+
+/// <summary>
+/// Find the smallest and largest values of a depth map with SIMD reductions. NaN values are ignored.
+/// </summary>
+/// <param name="depth">The depth values.</param>
+/// <param name="count">Number of values.</param>
+/// <param name="low">Receives the minimum.</param>
+/// <param name="high">Receives the maximum.</param>
+void depthRange(const float* depth, size_t count, float& low, float& high);
+
+/// <summary>
+/// Estimate two percentiles of a depth map from a histogram between its minimum and maximum,
+/// e.g., to keep a few far-away or noisy pixels from compressing the rest of the range.
+/// </summary>
+/// <param name="depth">The depth values.</param>
+/// <param name="count">Number of values.</param>
+/// <param name="low_percentile">Lower percentile, 0 to 100.</param>
+/// <param name="high_percentile">Upper percentile, 0 to 100.</param>
+/// <param name="low">Receives the lower percentile's value.</param>
+/// <param name="high">Receives the upper percentile's value.</param>
+void depthPercentileRange(const float* depth, size_t count, float low_percentile, float high_percentile, float& low, float& high);
+
+/// <summary>
+/// Normalize a depth map from [low, high] to [0, 1] and write it as 16-bit unsigned normalized values.
+/// Values outside the range are clamped. Passing low greater than high inverts the mapping.
+/// </summary>
+/// <param name="depth">Row-major depth map of width x height values.</param>
+/// <param name="width">Width of the depth map.</param>
+/// <param name="height">Height of the depth map.</param>
+/// <param name="low">Depth value mapped to 0.</param>
+/// <param name="high">Depth value mapped to 65535.</param>
+/// <param name="flip_rows">True to write the rows bottom to top.</param>
+/// <param name="texture">Receives width x height values.</param>
+void depthToR16(const float* depth, int width, int height, float low, float high, bool flip_rows, uint16_t* texture);
+
+/// <summary>
+/// Normalize a depth map from [low, high] to [0, 1] and colorize it through a 256-entry colormap.
+/// Values outside the range are clamped. Passing low greater than high inverts the mapping.
+/// </summary>
+/// <param name="depth">Row-major depth map of width x height values.</param>
+/// <param name="width">Width of the depth map.</param>
+/// <param name="height">Height of the depth map.</param>
+/// <param name="low">Depth value mapped to the first colormap entry.</param>
+/// <param name="high">Depth value mapped to the last colormap entry.</param>
+/// <param name="colormap">The colormap.</param>
+/// <param name="flip_rows">True to write the rows bottom to top.</param>
+/// <param name="texture">Receives width x height RGBA pixels, red in the lowest byte.</param>
+void depthToRgba8(const float* depth, int width, int height, float low, float high, DepthColormap colormap, bool flip_rows, uint32_t* texture);
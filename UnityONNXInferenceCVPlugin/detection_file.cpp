@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "plugin.h"
+#include "detection_file.h"
+#include <algorithm>
+#include <cstddef>
+#include <list>
+
+namespace {
+	DetectionFileWriter detection_writer;         // The file AppendDetections writes to, if any
+
+	// Views returned by MapDetectionFile, kept until UnmapDetectionFile
+	std::mutex views_mutex;
+	std::list<DetectionFileView> views;
+
+	/// <summary>
+	/// Whether a header describes a detection file this build can read.
+	/// </summary>
+	bool validHeader(const DetectionFileHeader& header) {
+		return std::equal(header.magic, header.magic + sizeof(header.magic), detection_file_magic)
+			&& header.version == detection_file_version
+			&& header.record_size == sizeof(DetectionRecord);
+	}
+}
+
+bool DetectionFileWriter::Open(const std::string& path, bool truncate) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_open()) file.close();
+	record_count = 0;
+
+	// Continue an existing file unless asked to start over
+	if (!truncate) {
+		file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+		if (file.is_open()) {
+			DetectionFileHeader header;
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !validHeader(header)) {
+				file.close();
+				return false;
+			}
+			// Records past the count were cut off mid-append and are overwritten
+			record_count = header.record_count;
+			return true;
+		}
+	}
+
+	file.clear();
+	file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+	if (!file) return false;
+
+	DetectionFileHeader header = {};
+	std::copy(detection_file_magic, detection_file_magic + sizeof(detection_file_magic), header.magic);
+	header.version = detection_file_version;
+	header.record_size = sizeof(DetectionRecord);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.flush();
+	return static_cast<bool>(file);
+}
+
+void DetectionFileWriter::Close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_open()) file.close();
+}
+
+bool DetectionFileWriter::IsOpen() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return file.is_open();
+}
+
+uint64_t DetectionFileWriter::RecordCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return record_count;
+}
+
+bool DetectionFileWriter::Append(uint32_t image_index, const Detection* detections, int count) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file.is_open()) return false;
+	if (count <= 0) return true;
+
+	records.resize(count);
+	for (int i = 0; i < count; i++) records[i] = { image_index, detections[i] };
+
+	// Write the records, then publish them by updating the count in the header
+	file.seekp(sizeof(DetectionFileHeader) + record_count * sizeof(DetectionRecord));
+	file.write(reinterpret_cast<const char*>(records.data()), count * sizeof(DetectionRecord));
+	file.flush();
+	if (!file) return false;
+
+	record_count += count;
+	file.seekp(offsetof(DetectionFileHeader, record_count));
+	file.write(reinterpret_cast<const char*>(&record_count), sizeof(record_count));
+	file.flush();
+	return static_cast<bool>(file);
+}
+
+bool DetectionFileView::Open(const std::string& path) {
+	Close();
+
+	// Allow the writer to keep appending while the file is mapped
+	file = CreateFileW(stringToWstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(DetectionFileHeader))) {
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		Close();
+		return false;
+	}
+
+	const DetectionFileHeader* header = static_cast<const DetectionFileHeader*>(view);
+	if (!validHeader(*header)) {
+		Close();
+		return false;
+	}
+
+	// Only count records that fit in the mapped size
+	uint64_t mapped_records = (size.QuadPart - sizeof(DetectionFileHeader)) / sizeof(DetectionRecord);
+	records = reinterpret_cast<const DetectionRecord*>(header + 1);
+	record_count = std::min(header->record_count, mapped_records);
+	return true;
+}
+
+void DetectionFileView::Close() {
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	view = nullptr;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+	records = nullptr;
+	record_count = 0;
+}
+
+extern "C" {
+	/// <summary>
+	/// Open a detection file for AppendDetections, continuing it if it already exists.
+	/// </summary>
+	/// <param name="path">Path of the detection file.</param>
+	/// <returns>1 if the file was opened, 0 if it could not be created or is not a detection file.</returns>
+	DLLExport int OpenDetectionFile(const char* path) {
+		return detection_writer.Open(path, false) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Close the detection file opened by OpenDetectionFile.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void CloseDetectionFile() {
+		detection_writer.Close();
+	}
+
+	/// <summary>
+	/// Append one image's detections to the open detection file.
+	/// </summary>
+	/// <param name="image_index">Index identifying the image, e.g., its frame number.</param>
+	/// <param name="detections">Array of detections.</param>
+	/// <param name="count">Number of detections.</param>
+	/// <returns>1 if the detections were written, 0 if no file is open or the write failed.</returns>
+	DLLExport int AppendDetections(uint32_t image_index, const Detection* detections, int count) {
+		return detection_writer.Append(image_index, detections, count) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Memory-map a detection file for reading. The records stay valid until UnmapDetectionFile.
+	/// </summary>
+	/// <param name="path">Path of the detection file.</param>
+	/// <param name="record_count">Receives the number of records.</param>
+	/// <returns>Pointer to the first record, or nullptr if the file could not be mapped.</returns>
+	DLLExport const DetectionRecord* MapDetectionFile(const char* path, long long* record_count) {
+		std::lock_guard<std::mutex> lock(views_mutex);
+		*record_count = 0;
+		views.emplace_back();
+		if (!views.back().Open(path)) {
+			views.pop_back();
+			return nullptr;
+		}
+		*record_count = static_cast<long long>(views.back().RecordCount());
+		return views.back().Records();
+	}
+
+	/// <summary>
+	/// Release a mapping returned by MapDetectionFile.
+	/// </summary>
+	/// <param name="records">The pointer returned by MapDetectionFile.</param>
+	/// <returns></returns>
+	DLLExport void UnmapDetectionFile(const DetectionRecord* records) {
+		std::lock_guard<std::mutex> lock(views_mutex);
+		views.remove_if([records](const DetectionFileView& view) { return view.Records() == records; });
+	}
+}
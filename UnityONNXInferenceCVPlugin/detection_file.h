@@ -0,0 +1,93 @@
+#pragma once
+
+#include "detections.h"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Detection file layout (little-endian), designed to be memory-mapped and scanned in place:
+//   header:  magic "OCVD", uint32 version, uint32 record size, uint32 reserved, uint64 record count
+//   records: record count DetectionRecords at a fixed stride of the record size
+// Records are only ever appended. The record count is updated after the records it covers are written,
+// so a reader that maps the file while it is being written always sees complete records.
+const char detection_file_magic[4] = { 'O', 'C', 'V', 'D' };
+const uint32_t detection_file_version = 1;
+
+/// <summary>
+/// Header at the start of a detection file.
+/// </summary>
+struct DetectionFileHeader {
+	char magic[4];                    // "OCVD"
+	uint32_t version;                 // detection_file_version
+	uint32_t record_size;             // sizeof(DetectionRecord), the stride between records
+	uint32_t reserved;                // Zero; keeps record_count 8-byte aligned
+	uint64_t record_count;            // Number of complete records following the header
+};
+
+/// <summary>
+/// One detection stored in a detection file.
+/// </summary>
+struct DetectionRecord {
+	uint32_t image_index;             // Index of the image the detection belongs to
+	Detection detection;              // The detected box, score and class
+};
+
+static_assert(sizeof(DetectionFileHeader) == 24, "Detection file header layout changed");
+static_assert(sizeof(DetectionRecord) == 28, "Detection record layout changed");
+
+/// <summary>
+/// Appends detection records to a detection file.
+/// </summary>
+class DetectionFileWriter {
+public:
+	/// <summary>
+	/// Open a detection file for appending, creating it if it does not exist or truncate is set.
+	/// </summary>
+	/// <returns>False if the file could not be opened or is not a detection file.</returns>
+	bool Open(const std::string& path, bool truncate);
+	void Close();
+	bool IsOpen();
+
+	/// <summary>
+	/// Append the detections for one image and publish them by updating the record count.
+	/// </summary>
+	bool Append(uint32_t image_index, const Detection* detections, int count);
+
+	uint64_t RecordCount();
+
+private:
+	std::mutex mutex;                 // Serializes appends from concurrent callers
+	std::fstream file;                // The open detection file
+	uint64_t record_count = 0;        // Records written so far, mirrored in the header
+	std::vector<DetectionRecord> records; // Staging buffer reused between appends
+};
+
+/// <summary>
+/// A read-only memory mapping of a detection file.
+/// </summary>
+class DetectionFileView {
+public:
+	DetectionFileView() = default;
+	DetectionFileView(const DetectionFileView&) = delete;
+	DetectionFileView& operator=(const DetectionFileView&) = delete;
+	~DetectionFileView() { Close(); }
+
+	/// <summary>
+	/// Map a detection file. Records appended after this call are not visible until it is mapped again.
+	/// </summary>
+	/// <returns>False if the file could not be mapped or is not a detection file.</returns>
+	bool Open(const std::string& path);
+	void Close();
+
+	const DetectionRecord* Records() const { return records; }
+	uint64_t RecordCount() const { return record_count; }
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+	const DetectionRecord* records = nullptr;
+	uint64_t record_count = 0;
+};
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "detections.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const int yolox_strides[] = { 8, 16, 32 };    // Downsampling factors of the YOLOX detection heads
+
+	/// <summary>
+	/// Intersection over union of two boxes.
+	/// </summary>
+	float iou(const Detection& a, const Detection& b) {
+		float x0 = std::max(a.x0, b.x0);
+		float y0 = std::max(a.y0, b.y0);
+		float x1 = std::min(a.x0 + a.width, b.x0 + b.width);
+		float y1 = std::min(a.y0 + a.height, b.y0 + b.height);
+		float intersection = std::max(0.0f, x1 - x0) * std::max(0.0f, y1 - y0);
+		float union_area = a.width * a.height + b.width * b.height - intersection;
+		return union_area > 0.0f ? intersection / union_area : 0.0f;
+	}
+}
+
+bool decodeYoloxOutput(const float* output, size_t count, int width, int height, float score_threshold, std::vector<Detection>& proposals) {
+	proposals.clear();
+
+	// Derive the number of classes from the number of grid cells
+	size_t cell_count = 0;
+	for (int stride : yolox_strides) cell_count += static_cast<size_t>(width / stride) * (height / stride);
+	if (cell_count == 0 || count % cell_count != 0 || count / cell_count <= 5) return false;
+	size_t row_size = count / cell_count;
+	int class_count = static_cast<int>(row_size - 5);
+
+	const float* row = output;
+	for (int stride : yolox_strides) {
+		int grid_w = width / stride;
+		int grid_h = height / stride;
+		for (int grid_y = 0; grid_y < grid_h; grid_y++) {
+			for (int grid_x = 0; grid_x < grid_w; grid_x++, row += row_size) {
+				// Skip the box decode for cells that cannot pass the threshold
+				float objectness = row[4];
+				if (objectness < score_threshold) continue;
+
+				const float* class_scores = row + 5;
+				int class_index = static_cast<int>(std::max_element(class_scores, class_scores + class_count) - class_scores);
+				float score = objectness * class_scores[class_index];
+				if (score < score_threshold) continue;
+
+				Detection detection;
+				detection.width = std::exp(row[2]) * stride;
+				detection.height = std::exp(row[3]) * stride;
+				detection.x0 = (row[0] + grid_x) * stride - detection.width * 0.5f;
+				detection.y0 = (row[1] + grid_y) * stride - detection.height * 0.5f;
+				detection.score = score;
+				detection.class_index = class_index;
+				proposals.push_back(detection);
+			}
+		}
+	}
+	return true;
+}
+
+void nonMaxSuppression(std::vector<Detection>& detections, float iou_threshold) {
+	std::sort(detections.begin(), detections.end(), [](const Detection& a, const Detection& b) { return a.score > b.score; });
+
+	// Compare each box against the survivors so far, which all have higher scores
+	size_t kept = 0;
+	for (size_t i = 0; i < detections.size(); i++) {
+		bool suppressed = false;
+		for (size_t j = 0; j < kept && !suppressed; j++) {
+			suppressed = iou(detections[i], detections[j]) > iou_threshold;
+		}
+		if (!suppressed) detections[kept++] = detections[i];
+	}
+	detections.resize(kept);
+}
+
+void nonMaxSuppressionIndices(const std::vector<Detection>& detections, float iou_threshold, std::vector<size_t>& kept) {
+	std::vector<size_t> order(detections.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return detections[a].score > detections[b].score; });
+
+	kept.clear();
+	for (size_t i : order) {
+		bool suppressed = false;
+		for (size_t j = 0; j < kept.size() && !suppressed; j++) {
+			suppressed = iou(detections[i], detections[kept[j]]) > iou_threshold;
+		}
+		if (!suppressed) kept.push_back(i);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// An object detected in one image, in input image pixels.
+/// </summary>
+struct Detection {
+	float x0;                         // Left edge of the bounding box
+	float y0;                         // Top edge of the bounding box
+	float width;                      // Width of the bounding box
+	float height;                     // Height of the bounding box
+	float score;                      // Objectness times class probability
+	int32_t class_index;              // Index of the most likely class
+};
+
+/// <summary>
+/// Decode raw YOLOX output into box proposals above a score threshold. The output holds one row of
+/// (x, y, log w, log h, objectness, class probabilities...) per grid cell of the stride 8, 16 and 32 feature maps.
+/// </summary>
+/// <param name="output">Model output for one image.</param>
+/// <param name="count">Number of elements in output.</param>
+/// <param name="width">Width of the model input in pixels.</param>
+/// <param name="height">Height of the model input in pixels.</param>
+/// <param name="score_threshold">Minimum score of a proposal.</param>
+/// <param name="proposals">Receives the proposals, replacing its contents.</param>
+/// <returns>False if the output size does not match a YOLOX head for the input dimensions.</returns>
+bool decodeYoloxOutput(const float* output, size_t count, int width, int height, float score_threshold, std::vector<Detection>& proposals);
+
+/// <summary>
+/// Keep the highest-scoring box of each group of overlapping boxes.
+/// </summary>
+/// <param name="detections">Boxes to filter in place; the survivors are left sorted by descending score.</param>
+/// <param name="iou_threshold">Boxes overlapping a higher-scoring box by more than this intersection over union are removed.</param>
+void nonMaxSuppression(std::vector<Detection>& detections, float iou_threshold);
+
+/// <summary>
+/// Select the highest-scoring box of each group of overlapping boxes without reordering the boxes,
+/// for callers that keep per-box data alongside them.
+/// </summary>
+/// <param name="detections">Boxes to filter.</param>
+/// <param name="iou_threshold">Boxes overlapping a higher-scoring box by more than this intersection over union are removed.</param>
+/// <param name="kept">Receives the indices of the surviving boxes by descending score, replacing its contents.</param>
+void nonMaxSuppressionIndices(const std::vector<Detection>& detections, float iou_threshold, std::vector<size_t>& kept);
@@ -1,25 +1,29 @@
 #include "pch.h"
-#include <onnxruntime_cxx_api.h>
+#include "plugin.h"
+#include "affinity.h"
+#include "capture.h"
+#include "half.h"
+#include "hash.h"
+#include "result_cache.h"
+#include "load_options.h"
+#include "numa.h"
+#include "request_pool.h"
+#include "runtime_context.h"
+#include "float_mode.h"
 #include "dml_provider_factory.h"
+#include <onnxruntime_session_options_config_keys.h>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <mutex>
 
-#define DLLExport __declspec (dllexport)
+std::shared_ptr<LoadedModel> loaded_model; // The loaded model, swapped atomically by ReloadModel
 
 extern "C" {
-	int input_w;                      // Width of the input image
-	int input_h;                      // Height of the input image
-	int n_pixels;                     // Total number of pixels in the input image (width x height)
 	const int n_channels = 3;         // Number of color channels in the input image (3 for RGB)
 	const OrtApi* ort = nullptr;      // Pointer to the ONNX Runtime C API, used for most ONNX operations
-	std::vector<std::string> provider_names; // Names of providers available for ONNX runtime, e.g., DirectML
-	OrtEnv* env = nullptr;            // ONNX Runtime environment, encapsulating global options and logging functionality
-	OrtSessionOptions* session_options = nullptr; // Configurations and settings for the ONNX session
-	OrtSession* session = nullptr;    // The ONNX Runtime session, representing the loaded model and its state
-	std::string input_name;           // Name of the model's input node
-	std::string output_name;          // Name of the model's output node
-	std::vector<float> input_data;    // Buffer to hold preprocessed input data before feeding it to the model
 
 	/// <summary>
 	/// Convert a standard string to a wide string.
@@ -32,22 +36,265 @@ extern "C" {
 	}
 
 	/// <summary>
-	/// Initialize the ONNX Runtime API and retrieve the available providers.
+	/// Normalize interleaved RGB bytes to [0, 1] and reorder them into planar (CHW) floats.
 	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="input">Buffer of pixel_count * n_channels floats to receive the model input.</param>
+	/// <param name="pixel_count">Number of pixels in the image.</param>
 	/// <returns></returns>
-	DLLExport void InitOrtAPI() {
-		// Get the ONNX Runtime API
-		ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+	void preprocessImage(const byte* image_data, float* input, int pixel_count) {
+		for (int p = 0; p < pixel_count; p++) {
+			for (int ch = 0; ch < n_channels; ch++) {
+				// Normalize pixel values to [0, 1] and reorder channels
+				input[ch * pixel_count + p] = (image_data[p * n_channels + ch] / 255.0f);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Reorder interleaved RGB bytes into planar (CHW) bytes without normalizing them,
+	/// for quantized models that take uint8 input directly.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="input">Buffer of pixel_count * n_channels bytes to receive the model input.</param>
+	/// <param name="pixel_count">Number of pixels in the image.</param>
+	/// <returns></returns>
+	void preprocessImageUint8(const byte* image_data, uint8_t* input, int pixel_count) {
+		for (int p = 0; p < pixel_count; p++) {
+			for (int ch = 0; ch < n_channels; ch++) {
+				input[ch * pixel_count + p] = image_data[p * n_channels + ch];
+			}
+		}
+	}
+
+	/// <summary>
+	/// Preprocess an image into the element type the model expects.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="input">Buffer of inputTensorBytes(element_type, pixel_count) bytes to receive the model input.</param>
+	/// <param name="element_type">Element type of the model's input.</param>
+	/// <param name="pixel_count">Number of pixels in the image.</param>
+	/// <returns></returns>
+	void preprocessInput(const byte* image_data, void* input, ONNXTensorElementDataType element_type, int pixel_count) {
+		if (element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
+			preprocessImageUint8(image_data, static_cast<uint8_t*>(input), pixel_count);
+		}
+		else {
+			preprocessImage(image_data, static_cast<float*>(input), pixel_count);
+		}
+	}
+
+	/// <summary>
+	/// Get the size in bytes of the model's input tensor.
+	/// </summary>
+	/// <param name="element_type">Element type of the model's input.</param>
+	/// <param name="pixel_count">Number of pixels in the image.</param>
+	/// <returns>The input size in bytes.</returns>
+	size_t inputTensorBytes(ONNXTensorElementDataType element_type, int pixel_count) {
+		size_t element_size = (element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) ? sizeof(uint8_t) : sizeof(float);
+		return static_cast<size_t>(pixel_count) * n_channels * element_size;
+	}
+
+	/// <summary>
+	/// Wrap a preprocessed input buffer in an ONNX tensor without copying it.
+	/// </summary>
+	/// <param name="input">Buffer of inputTensorBytes(element_type, width * height) bytes holding the model input.</param>
+	/// <param name="element_type">Element type of the model's input.</param>
+	/// <param name="width">Width of the input image.</param>
+	/// <param name="height">Height of the input image.</param>
+	/// <returns>The input tensor, to be released with ReleaseValue.</returns>
+	OrtValue* createInputTensor(void* input, ONNXTensorElementDataType element_type, int width, int height) {
+		// Define the shape of the input tensor
+		int64_t input_shape[] = { 1, n_channels, height, width };
+
+		// Create a memory info instance for CPU allocation
+		OrtMemoryInfo* memory_info;
+		ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info);
+
+		// Convert the processed image data into an ONNX tensor format
+		OrtValue* input_tensor = nullptr;
+		ort->CreateTensorWithDataAsOrtValue(
+			memory_info, input, inputTensorBytes(element_type, width * height),
+			input_shape, 4, element_type, &input_tensor
+		);
+
+		// Free the memory info after usage
+		ort->ReleaseMemoryInfo(memory_info);
+
+		return input_tensor;
+	}
+
+	/// <summary>
+	/// Copy model output to a float array, converting half-precision output to float.
+	/// </summary>
+	/// <param name="data">Output tensor data with element_type elements.</param>
+	/// <param name="count">Number of elements to copy.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="element_type">Element type of the model's output.</param>
+	/// <returns></returns>
+	void writeOutput(const void* data, size_t count, float* output_array, ONNXTensorElementDataType element_type) {
+		if (element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+			halfToFloat(static_cast<const uint16_t*>(data), output_array, count);
+		}
+		else {
+			std::memcpy(output_array, data, count * sizeof(float));
+		}
+	}
+
+	/// <summary>
+	/// Copy model output to a half-precision array, converting float output to half precision.
+	/// </summary>
+	/// <param name="data">Output tensor data with element_type elements.</param>
+	/// <param name="count">Number of elements to copy.</param>
+	/// <param name="output_array">Array to store the inferred results as raw 16-bit patterns.</param>
+	/// <param name="element_type">Element type of the model's output.</param>
+	/// <returns></returns>
+	void writeHalfOutput(const void* data, size_t count, uint16_t* output_array, ONNXTensorElementDataType element_type) {
+		if (element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+			std::memcpy(output_array, data, count * sizeof(uint16_t));
+		}
+		else {
+			floatToHalf(static_cast<const float*>(data), output_array, count);
+		}
+	}
+
+	/// <summary>
+	/// Copy the contents of an output tensor to a caller-provided array.
+	/// </summary>
+	/// <param name="output_tensor">The output tensor returned by Run.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <param name="element_type">Element type of the model's output.</param>
+	/// <returns></returns>
+	void copyOutput(OrtValue* output_tensor, float* output_array, int length, ONNXTensorElementDataType element_type) {
+		// Extract data from the output tensor
+		void* out_data;
+		ort->GetTensorMutableData(output_tensor, &out_data);
+
+		// Copy the inference results to the provided output array
+		writeOutput(out_data, length, output_array, element_type);
+	}
+
+	/// <summary>
+	/// Look up the element type of a session's first input or output.
+	/// </summary>
+	/// <param name="session">The loaded session.</param>
+	/// <param name="is_input">True for the first input, false for the first output.</param>
+	/// <returns>The element type, or ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED if it is not a tensor.</returns>
+	ONNXTensorElementDataType getElementType(OrtSession* session, bool is_input) {
+		OrtTypeInfo* type_info;
+		if (is_input) checkStatus(ort->SessionGetInputTypeInfo(session, 0, &type_info));
+		else checkStatus(ort->SessionGetOutputTypeInfo(session, 0, &type_info));
+
+		const OrtTensorTypeAndShapeInfo* tensor_info;
+		ONNXTensorElementDataType element_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+		ort->CastTypeInfoToTensorInfo(type_info, &tensor_info);
+		if (tensor_info) ort->GetTensorElementType(tensor_info, &element_type);
+		ort->ReleaseTypeInfo(type_info);
+		return element_type;
+	}
 
-		// Temporary pointers to fetch provider names
-		char** raw_provider_names;
-		int provider_count;
+	/// <summary>
+	/// Create a session for a model with the load options applied.
+	/// </summary>
+	/// <param name="session_env">Environment to create the session in.</param>
+	/// <param name="model">The model file, or its decompressed bytes, and any mapped external initializers.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="load_options">The parsed load options.</param>
+	/// <param name="intra_op_cpus">Logical processors to pin the intra-op threads to, or empty for ONNX Runtime's default.</param>
+	/// <param name="global_threads">True to run on session_env's global thread pools instead of the session's own.</param>
+	/// <returns>The session, or nullptr if the execution provider is unknown. Throws if the model fails to load.</returns>
+	OrtSession* createSession(OrtEnv* session_env, const ModelSource& model, const char* execution_provider, const LoadOptions& load_options, const std::vector<int>& intra_op_cpus, bool global_threads) {
+		// Create session options for further configuration, released on every path out of this function
+		OrtSessionOptions* raw_session_options;
+		checkStatus(ort->CreateSessionOptions(&raw_session_options));
+		OrtPtr<OrtSessionOptions> options_owner(raw_session_options);
+		OrtSessionOptions* session_options = raw_session_options;
+
+		// Serve external weights from the mapped files instead of buffers ONNX Runtime reads them into
+		if (model.external_initializers) {
+			model.external_initializers->AddTo(session_options);
+		}
+
+		// Share the environment's thread pools with the other sessions created in it
+		if (global_threads) {
+			checkStatus(ort->DisablePerSessionThreads(session_options));
+		}
 
-		// Get available providers
-		ort->GetAvailableProviders(&raw_provider_names, &provider_count);
+		// Flush denormals to zero on the session's intra-op threads
+		if (load_options.denormals_as_zero) {
+			checkStatus(ort->AddSessionConfigEntry(session_options, kOrtSessionOptionsConfigSetDenormalAsZero, "1"));
+		}
+
+		// Pin one intra-op thread to each requested processor; the calling thread makes up the extra thread
+		if (!intra_op_cpus.empty() && !global_threads) {
+			checkStatus(ort->SetIntraOpNumThreads(session_options, static_cast<int>(intra_op_cpus.size()) + 1));
+			checkStatus(ort->AddSessionConfigEntry(session_options, kOrtSessionOptionsConfigIntraOpThreadAffinities,
+				ortThreadAffinities(intra_op_cpus).c_str()));
+		}
+
+		// Define the execution provider
+		std::string provider_name = execution_provider;
+
+		// Map execution providers to specific actions (e.g., settings for DML)
+		std::unordered_map<std::string, std::function<void()>> execution_provider_actions = {
+			{"CPU", []() {}},  // No special settings for CPU
+			{"Dml", [&]() {   // Settings for DirectML (DML)
+				ort->DisableMemPattern(session_options);
+				ort->SetSessionExecutionMode(session_options, ExecutionMode::ORT_SEQUENTIAL);
+				OrtSessionOptionsAppendExecutionProvider_DML(session_options, 0);
+			}}
+		};
+
+		// Apply the settings based on the chosen execution provider
+		bool action_taken = false;
+		for (const auto& pair : execution_provider_actions) {
+			const auto& key = pair.first;
+			const auto& action = pair.second;
+
+			if (provider_name.find(key) != std::string::npos) {
+				action();
+				action_taken = true;
+				break;
+			}
+		}
 
-		// Populate the global provider names vector
-		provider_names = std::vector<std::string>(raw_provider_names, raw_provider_names + provider_count);
+		// Load the ONNX model
+		OrtSession* new_session = nullptr;
+		OrtStatus* status = nullptr;
+		if (action_taken && model.bytes.empty()) {
+			status = ort->CreateSession(session_env, stringToWstring(model.path).c_str(), session_options, &new_session);
+		}
+		else if (action_taken) {
+			// ONNX Runtime copies what it needs, so the buffer can be freed once the session exists
+			status = ort->CreateSessionFromArray(session_env, model.bytes.data(), model.bytes.size(), session_options, &new_session);
+		}
+		checkStatus(status);
+		return new_session;
+	}
+
+	/// <summary>
+	/// Pick the model's session replica on the calling thread's NUMA node, falling back to the first replica.
+	/// </summary>
+	/// <param name="model">The model to run.</param>
+	/// <returns>The replica to run the call on.</returns>
+	SessionReplica& selectReplica(LoadedModel& model) {
+		if (model.replicas.size() > 1) {
+			int node = currentNumaNode();
+			for (auto& replica : model.replicas) {
+				if (replica->numa_node == node) return *replica;
+			}
+		}
+		return *model.replicas.front();
+	}
+
+	/// <summary>
+	/// Initialize the ONNX Runtime API and retrieve the available providers.
+	/// Both are fetched once per process, so repeated calls are cheap.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void InitOrtAPI() {
+		RuntimeContext::Get();
 	}
 
 	/// <summary>
@@ -55,7 +302,7 @@ extern "C" {
 	/// </summary>
 	/// <returns>The number of execution providers.</returns>
 	DLLExport int GetProviderCount() {
-		return static_cast<int>(provider_names.size());
+		return static_cast<int>(RuntimeContext::Get().Providers().size());
 	}
 
 	/// <summary>
@@ -64,6 +311,7 @@ extern "C" {
 	/// <param name="index">The index of the provider.</param>
 	/// <returns>The name of the provider or nullptr if index is out of bounds.</returns>
 	DLLExport const char* GetProviderName(int index) {
+		const std::vector<std::string>& provider_names = RuntimeContext::Get().Providers();
 		if (index >= 0 && index < provider_names.size()) {
 			return provider_names[index].c_str();
 		}
@@ -75,87 +323,47 @@ extern "C" {
 	/// </summary>
 	/// <returns></returns>
 	DLLExport void FreeResources() {
-		if (session) ort->ReleaseSession(session);
-		if (env) ort->ReleaseEnv(env);
+		// The sessions are released when the last call on them returns; the environment stays with the runtime context
+		publishModel(nullptr);
+		result_cache.Clear();
 	}
 	
 	/// <summary>
-	/// Load an ONNX model and prepare it for inference.
+	/// Load an ONNX model with load-time options and prepare it for inference.
 	/// </summary>
-	/// <param name="model_path">Path to the ONNX model file.</param>
+	/// <param name="model_path">Path to the ONNX model file, which may be LZ4-compressed.</param>
 	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
 	/// <param name="image_dims">Dimensions of the input image [width, height].</param>
+	/// <param name="options">Semicolon-separated "key=value" load options (see LoadOptions), or an empty string for defaults.</param>
 	/// <returns>A message indicating the success or failure of the loading process.</returns>
-	DLLExport const char* LoadModel(const char* model_path, const char* execution_provider, int image_dims[2]) {
-		try {
-			// Define an instance name for the session
-			std::string instance_name = "inference-session";
-
-			// Create an ONNX Runtime environment with a given logging level
-			ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, instance_name.c_str(), &env);
-
-			// Disable telemetry events
-			ort->DisableTelemetryEvents(env);
-
-			// Create session options for further configuration
-			ort->CreateSessionOptions(&session_options);
-
-			// Define the execution provider
-			std::string provider_name = execution_provider;
-
-			// Map execution providers to specific actions (e.g., settings for DML)
-			std::unordered_map<std::string, std::function<void()>> execution_provider_actions = {
-				{"CPU", []() {}},  // No special settings for CPU
-				{"Dml", [&]() {   // Settings for DirectML (DML)
-					ort->DisableMemPattern(session_options);
-					ort->SetSessionExecutionMode(session_options, ExecutionMode::ORT_SEQUENTIAL);
-					OrtSessionOptionsAppendExecutionProvider_DML(session_options, 0);
-				}}
-			};
-
-			// Apply the settings based on the chosen execution provider
-			bool action_taken = false;
-			for (const auto& pair : execution_provider_actions) {
-				const auto& key = pair.first;
-				const auto& action = pair.second;
-
-				if (provider_name.find(key) != std::string::npos) {
-					action();
-					action_taken = true;
-					break;
-				}
-			}
+	DLLExport const char* LoadModelWithOptions(const char* model_path, const char* execution_provider, int image_dims[2], const char* options) {
+		// Holds exception messages after the exception itself is destroyed
+		static std::string error_message;
 
-			if (!action_taken) {
-				return "Unknown execution provider specified.";
-			}
-
-			// Load the ONNX model
-			ort->CreateSession(env, stringToWstring(model_path).c_str(), session_options, &session);
-			ort->ReleaseSessionOptions(session_options);
+		try {
+			// Parse the load options before creating any resources
+			LoadOptions load_options = parseLoadOptions(options);
 
-			// Set up an allocator for retrieving input-output names
-			Ort::AllocatorWithDefaultOptions allocator;
+			// The image dimensions belong to the new model, so calls still running on the old one keep theirs
+			std::shared_ptr<LoadedModel> new_model;
+			const char* error = buildModel(model_path, execution_provider, load_options, image_dims[0], image_dims[1], new_model);
+			if (error) return error;
 
-			char* temp_input_name;
-			ort->SessionGetInputName(session, 0, allocator, &temp_input_name);
-			input_name = temp_input_name;
+			// Replace any previously loaded model
+			publishModel(std::move(new_model));
 
-			char* temp_output_name;
-			ort->SessionGetOutputName(session, 0, allocator, &temp_output_name);
-			output_name = temp_output_name;
+			// Cached outputs belong to the previous model
+			result_cache.Clear();
 
-			// Store image dimensions and prepare the input data container
-			input_w = image_dims[0];
-			input_h = image_dims[1];
-			n_pixels = input_w * input_h;
-			input_data.resize(n_pixels * n_channels);
+			// Record the load parameters for capture and replay
+			captureLoad(model_path, execution_provider, image_dims[0], image_dims[1], options);
 
 			return "Model loaded successfully.";
 		}
 		catch (const std::exception& e) {
 			// Handle standard exceptions and return their messages
-			return e.what();
+			error_message = e.what();
+			return error_message.c_str();
 		}
 		catch (...) {
 			// Handle all other exceptions
@@ -164,62 +372,295 @@ extern "C" {
 	}
 
 	/// <summary>
-	/// Perform inference using the loaded ONNX model.
+	/// Load an ONNX model and prepare it for inference.
+	/// </summary>
+	/// <param name="model_path">Path to the ONNX model file, which may be LZ4-compressed.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="image_dims">Dimensions of the input image [width, height].</param>
+	/// <returns>A message indicating the success or failure of the loading process.</returns>
+	DLLExport const char* LoadModel(const char* model_path, const char* execution_provider, int image_dims[2]) {
+		return LoadModelWithOptions(model_path, execution_provider, image_dims, "");
+	}
+
+	/// <summary>
+	/// Run the loaded model on one frame and pass its output to a handler while the request context is still held,
+	/// so postprocessing can read the output in place.
 	/// </summary>
 	/// <param name="image_data">Raw image data as bytes.</param>
-	/// <param name="output_array">Array to store the inferred results.</param>
-	/// <param name="length">Length of the output_array.</param>
-	/// <returns></returns>
-	DLLExport void PerformInference(byte* image_data, float* output_array, int length) {
+	/// <param name="handler">Called with the model output if the run succeeds.</param>
+	/// <param name="all_outputs">True to also fetch the outputs after the first into ModelOutput::extra_tensors.</param>
+	/// <returns>False if no model is loaded or the run failed.</returns>
+	bool runModel(byte* image_data, const ModelOutputHandler& handler, bool all_outputs) {
+		// Hold the model for the whole call, so a reload cannot release it underneath
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		return model && runModelOn(*model, image_data, handler, all_outputs);
+	}
+
+	/// <summary>
+	/// Run a model the caller holds a reference to on one frame, as runModel does for the loaded model.
+	/// </summary>
+	/// <param name="model">The model, whose image dimensions the frame must have.</param>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="handler">Called with the model output if the run succeeds.</param>
+	/// <param name="all_outputs">True to also fetch the outputs after the first into ModelOutput::extra_tensors.</param>
+	/// <returns>False if the run failed.</returns>
+	bool runModelOn(LoadedModel& model, byte* image_data, const ModelOutputHandler& handler, bool all_outputs) {
+		// Flush denormals to zero during preprocessing, the calling thread's share of the run, and postprocessing
+		DenormalGuard denormal_guard(model.options.denormals_as_zero);
+
+		// Track which processor the calling thread runs on
+		sampleThreadCpu();
+
+		// Borrow a preallocated request context from the session on the caller's NUMA node
+		SessionReplica& replica = selectReplica(model);
+		RequestContextPool::Lease context = replica.pool.Acquire();
 
 		// Preprocessing: Normalize and restructure the image data
-		for (int p = 0; p < n_pixels; p++) {
-			for (int ch = 0; ch < n_channels; ch++) {
-				// Normalize pixel values to [0, 1] and reorder channels
-				input_data[ch * n_pixels + p] = (image_data[p * n_channels + ch] / 255.0f);
+		preprocessInput(image_data, context->input.data(), model.input_type, model.n_pixels);
+
+		// Define the names of input and output tensors for inference, fetching the further outputs only on request.
+		// The arrays are reused across calls so steady-state inference does not allocate
+		const char* input_names[] = { model.input_name.c_str() };
+		thread_local std::vector<const char*> output_names;
+		thread_local std::vector<OrtValue*> output_tensors;
+		output_names.assign(1, model.output_name.c_str());
+		if (all_outputs) {
+			for (const std::string& name : model.extra_output_names) output_names.push_back(name.c_str());
+		}
+
+		// Perform inference using the ONNX Runtime, writing into the preallocated output tensor if there is one
+		output_tensors.assign(output_names.size(), nullptr);
+		output_tensors[0] = context->output_tensor;
+		OrtStatus* status = ort->Run(replica.session, nullptr, input_names, (const OrtValue* const*)&context->input_tensor, 1, output_names.data(), output_names.size(), output_tensors.data());
+		OrtValue* output_tensor = output_tensors[0];
+
+		// If inference fails, release resources and return
+		if (status) {
+			ort->ReleaseStatus(status);
+			if (output_tensor && output_tensor != context->output_tensor) ort->ReleaseValue(output_tensor);
+			for (size_t i = 1; i < output_tensors.size(); i++) {
+				if (output_tensors[i]) ort->ReleaseValue(output_tensors[i]);
 			}
+			return false;
 		}
 
-		// Define the names of input and output tensors for inference
-		const char* input_names[] = { input_name.c_str() };
-		const char* output_names[] = { output_name.c_str() };
+		// Locate the output data, and count the elements of dynamic-shape outputs
+		ModelOutput output = { output_tensor, nullptr, 0, model.output_type, context.get(), model.input_w, model.input_h };
+		output.extra_tensors.assign(output_tensors.begin() + 1, output_tensors.end());
+		if (output_tensor == context->output_tensor) {
+			output.data = context->output.data();
+			output.count = context->output_count;
+		}
+		else {
+			ort->GetTensorMutableData(output_tensor, &output.data);
+			OrtTensorTypeAndShapeInfo* shape_info;
+			ort->GetTensorTypeAndShape(output_tensor, &shape_info);
+			ort->GetTensorShapeElementCount(shape_info, &output.count);
+			ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+		}
 
-		// Define the shape of the input tensor
-		int64_t input_shape[] = { 1, 3, input_h, input_w };
+		handler(output);
 
-		// Create a memory info instance for CPU allocation
-		OrtMemoryInfo* memory_info;
-		ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info);
+		if (output_tensor != context->output_tensor) ort->ReleaseValue(output_tensor);
+		for (OrtValue* tensor : output.extra_tensors) ort->ReleaseValue(tensor);
+		return true;
+	}
 
-		// Convert the processed image data into an ONNX tensor format
-		OrtValue* input_tensor = nullptr;
-		ort->CreateTensorWithDataAsOrtValue(
-			memory_info, input_data.data(), input_data.size() * sizeof(float),
-			input_shape, 4, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, &input_tensor
-		);
+	/// <summary>
+	/// Run the loaded model on one frame and write the output as floats or as raw half-precision values.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="output_array">Array to store float results, or nullptr when half_output is used.</param>
+	/// <param name="half_output">Array to store half-precision results, or nullptr when output_array is used.</param>
+	/// <param name="length">Length of the output array.</param>
+	/// <returns></returns>
+	void runInference(byte* image_data, float* output_array, uint16_t* half_output, int length) {
+		// Hold the model for the whole call; the frame size, cache and run all refer to it
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return;
+		uint32_t frame_bytes = static_cast<uint32_t>(model->n_pixels) * n_channels;
+
+		// Record the raw frame if a capture is active
+		captureFrame(image_data, frame_bytes, length);
+
+		// Return the cached output if this exact frame has been seen before
+		bool use_cache = output_array && result_cache.IsEnabled();
+		uint64_t cache_key = 0;
+		if (use_cache) {
+			cache_key = hashBytes(image_data, frame_bytes);
+			if (result_cache.Lookup(model->generation, cache_key, output_array, length)) return;
+		}
 
-		// Free the memory info after usage
-		ort->ReleaseMemoryInfo(memory_info);
+		// Copy the inference results to the provided output array
+		bool succeeded = runModelOn(*model, image_data, [&](const ModelOutput& output) {
+			size_t count = std::min(static_cast<size_t>(length), output.count);
+			if (output_array) writeOutput(output.data, count, output_array, output.element_type);
+			else writeHalfOutput(output.data, count, half_output, output.element_type);
+		});
+
+		// Remember the output for repeated frames
+		if (use_cache && succeeded) result_cache.Insert(model->generation, cache_key, output_array, length);
+	}
 
-		// Perform inference using the ONNX Runtime
-		OrtValue* output_tensor = nullptr;
-		ort->Run(session, nullptr, input_names, (const OrtValue* const*)&input_tensor, 1, output_names, 1, &output_tensor);
+	/// <summary>
+	/// Perform inference using the loaded ONNX model.
+	/// Safe to call from multiple threads at once while the model stays loaded.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="output_array">Array to store the inferred results. Half-precision outputs are converted to float.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns></returns>
+	DLLExport void PerformInference(byte* image_data, float* output_array, int length) {
+		runInference(image_data, output_array, nullptr, length);
+	}
 
-		// If inference fails, release resources and return
-		if (!output_tensor) {
-			ort->ReleaseValue(input_tensor);
-			return;
+	/// <summary>
+	/// Perform inference and return the output as raw IEEE half-precision values, without a float conversion.
+	/// Float outputs are converted to half precision.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="output_array">Array of 16-bit values to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns></returns>
+	DLLExport void PerformInferenceHalf(byte* image_data, uint16_t* output_array, int length) {
+		runInference(image_data, nullptr, output_array, length);
+	}
+
+	/// <summary>
+	/// Get usage statistics for the request context pools, summed over every session replica.
+	/// </summary>
+	/// <param name="stats">Receives the pool statistics.</param>
+	/// <returns></returns>
+	DLLExport void GetRequestPoolStats(RequestPoolStats* stats) {
+		*stats = {};
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		if (!model) return;
+		for (auto& replica : model->replicas) {
+			RequestPoolStats replica_stats = replica->pool.GetStats();
+			stats->capacity += replica_stats.capacity;
+			stats->in_use += replica_stats.in_use;
+			stats->peak_in_use += replica_stats.peak_in_use;
+			stats->waits += replica_stats.waits;
 		}
+	}
 
-		// Extract data from the output tensor
-		float* out_data;
-		ort->GetTensorMutableData(output_tensor, (void**)&out_data);
+	/// <summary>
+	/// Get the number of NUMA nodes, for choosing numa_node load options.
+	/// </summary>
+	/// <returns>The number of NUMA nodes (1 on single-socket systems).</returns>
+	DLLExport int GetNumaNodeCount() {
+		return numaNodeCount();
+	}
+}
 
-		// Copy the inference results to the provided output array
-		std::memcpy(output_array, out_data, length * sizeof(float));
+/// <summary>
+/// Create the sessions and request contexts for a model at the given image dimensions,
+/// without touching the loaded model.
+/// </summary>
+/// <param name="model_path">Path to the ONNX model file.</param>
+/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+/// <param name="load_options">The parsed load options.</param>
+/// <param name="width">Width of the input image.</param>
+/// <param name="height">Height of the input image.</param>
+/// <param name="model">Receives the model.</param>
+/// <returns>nullptr on success, or a message explaining why the model cannot be used. Throws if ONNX Runtime fails.</returns>
+const char* buildModel(const char* model_path, const char* execution_provider, const LoadOptions& load_options, int width, int height, std::shared_ptr<LoadedModel>& model) {
+	// Decide where each session runs: one per NUMA node, one bound to a node, or one unbound
+	std::vector<int> replica_nodes = { load_options.numa_node };
+	if (load_options.numa_replicas) {
+		replica_nodes.clear();
+		for (int node = 0; node < numaNodeCount(); node++) replica_nodes.push_back(node);
+	}
+	else if (load_options.numa_node >= numaNodeCount()) {
+		return "Load option 'numa_node' exceeds the number of NUMA nodes.";
+	}
+
+	// Compressed models are decompressed once, shared by the replicas and freed when the sessions exist
+	ModelSource source = openModel(model_path, load_options.map_external_data);
+
+	// Numbers models in build order, so results cached for a replaced model are told apart from the current model's
+	static std::atomic<uint64_t> next_generation{ 1 };
+
+	std::shared_ptr<LoadedModel> new_model = std::make_shared<LoadedModel>();
+	new_model->generation = next_generation++;
+	new_model->env = RuntimeContext::Get().Env();
+	new_model->input_w = width;
+	new_model->input_h = height;
+	new_model->n_pixels = width * height;
+	new_model->external_initializers = source.external_initializers;
+	for (int node : replica_nodes) {
+		// Explicit intra-op processors take precedence over the node's processors
+		std::vector<int> intra_op_cpus = load_options.intra_op_cpus;
+		if (intra_op_cpus.empty() && node >= 0) intra_op_cpus = numaNodeCpus(node);
+
+		std::unique_ptr<SessionReplica> replica = std::make_unique<SessionReplica>();
+		replica->numa_node = node;
+		replica->session = createSession(new_model->env.get(), source, execution_provider, load_options, intra_op_cpus, false);
+		if (!replica->session) {
+			return "Unknown execution provider specified.";
+		}
+		new_model->replicas.push_back(std::move(replica));
+	}
+	OrtSession* new_session = new_model->replicas.front()->session;
+
+	new_model->input_name = getTensorName(new_session, true);
+	new_model->output_name = getTensorName(new_session, false);
+
+	// Further outputs, such as the prototype masks of segmentation models, are only fetched by the stages that use them
+	size_t output_count = 0;
+	checkStatus(ort->SessionGetOutputCount(new_session, &output_count));
+	for (size_t i = 1; i < output_count; i++) new_model->extra_output_names.push_back(getTensorName(new_session, false, i));
+
+	// Quantized models may take uint8 input, which skips normalization in preprocessing
+	new_model->input_type = getElementType(new_session, true);
+	if (new_model->input_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && new_model->input_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
+		return "Unsupported model input type. Expected a float or uint8 tensor.";
+	}
+
+	// fp16-exported models produce half-precision output, which is converted when copied out
+	new_model->output_type = getElementType(new_session, false);
+	if (new_model->output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && new_model->output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+		return "Unsupported model output type. Expected a float or float16 tensor.";
+	}
 
-		// Release resources associated with the tensors
-		ort->ReleaseValue(input_tensor);
-		ort->ReleaseValue(output_tensor);
+	// Preallocate the per-call buffers and tensors
+	new_model->options = load_options;
+	for (auto& replica : new_model->replicas) {
+		replica->pool.Reset(replica->session, load_options.pool_size, replica->numa_node, new_model->input_type, new_model->output_type, width, height);
 	}
+
+	model = std::move(new_model);
+	return nullptr;
+}
+
+/// <summary>
+/// Make a model the loaded model. Callers read it once with std::atomic_load and hold the reference for
+/// the whole call, so nothing about the model is mirrored into globals that a reload would race with.
+/// </summary>
+/// <param name="model">The new model, or nullptr to unload.</param>
+/// <returns>The previous model. Calls still running on it keep it alive until they return.</returns>
+std::shared_ptr<LoadedModel> publishModel(std::shared_ptr<LoadedModel> model) {
+	std::shared_ptr<LoadedModel> previous = std::atomic_exchange(&loaded_model, std::move(model));
+
+	// The new model may carry different worker_cpus and denormals_as_zero options
+	workerOptionsChanged();
+	return previous;
+}
+
+/// <summary>
+/// Get the name of one of a session's inputs or outputs, freeing the copy ONNX Runtime allocates for it.
+/// </summary>
+/// <param name="session">The loaded session.</param>
+/// <param name="is_input">True for an input, false for an output.</param>
+/// <param name="index">Index of the input or output.</param>
+/// <returns>The tensor name. Throws if the session has no such tensor.</returns>
+std::string getTensorName(OrtSession* session, bool is_input, size_t index) {
+	Ort::AllocatorWithDefaultOptions allocator;
+	char* raw_name = nullptr;
+	if (is_input) checkStatus(ort->SessionGetInputName(session, index, allocator, &raw_name));
+	else checkStatus(ort->SessionGetOutputName(session, index, allocator, &raw_name));
+
+	std::string name = raw_name;
+	checkStatus(ort->AllocatorFree(allocator, raw_name));
+	return name;
 }
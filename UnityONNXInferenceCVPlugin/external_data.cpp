@@ -0,0 +1,317 @@
+#include "pch.h"
+#include "external_data.h"
+#include "plugin.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+	/// <summary>
+	/// Reader for the protobuf wire format, enough to walk an ONNX model without the generated classes.
+	/// </summary>
+	class ProtoReader {
+	public:
+		ProtoReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+		bool Done() const { return p >= end; }
+
+		/// <summary>
+		/// Read the next field's tag.
+		/// </summary>
+		void ReadTag(uint32_t& field, uint32_t& wire_type) {
+			uint64_t tag = ReadVarint();
+			field = static_cast<uint32_t>(tag >> 3);
+			wire_type = static_cast<uint32_t>(tag & 7);
+		}
+
+		uint64_t ReadVarint() {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (p >= end) throw std::runtime_error("Model file is corrupt.");
+				uint8_t byte = *p++;
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if (!(byte & 0x80)) return value;
+			}
+			throw std::runtime_error("Model file is corrupt.");
+		}
+
+		/// <summary>
+		/// Read a length-delimited field as a nested reader.
+		/// </summary>
+		ProtoReader ReadMessage() {
+			uint64_t size = ReadVarint();
+			if (size > static_cast<uint64_t>(end - p)) throw std::runtime_error("Model file is corrupt.");
+			ProtoReader message(p, static_cast<size_t>(size));
+			p += size;
+			return message;
+		}
+
+		std::string ReadString() {
+			ProtoReader message = ReadMessage();
+			return std::string(reinterpret_cast<const char*>(message.p), message.end - message.p);
+		}
+
+		/// <summary>
+		/// Skip a field's value without touching the bytes of length-delimited fields, such as embedded weights.
+		/// </summary>
+		void Skip(uint32_t wire_type) {
+			size_t size;
+			switch (wire_type) {
+			case 0: ReadVarint(); return;
+			case 1: size = 8; break;
+			case 2: ReadMessage(); return;
+			case 5: size = 4; break;
+			default: throw std::runtime_error("Model file is corrupt.");
+			}
+			if (size > static_cast<size_t>(end - p)) throw std::runtime_error("Model file is corrupt.");
+			p += size;
+		}
+
+	private:
+		const uint8_t* p;
+		const uint8_t* end;
+	};
+
+	/// <summary>
+	/// The fields of an ONNX TensorProto needed to serve it from an external file.
+	/// </summary>
+	struct ExternalTensor {
+		std::string name;
+		int data_type = 0;
+		std::vector<int64_t> dims;
+		std::string location;
+		uint64_t offset = 0;
+		int64_t length = -1;              // Bytes in the file, or -1 if not recorded
+		bool external = false;            // data_location is EXTERNAL
+	};
+
+	// TensorProto, GraphProto and ModelProto field numbers
+	const uint32_t tensor_dims = 1;
+	const uint32_t tensor_data_type = 2;
+	const uint32_t tensor_name = 8;
+	const uint32_t tensor_external_data = 13;
+	const uint32_t tensor_data_location = 14;
+	const uint32_t node_input = 1;
+	const uint32_t graph_node = 1;
+	const uint32_t graph_initializer = 5;
+	const uint32_t graph_output = 12;
+	const uint32_t value_info_name = 1;
+	const uint32_t model_graph = 7;
+
+	/// <summary>
+	/// Add the string values of one repeated field in a message to a set.
+	/// </summary>
+	void readNames(ProtoReader message, uint32_t name_field, std::unordered_set<std::string>& names) {
+		while (!message.Done()) {
+			uint32_t field, wire_type;
+			message.ReadTag(field, wire_type);
+			if (field == name_field && wire_type == 2) names.insert(message.ReadString());
+			else message.Skip(wire_type);
+		}
+	}
+
+	ExternalTensor readTensor(ProtoReader tensor) {
+		ExternalTensor result;
+		while (!tensor.Done()) {
+			uint32_t field, wire_type;
+			tensor.ReadTag(field, wire_type);
+			if (field == tensor_dims && wire_type == 0) {
+				result.dims.push_back(static_cast<int64_t>(tensor.ReadVarint()));
+			}
+			else if (field == tensor_dims && wire_type == 2) {
+				ProtoReader packed = tensor.ReadMessage();
+				while (!packed.Done()) result.dims.push_back(static_cast<int64_t>(packed.ReadVarint()));
+			}
+			else if (field == tensor_data_type && wire_type == 0) {
+				result.data_type = static_cast<int>(tensor.ReadVarint());
+			}
+			else if (field == tensor_name && wire_type == 2) {
+				result.name = tensor.ReadString();
+			}
+			else if (field == tensor_external_data && wire_type == 2) {
+				// StringStringEntryProto: key = 1, value = 2
+				ProtoReader entry = tensor.ReadMessage();
+				std::string key, value;
+				while (!entry.Done()) {
+					uint32_t entry_field, entry_wire_type;
+					entry.ReadTag(entry_field, entry_wire_type);
+					if (entry_field == 1 && entry_wire_type == 2) key = entry.ReadString();
+					else if (entry_field == 2 && entry_wire_type == 2) value = entry.ReadString();
+					else entry.Skip(entry_wire_type);
+				}
+				if (key == "location") result.location = value;
+				else if (key == "offset") result.offset = std::stoull(value);
+				else if (key == "length") result.length = std::stoll(value);
+			}
+			else if (field == tensor_data_location && wire_type == 0) {
+				result.external = tensor.ReadVarint() == 1;
+			}
+			else {
+				tensor.Skip(wire_type);
+			}
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Bytes per element of the tensor types that can be served from a mapping, or 0 for the others.
+	/// </summary>
+	size_t elementSize(int data_type) {
+		switch (static_cast<ONNXTensorElementDataType>(data_type)) {
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+			return 1;
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+			return 2;
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+			return 4;
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+		case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+}
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	file = CreateFileW(stringToWstring(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		Close();
+		return false;
+	}
+	size = static_cast<uint64_t>(file_size.QuadPart);
+
+	// Empty files cannot be mapped, and need no view
+	if (size == 0) return true;
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	view = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (!view) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	view = nullptr;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+	size = 0;
+}
+
+ExternalInitializers::~ExternalInitializers() {
+	// The tensors point into the mappings, so release them before the files are unmapped
+	for (OrtValue* value : values) ort->ReleaseValue(value);
+}
+
+void ExternalInitializers::AddTo(OrtSessionOptions* session_options) const {
+	checkStatus(ort->AddExternalInitializers(session_options, name_pointers.data(), values.data(), values.size()));
+}
+
+std::shared_ptr<ExternalInitializers> mapExternalInitializers(const std::string& model_path, const std::vector<uint8_t>& model_bytes) {
+	// Map the model itself unless it is already in memory; skipping fields leaves embedded weights untouched
+	MappedFile model_file;
+	const uint8_t* model_data = model_bytes.data();
+	size_t model_size = model_bytes.size();
+	if (model_bytes.empty()) {
+		if (!model_file.Open(model_path)) return nullptr;
+		model_data = model_file.Data();
+		model_size = static_cast<size_t>(model_file.Size());
+	}
+
+	// Collect the main graph's external initializers and the names its nodes and outputs use
+	std::vector<ExternalTensor> tensors;
+	std::unordered_set<std::string> used_names;
+	ProtoReader model(model_data, model_size);
+	while (!model.Done()) {
+		uint32_t field, wire_type;
+		model.ReadTag(field, wire_type);
+		if (field != model_graph || wire_type != 2) {
+			model.Skip(wire_type);
+			continue;
+		}
+		ProtoReader graph = model.ReadMessage();
+		while (!graph.Done()) {
+			graph.ReadTag(field, wire_type);
+			if (field == graph_node && wire_type == 2) {
+				readNames(graph.ReadMessage(), node_input, used_names);
+			}
+			else if (field == graph_output && wire_type == 2) {
+				readNames(graph.ReadMessage(), value_info_name, used_names);
+			}
+			else if (field == graph_initializer && wire_type == 2) {
+				ExternalTensor tensor = readTensor(graph.ReadMessage());
+				if (tensor.external && !tensor.location.empty() && elementSize(tensor.data_type) > 0) tensors.push_back(std::move(tensor));
+			}
+			else {
+				graph.Skip(wire_type);
+			}
+		}
+	}
+
+	// ONNX Runtime drops unused initializers before it applies the registered ones, and rejects
+	// a registered name it can no longer find; initializers only subgraphs use are left to it as well
+	tensors.erase(std::remove_if(tensors.begin(), tensors.end(),
+		[&](const ExternalTensor& tensor) { return used_names.count(tensor.name) == 0; }), tensors.end());
+	if (tensors.empty()) return nullptr;
+
+	// External file locations are relative to the model's directory
+	size_t separator = model_path.find_last_of("/\\");
+	std::string directory = (separator == std::string::npos) ? std::string() : model_path.substr(0, separator + 1);
+
+	OrtMemoryInfo* memory_info;
+	checkStatus(ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+	OrtPtr<OrtMemoryInfo> memory_info_owner(memory_info);
+
+	std::shared_ptr<ExternalInitializers> result = std::make_shared<ExternalInitializers>();
+	std::vector<std::string> locations;
+	for (const ExternalTensor& tensor : tensors) {
+		// Map each weight file once, however many tensors it holds
+		size_t file_index = std::find(locations.begin(), locations.end(), tensor.location) - locations.begin();
+		if (file_index == locations.size()) {
+			std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+			if (!file->Open(directory + tensor.location)) {
+				throw std::runtime_error("Unable to map external data file: " + tensor.location);
+			}
+			locations.push_back(tensor.location);
+			result->files.push_back(std::move(file));
+		}
+		const MappedFile& file = *result->files[file_index];
+
+		uint64_t element_count = 1;
+		for (int64_t dim : tensor.dims) {
+			if (dim < 0) throw std::runtime_error("Model file is corrupt.");
+			element_count *= static_cast<uint64_t>(dim);
+		}
+		uint64_t bytes = element_count * elementSize(tensor.data_type);
+		if ((tensor.length >= 0 && static_cast<uint64_t>(tensor.length) != bytes) || tensor.offset > file.Size() || bytes > file.Size() - tensor.offset) {
+			throw std::runtime_error("External data for initializer '" + tensor.name + "' does not match its shape.");
+		}
+
+		// ONNX Runtime only reads initializers, so the read-only view can back the tensor directly
+		OrtValue* value = nullptr;
+		void* data = const_cast<uint8_t*>(file.Data() + tensor.offset);
+		checkStatus(ort->CreateTensorWithDataAsOrtValue(memory_info, data, static_cast<size_t>(bytes), tensor.dims.data(), tensor.dims.size(),
+			static_cast<ONNXTensorElementDataType>(tensor.data_type), &value));
+		result->values.push_back(value);
+		result->names.push_back(tensor.name);
+	}
+	for (const std::string& name : result->names) result->name_pointers.push_back(name.c_str());
+	return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A read-only memory mapping of a whole file.
+/// </summary>
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Map a file. Pages are read from disk when first touched and can be dropped again under memory pressure.
+	/// </summary>
+	/// <returns>False if the file cannot be opened or mapped.</returns>
+	bool Open(const std::string& path);
+	void Close();
+
+	const uint8_t* Data() const { return view; }
+	uint64_t Size() const { return size; }
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const uint8_t* view = nullptr;
+	uint64_t size = 0;
+};
+
+/// <summary>
+/// Initializers of an external-data model, served straight from memory-mapped weight files.
+/// Registering them with a session stops ONNX Runtime from reading the weight files into buffers of its own,
+/// so the weights are not held twice while the session is created. Must outlive the sessions it is added to.
+/// </summary>
+class ExternalInitializers {
+public:
+	ExternalInitializers() = default;
+	~ExternalInitializers();
+
+	ExternalInitializers(const ExternalInitializers&) = delete;
+	ExternalInitializers& operator=(const ExternalInitializers&) = delete;
+
+	/// <summary>
+	/// Register the initializers with a session's options.
+	/// </summary>
+	void AddTo(OrtSessionOptions* session_options) const;
+
+	size_t Count() const { return names.size(); }
+
+private:
+	friend std::shared_ptr<ExternalInitializers> mapExternalInitializers(const std::string&, const std::vector<uint8_t>&);
+
+	std::vector<std::unique_ptr<MappedFile>> files;
+	std::vector<std::string> names;
+	std::vector<const char*> name_pointers;
+	std::vector<OrtValue*> values;    // Tensors over the mapped files
+};
+
+/// <summary>
+/// Find the graph initializers a model stores in external files and map those files.
+/// Initializers the plugin cannot serve from a mapping, such as string tensors, are left for ONNX Runtime to load.
+/// </summary>
+/// <param name="model_path">Path of the model; external file locations are relative to its directory.</param>
+/// <param name="model_bytes">The model's contents if already in memory, or empty to map the model file.</param>
+/// <returns>The mapped initializers, or nullptr if the model has none. Throws std::runtime_error if a weight file is missing or too short.</returns>
+std::shared_ptr<ExternalInitializers> mapExternalInitializers(const std::string& model_path, const std::vector<uint8_t>& model_bytes);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <float.h>
+
+/// <summary>
+/// Set or clear flush-to-zero and denormals-are-zero for floating-point math on the calling thread.
+/// </summary>
+/// <param name="enable">True to treat denormal inputs and results as zero.</param>
+inline void setDenormalsAsZero(bool enable) {
+	unsigned int current;
+	_controlfp_s(&current, enable ? _DN_FLUSH : _DN_SAVE, _MCW_DN);
+}
+
+/// <summary>
+/// Flushes denormals to zero on the calling thread for the guard's lifetime, then restores the caller's mode.
+/// Keeps the setting from leaking into Unity's own threads when the plugin is called on them.
+/// </summary>
+class DenormalGuard {
+public:
+	explicit DenormalGuard(bool enable) : enabled(enable) {
+		if (!enabled) return;
+		_controlfp_s(&previous, 0, 0);
+		setDenormalsAsZero(true);
+	}
+
+	~DenormalGuard() {
+		if (!enabled) return;
+		unsigned int current;
+		_controlfp_s(&current, previous & _MCW_DN, _MCW_DN);
+	}
+
+	DenormalGuard(const DenormalGuard&) = delete;
+	DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+private:
+	bool enabled;
+	unsigned int previous = 0;
+};
@@ -0,0 +1,349 @@
+#include "pch.h"
+#include "plugin.h"
+#include "cpu_features.h"
+#include "gallery.h"
+#include "half.h"
+#include "task_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define GALLERY_USE_AVX2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define GALLERY_USE_NEON
+#endif
+
+namespace {
+	const size_t row_alignment = 16;          // Floats per cache line; rows are padded to a multiple of it
+	const size_t rows_per_task = 8192;        // Larger galleries are searched in chunks of this many rows on the task pool
+
+#ifdef GALLERY_USE_AVX2
+	/// <summary>
+	/// Sum the lanes of a vector.
+	/// </summary>
+	float horizontalSum(__m256 v) {
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+	}
+#endif
+
+	/// <summary>
+	/// Dot products of a query with four consecutive rows, sharing each load of the query between the rows.
+	/// Both are padded to the stride, a multiple of 16, so there is no tail.
+	/// </summary>
+	void dotFourRows(const float* query, const float* row, size_t stride, float* out) {
+#if defined(GALLERY_USE_AVX2)
+		if (cpuHasAvx2()) {
+			__m256 acc[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+			for (size_t i = 0; i < stride; i += 8) {
+				__m256 q = _mm256_loadu_ps(query + i);
+				for (int r = 0; r < 4; r++) acc[r] = _mm256_add_ps(acc[r], _mm256_mul_ps(q, _mm256_loadu_ps(row + r * stride + i)));
+			}
+			for (int r = 0; r < 4; r++) out[r] = horizontalSum(acc[r]);
+			return;
+		}
+#elif defined(GALLERY_USE_NEON)
+		float32x4_t acc[4] = { vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f) };
+		for (size_t i = 0; i < stride; i += 4) {
+			float32x4_t q = vld1q_f32(query + i);
+			for (int r = 0; r < 4; r++) acc[r] = vmlaq_f32(acc[r], q, vld1q_f32(row + r * stride + i));
+		}
+		for (int r = 0; r < 4; r++) out[r] = vaddvq_f32(acc[r]);
+		return;
+#endif
+		for (int r = 0; r < 4; r++) {
+			float sum = 0.0f;
+			for (size_t i = 0; i < stride; i++) sum += query[i] * row[r * stride + i];
+			out[r] = sum;
+		}
+	}
+
+	/// <summary>
+	/// Dot product of a query with one row, both padded to the stride.
+	/// </summary>
+	float dotRow(const float* query, const float* row, size_t stride) {
+		float sum = 0.0f;
+		for (size_t i = 0; i < stride; i++) sum += query[i] * row[i];
+		return sum;
+	}
+
+	// Orders matches so the heap's front is the weakest kept match
+	bool strongerMatch(const GalleryMatch& a, const GalleryMatch& b) {
+		return a.similarity > b.similarity;
+	}
+
+	/// <summary>
+	/// Offer a candidate to a min-heap of at most k matches.
+	/// </summary>
+	void offerMatch(std::vector<GalleryMatch>& best, size_t k, int64_t id, float similarity) {
+		if (best.size() < k) {
+			best.push_back({ id, similarity });
+			std::push_heap(best.begin(), best.end(), strongerMatch);
+		}
+		else if (similarity > best.front().similarity) {
+			std::pop_heap(best.begin(), best.end(), strongerMatch);
+			best.back() = { id, similarity };
+			std::push_heap(best.begin(), best.end(), strongerMatch);
+		}
+	}
+}
+
+bool normalizeEmbedding(float* vector, size_t count) {
+	size_t i = 0;
+	float sum = 0.0f;
+#if defined(GALLERY_USE_AVX2)
+	if (cpuHasAvx2()) {
+		__m256 acc = _mm256_setzero_ps();
+		for (; i + 8 <= count; i += 8) {
+			__m256 v = _mm256_loadu_ps(vector + i);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(v, v));
+		}
+		sum = horizontalSum(acc);
+	}
+#elif defined(GALLERY_USE_NEON)
+	float32x4_t acc = vdupq_n_f32(0.0f);
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t v = vld1q_f32(vector + i);
+		acc = vmlaq_f32(acc, v, v);
+	}
+	sum = vaddvq_f32(acc);
+#endif
+	for (; i < count; i++) sum += vector[i] * vector[i];
+
+	if (!(sum > 0.0f) || std::isinf(sum)) return false;
+	float scale = 1.0f / std::sqrt(sum);
+	for (i = 0; i < count; i++) vector[i] *= scale;
+	return true;
+}
+
+bool EmbeddingGallery::Add(int64_t id, const float* embedding, int embedding_dimension) {
+	if (embedding_dimension <= 0) return false;
+	std::vector<float> normalized(embedding, embedding + embedding_dimension);
+	if (!normalizeEmbedding(normalized.data(), normalized.size())) return false;
+
+	std::unique_lock<std::shared_timed_mutex> lock(mutex);
+	if (dimension == 0) {
+		dimension = embedding_dimension;
+		stride = (dimension + row_alignment - 1) / row_alignment * row_alignment;
+	}
+	if (embedding_dimension != dimension) return false;
+
+	// Overwrite the identifier's row, or append one
+	auto existing = row_of_id.find(id);
+	size_t row = (existing != row_of_id.end()) ? existing->second : ids.size();
+	if (row == ids.size()) {
+		rows.resize(rows.size() + stride, 0.0f);
+		ids.push_back(id);
+		row_of_id[id] = row;
+	}
+	std::copy(normalized.begin(), normalized.end(), rows.begin() + row * stride);
+	return true;
+}
+
+bool EmbeddingGallery::Remove(int64_t id) {
+	std::unique_lock<std::shared_timed_mutex> lock(mutex);
+	auto existing = row_of_id.find(id);
+	if (existing == row_of_id.end()) return false;
+
+	// Move the last row into the hole so the matrix stays contiguous
+	size_t row = existing->second;
+	size_t last = ids.size() - 1;
+	if (row != last) {
+		std::copy(rows.begin() + last * stride, rows.begin() + (last + 1) * stride, rows.begin() + row * stride);
+		ids[row] = ids[last];
+		row_of_id[ids[row]] = row;
+	}
+	row_of_id.erase(existing);
+	ids.pop_back();
+	rows.resize(ids.size() * stride);
+	return true;
+}
+
+void EmbeddingGallery::Clear() {
+	std::unique_lock<std::shared_timed_mutex> lock(mutex);
+	rows.clear();
+	ids.clear();
+	row_of_id.clear();
+	dimension = 0;
+	stride = 0;
+}
+
+int EmbeddingGallery::Size() const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	return static_cast<int>(ids.size());
+}
+
+int EmbeddingGallery::Dimension() const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	return dimension;
+}
+
+void EmbeddingGallery::searchRows(const float* query, size_t first, size_t last, size_t k, std::vector<GalleryMatch>& best) const {
+	best.clear();
+	size_t row = first;
+	for (; row + 4 <= last; row += 4) {
+		float similarity[4];
+		dotFourRows(query, rows.data() + row * stride, stride, similarity);
+		for (int r = 0; r < 4; r++) offerMatch(best, k, ids[row + r], similarity[r]);
+	}
+	for (; row < last; row++) offerMatch(best, k, ids[row], dotRow(query, rows.data() + row * stride, stride));
+}
+
+int EmbeddingGallery::Search(const float* query, int query_dimension, int k, GalleryMatch* matches) const {
+	std::shared_lock<std::shared_timed_mutex> lock(mutex);
+	if (k <= 0 || ids.empty() || query_dimension != dimension) return 0;
+	size_t top = static_cast<size_t>(k);
+
+	// Pad the query like the rows, so the dot products need no tail
+	thread_local std::vector<float> padded;
+	padded.assign(stride, 0.0f);
+	std::copy(query, query + dimension, padded.begin());
+
+	// Large galleries are split over the task pool, each chunk keeping its own best k
+	size_t count = ids.size();
+	size_t chunk_count = (count + rows_per_task - 1) / rows_per_task;
+	std::vector<std::vector<GalleryMatch>> chunk_best(chunk_count);
+	if (chunk_count == 1) {
+		searchRows(padded.data(), 0, count, top, chunk_best[0]);
+	}
+	else {
+		TaskGroup group(sharedTaskPool());
+		const float* padded_query = padded.data();
+		for (size_t c = 0; c < chunk_count; c++) {
+			group.Run([this, padded_query, c, count, top, &chunk_best]() {
+				searchRows(padded_query, c * rows_per_task, std::min(count, (c + 1) * rows_per_task), top, chunk_best[c]);
+			});
+		}
+		group.Wait();
+	}
+
+	// Merge the chunks' matches and return them strongest first
+	std::vector<GalleryMatch> best;
+	for (const std::vector<GalleryMatch>& chunk : chunk_best) {
+		for (const GalleryMatch& match : chunk) offerMatch(best, top, match.id, match.similarity);
+	}
+	std::sort(best.begin(), best.end(), strongerMatch);
+	std::copy(best.begin(), best.end(), matches);
+	return static_cast<int>(best.size());
+}
+
+/// <summary>
+/// Run the loaded model on one frame and normalize its embedding in place, widening half-precision output first.
+/// </summary>
+/// <param name="image_data">Raw image data as bytes.</param>
+/// <param name="handler">Called with the normalized embedding and its dimension while the output is still held.</param>
+/// <returns>False if no model is loaded, the run failed, or the embedding has no direction.</returns>
+bool runEmbedding(byte* image_data, const std::function<void(const float*, int)>& handler) {
+	bool normalized = false;
+	bool ran = runModel(image_data, [&](const ModelOutput& output) {
+		float* embedding = static_cast<float*>(output.data);
+		thread_local std::vector<float> widened;
+		if (output.element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+			embedding = output.context->scratch.data();
+			if (output.context->scratch.size() < output.count) {
+				widened.resize(output.count);
+				embedding = widened.data();
+			}
+			halfToFloat(static_cast<const uint16_t*>(output.data), embedding, output.count);
+		}
+		normalized = normalizeEmbedding(embedding, output.count);
+		if (normalized) handler(embedding, static_cast<int>(output.count));
+	});
+	return ran && normalized;
+}
+
+namespace {
+	/// <summary>
+	/// Get the loaded model's gallery.
+	/// </summary>
+	/// <returns>The gallery, or null if no model is loaded.</returns>
+	std::shared_ptr<EmbeddingGallery> loadedGallery() {
+		std::shared_ptr<LoadedModel> model = std::atomic_load(&loaded_model);
+		return model ? model->gallery : nullptr;
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Add a reference embedding to the loaded model's gallery, replacing any stored under the same identifier.
+	/// The gallery belongs to the model and is emptied when another model is loaded or reloaded.
+	/// </summary>
+	/// <param name="id">Identifier returned by searches, e.g., a person or track ID.</param>
+	/// <param name="embedding">The embedding; it is normalized when stored.</param>
+	/// <param name="dimension">Number of elements, which must match the gallery's embeddings.</param>
+	/// <returns>1 if the embedding was added, 0 if no model is loaded, the dimension differs, or the embedding is all zeros.</returns>
+	DLLExport int AddGalleryEmbedding(long long id, const float* embedding, int dimension) {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		return gallery && gallery->Add(id, embedding, dimension) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Run the loaded model on an image and add its embedding to the gallery.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="id">Identifier returned by searches.</param>
+	/// <returns>1 if the embedding was added, 0 if no model is loaded, the run failed, or the embedding does not fit the gallery.</returns>
+	DLLExport int AddGalleryImage(byte* image_data, long long id) {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		bool added = false;
+		if (gallery) {
+			runEmbedding(image_data, [&](const float* embedding, int dimension) { added = gallery->Add(id, embedding, dimension); });
+		}
+		return added ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Remove an embedding from the gallery.
+	/// </summary>
+	/// <param name="id">Identifier the embedding was added with.</param>
+	/// <returns>1 if it was removed, 0 if no model is loaded or no embedding has the identifier.</returns>
+	DLLExport int RemoveGalleryEmbedding(long long id) {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		return gallery && gallery->Remove(id) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Remove every embedding from the gallery.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void ClearGallery() {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		if (gallery) gallery->Clear();
+	}
+
+	/// <summary>
+	/// Get the number of embeddings in the gallery.
+	/// </summary>
+	/// <returns>The number of embeddings, or 0 if no model is loaded.</returns>
+	DLLExport int GetGallerySize() {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		return gallery ? gallery->Size() : 0;
+	}
+
+	/// <summary>
+	/// Run the loaded embedding model on one frame, normalize the embedding in place and return only its best gallery matches.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="top_k">Most matches to return.</param>
+	/// <param name="matches">Receives up to top_k matches by descending cosine similarity.</param>
+	/// <param name="embedding">Receives the normalized embedding, or nullptr.</param>
+	/// <param name="length">Capacity of embedding; the embedding is truncated to fit.</param>
+	/// <returns>The number of matches, or -1 if no model is loaded, the run failed, or the embedding is all zeros.</returns>
+	DLLExport int PerformInferenceEmbeddingSearch(byte* image_data, int top_k, GalleryMatch* matches, float* embedding, int length) {
+		std::shared_ptr<EmbeddingGallery> gallery = loadedGallery();
+		if (!gallery) return -1;
+
+		int found = 0;
+		bool ran = runEmbedding(image_data, [&](const float* normalized, int dimension) {
+			if (embedding) std::copy(normalized, normalized + std::min(dimension, std::max(length, 0)), embedding);
+			found = gallery->Search(normalized, dimension, top_k, matches);
+		});
+		return ran ? found : -1;
+	}
+}
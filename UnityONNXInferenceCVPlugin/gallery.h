@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A gallery embedding matched by a search.
+/// </summary>
+struct GalleryMatch {
+	int64_t id;                       // Identifier the embedding was added with
+	float similarity;                 // Cosine similarity to the query, from -1 to 1
+};
+
+/// <summary>
+/// Scale a vector to unit length in place.
+/// </summary>
+/// <param name="vector">The vector.</param>
+/// <param name="count">Number of elements.</param>
+/// <returns>False if the vector has no direction (zero, or containing NaN or infinity), in which case it is left unchanged.</returns>
+bool normalizeEmbedding(float* vector, size_t count);
+
+/// <summary>
+/// Reference embeddings matched against model outputs, e.g., the identities of a re-identification model.
+/// Embeddings are stored normalized in one contiguous row-major matrix, with rows padded to whole cache lines,
+/// so a search is a single streaming pass of SIMD dot products. Searches may run concurrently with each other;
+/// changes wait for running searches.
+/// </summary>
+class EmbeddingGallery {
+public:
+	/// <summary>
+	/// Add an embedding, replacing the one stored under the same identifier. The first embedding sets the dimension.
+	/// </summary>
+	/// <param name="id">Identifier returned by searches.</param>
+	/// <param name="embedding">The embedding, which is normalized on the way in.</param>
+	/// <param name="dimension">Number of elements.</param>
+	/// <returns>False if the dimension differs from the gallery's or the embedding has no direction.</returns>
+	bool Add(int64_t id, const float* embedding, int dimension);
+
+	/// <returns>False if no embedding has the identifier.</returns>
+	bool Remove(int64_t id);
+
+	/// <summary>
+	/// Remove every embedding and forget the dimension.
+	/// </summary>
+	void Clear();
+
+	int Size() const;
+	int Dimension() const;
+
+	/// <summary>
+	/// Find the embeddings most similar to a query.
+	/// </summary>
+	/// <param name="query">The query, already normalized.</param>
+	/// <param name="dimension">Number of elements in the query.</param>
+	/// <param name="k">Most matches to return.</param>
+	/// <param name="matches">Receives up to k matches by descending similarity.</param>
+	/// <returns>Number of matches written; 0 if the dimension differs from the gallery's.</returns>
+	int Search(const float* query, int dimension, int k, GalleryMatch* matches) const;
+
+private:
+	/// <summary>
+	/// Search rows [first, last) for the k best matches, leaving them in best as a min-heap on similarity.
+	/// </summary>
+	void searchRows(const float* query, size_t first, size_t last, size_t k, std::vector<GalleryMatch>& best) const;
+
+	mutable std::shared_timed_mutex mutex;
+	int dimension = 0;                // Elements per embedding, or 0 before the first is added
+	size_t stride = 0;                // Floats per row: the dimension rounded up to a cache line
+	std::vector<float> rows;          // Normalized embeddings, zero-padded to the stride
+	std::vector<int64_t> ids;         // Identifier of each row
+	std::unordered_map<int64_t, size_t> row_of_id;
+};
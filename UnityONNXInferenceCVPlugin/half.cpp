@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "half.h"
+#include "cpu_features.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define HALF_USE_F16C
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define HALF_USE_NEON
+#endif
+
+namespace {
+	/// <summary>
+	/// Convert one half-precision value, including subnormals, infinities and NaNs.
+	/// </summary>
+	float halfToFloatScalar(uint16_t h) {
+		uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1F;
+		uint32_t mantissa = h & 0x3FF;
+		uint32_t bits;
+
+		if (exponent == 0) {
+			if (mantissa == 0) {
+				bits = sign;
+			}
+			else {
+				// Normalize the subnormal value
+				exponent = 127 - 15 + 1;
+				while (!(mantissa & 0x400)) {
+					mantissa <<= 1;
+					exponent--;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+			}
+		}
+		else if (exponent == 31) {
+			bits = sign | 0x7F800000 | (mantissa << 13);
+		}
+		else {
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	/// <summary>
+	/// Convert one single-precision value with round-to-nearest-even.
+	/// </summary>
+	uint16_t floatToHalfScalar(float value) {
+		const uint32_t f32_infinity = 255u << 23;
+		const uint32_t f16_max = (127u + 16u) << 23;
+		const uint32_t denorm_magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		uint16_t result;
+		if (bits >= f16_max) {
+			// Overflow to infinity, or keep NaN
+			result = (bits > f32_infinity) ? 0x7E00 : 0x7C00;
+		}
+		else if (bits < (113u << 23)) {
+			// Subnormal or zero: let float addition do the rounding
+			float magnitude, denorm_magic;
+			std::memcpy(&magnitude, &bits, sizeof(magnitude));
+			std::memcpy(&denorm_magic, &denorm_magic_bits, sizeof(denorm_magic));
+			magnitude += denorm_magic;
+			std::memcpy(&bits, &magnitude, sizeof(bits));
+			result = static_cast<uint16_t>(bits - denorm_magic_bits);
+		}
+		else {
+			// Rebias the exponent and round the mantissa to nearest even
+			uint32_t mantissa_odd = (bits >> 13) & 1;
+			bits += ((15u - 127u) << 23) + 0xFFF;
+			bits += mantissa_odd;
+			result = static_cast<uint16_t>(bits >> 13);
+		}
+		return static_cast<uint16_t>(result | (sign >> 16));
+	}
+}
+
+void halfToFloat(const uint16_t* src, float* dst, size_t count) {
+	size_t i = 0;
+#if defined(HALF_USE_F16C)
+	if (cpuHasF16c()) {
+		for (; i + 8 <= count; i += 8) {
+			__m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+		}
+	}
+#elif defined(HALF_USE_NEON)
+	for (; i + 4 <= count; i += 4) {
+		float16x4_t half = vreinterpret_f16_u16(vld1_u16(src + i));
+		vst1q_f32(dst + i, vcvt_f32_f16(half));
+	}
+#endif
+	for (; i < count; i++) dst[i] = halfToFloatScalar(src[i]);
+}
+
+void floatToHalf(const float* src, uint16_t* dst, size_t count) {
+	size_t i = 0;
+#if defined(HALF_USE_F16C)
+	if (cpuHasF16c()) {
+		for (; i + 8 <= count; i += 8) {
+			__m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+		}
+	}
+#elif defined(HALF_USE_NEON)
+	for (; i + 4 <= count; i += 4) {
+		float16x4_t half = vcvt_f16_f32(vld1q_f32(src + i));
+		vst1_u16(dst + i, vreinterpret_u16_f16(half));
+	}
+#endif
+	for (; i < count; i++) dst[i] = floatToHalfScalar(src[i]);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Convert IEEE half-precision values to single precision, using F16C on x86/x64 CPUs that support it
+/// and NEON on ARM64.
+/// </summary>
+/// <param name="src">Half-precision values as raw 16-bit patterns.</param>
+/// <param name="dst">Receives count floats.</param>
+/// <param name="count">Number of values to convert.</param>
+void halfToFloat(const uint16_t* src, float* dst, size_t count);
+
+/// <summary>
+/// Convert single-precision values to IEEE half precision with round-to-nearest-even.
+/// </summary>
+/// <param name="src">Values to convert.</param>
+/// <param name="dst">Receives count half-precision values as raw 16-bit patterns.</param>
+/// <param name="count">Number of values to convert.</param>
+void floatToHalf(const float* src, uint16_t* dst, size_t count);
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace xxh64_detail {
+	const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t prime3 = 0x165667B19E3779F9ULL;
+	const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t rotl(uint64_t x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t read64(const uint8_t* p) {
+		uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t read32(const uint8_t* p) {
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t round(uint64_t acc, uint64_t input) {
+		acc += input * prime2;
+		acc = rotl(acc, 31);
+		return acc * prime1;
+	}
+
+	inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+		acc ^= round(0, value);
+		return acc * prime1 + prime4;
+	}
+}
+
+/// <summary>
+/// Hash a block of memory with XXH64, which processes 32 bytes per step and runs near memory bandwidth.
+/// </summary>
+/// <param name="data">The bytes to hash.</param>
+/// <param name="size">Number of bytes.</param>
+/// <param name="seed">Optional seed, e.g., to separate keys for different models.</param>
+/// <returns>The 64-bit hash.</returns>
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) {
+	using namespace xxh64_detail;
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		// Four independent lanes keep the multiplier pipelines busy
+		uint64_t v1 = seed + prime1 + prime2;
+		uint64_t v2 = seed + prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - prime1;
+		const uint8_t* limit = end - 32;
+		do {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else {
+		h = seed + prime5;
+	}
+
+	h += static_cast<uint64_t>(size);
+
+	// Consume the remaining tail
+	for (; p + 8 <= end; p += 8) {
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * prime1 + prime4;
+	}
+	if (p + 4 <= end) {
+		h ^= static_cast<uint64_t>(read32(p)) * prime1;
+		h = rotl(h, 23) * prime2 + prime3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (*p) * prime5;
+		h = rotl(h, 11) * prime1;
+	}
+
+	// Final avalanche
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+namespace xxh32_detail {
+	const uint32_t prime1 = 0x9E3779B1U;
+	const uint32_t prime2 = 0x85EBCA77U;
+	const uint32_t prime3 = 0xC2B2AE3DU;
+	const uint32_t prime4 = 0x27D4EB2FU;
+	const uint32_t prime5 = 0x165667B1U;
+
+	inline uint32_t rotl(uint32_t x, int r) {
+		return (x << r) | (x >> (32 - r));
+	}
+
+	inline uint32_t round(uint32_t acc, uint32_t input) {
+		acc += input * prime2;
+		acc = rotl(acc, 13);
+		return acc * prime1;
+	}
+}
+
+/// <summary>
+/// Hash a block of memory with XXH32, the checksum used by the LZ4 frame format.
+/// </summary>
+/// <param name="data">The bytes to hash.</param>
+/// <param name="size">Number of bytes.</param>
+/// <param name="seed">Optional seed.</param>
+/// <returns>The 32-bit hash.</returns>
+inline uint32_t hashBytes32(const void* data, size_t size, uint32_t seed = 0) {
+	using namespace xxh32_detail;
+	using xxh64_detail::read32;
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+	uint32_t h;
+
+	if (size >= 16) {
+		uint32_t v1 = seed + prime1 + prime2;
+		uint32_t v2 = seed + prime2;
+		uint32_t v3 = seed;
+		uint32_t v4 = seed - prime1;
+		const uint8_t* limit = end - 16;
+		do {
+			v1 = round(v1, read32(p));
+			v2 = round(v2, read32(p + 4));
+			v3 = round(v3, read32(p + 8));
+			v4 = round(v4, read32(p + 12));
+			p += 16;
+		} while (p <= limit);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+	}
+	else {
+		h = seed + prime5;
+	}
+
+	h += static_cast<uint32_t>(size);
+
+	// Consume the remaining tail
+	for (; p + 4 <= end; p += 4) {
+		h += read32(p) * prime3;
+		h = rotl(h, 17) * prime4;
+	}
+	for (; p < end; p++) {
+		h += (*p) * prime5;
+		h = rotl(h, 11) * prime1;
+	}
+
+	// Final avalanche
+	h ^= h >> 15;
+	h *= prime2;
+	h ^= h >> 13;
+	h *= prime3;
+	h ^= h >> 16;
+	return h;
+}
@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "plugin.h"
+#include "capture.h"
+#include "hot_reload.h"
+#include "result_cache.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+	std::mutex reload_mutex;                  // Serializes reloads
+	std::mutex status_mutex;                  // Guards the fields below
+	int reload_status = 1;                    // 1 succeeded or never started, 0 running, -1 failed
+	std::string reload_message;               // Message of the most recent background reload
+	ReloadStats reload_stats = {};
+
+	/// <summary>
+	/// Build a model at the loaded model's image dimensions and swap it in. The old model is released by
+	/// whichever call on it returns last, which records the drain time, so the reload never waits for
+	/// long-running holders such as ProcessImageDirectory.
+	/// </summary>
+	/// <param name="message">Holds exception messages for the returned pointer.</param>
+	/// <returns>A message indicating the success or failure of the reload.</returns>
+	const char* reloadModel(const char* model_path, const char* execution_provider, const char* options, std::string& message) {
+		std::lock_guard<std::mutex> lock(reload_mutex);
+		try {
+			// Only the dimensions are kept; holding the model itself would keep it alive after the swap
+			std::shared_ptr<LoadedModel> current_model = std::atomic_load(&loaded_model);
+			if (!current_model) return "No model is loaded.";
+			int width = current_model->input_w;
+			int height = current_model->input_h;
+			current_model.reset();
+			LoadOptions load_options = parseLoadOptions(options);
+
+			// Build the new sessions while inference continues on the old ones
+			auto build_start = std::chrono::steady_clock::now();
+			std::shared_ptr<LoadedModel> new_model;
+			const char* error = buildModel(model_path, execution_provider, load_options, width, height, new_model);
+			if (error) return error;
+			auto swap_start = std::chrono::steady_clock::now();
+
+			// Calls that start after this line run on the new model
+			std::shared_ptr<LoadedModel> old_model = publishModel(std::move(new_model));
+			auto swap_end = std::chrono::steady_clock::now();
+			int in_flight = static_cast<int>(old_model.use_count()) - 1;
+
+			result_cache.Clear();
+			captureLoad(model_path, execution_provider, width, height, options);
+
+			int reload_number;
+			{
+				std::lock_guard<std::mutex> status_lock(status_mutex);
+				reload_number = ++reload_stats.reloads;
+				reload_stats.build_ms = std::chrono::duration<double, std::milli>(swap_start - build_start).count();
+				reload_stats.swap_us = std::chrono::duration<double, std::micro>(swap_end - swap_start).count();
+				reload_stats.drain_ms = -1.0;
+				reload_stats.in_flight_at_swap = in_flight;
+			}
+
+			// Set while this reference keeps it from running; the last holder runs it once the sessions are released
+			old_model->on_released.callback = [reload_number, swap_end]() {
+				double drain_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - swap_end).count();
+				std::lock_guard<std::mutex> status_lock(status_mutex);
+				if (reload_stats.reloads == reload_number) reload_stats.drain_ms = drain_ms;
+			};
+			old_model.reset();
+			return "Model reloaded successfully.";
+		}
+		catch (const std::exception& e) {
+			message = e.what();
+			return message.c_str();
+		}
+		catch (...) {
+			return "An unknown error occurred while reloading the model.";
+		}
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Replace the loaded model without interrupting inference. The new model is built while PerformInference
+	/// keeps running on the old one, then swapped in between calls; calls already running finish on the old model.
+	/// The new model keeps the loaded model's image dimensions and may differ in input and output types.
+	/// </summary>
+	/// <param name="model_path">Path to the new ONNX model file.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="options">Load options for the new model, as for LoadModelWithOptions.</param>
+	/// <returns>A message indicating the success or failure of the reload. On failure the old model stays loaded.</returns>
+	DLLExport const char* ReloadModel(const char* model_path, const char* execution_provider, const char* options) {
+		// Holds exception messages after the exception itself is destroyed
+		static std::string error_message;
+		return reloadModel(model_path, execution_provider, options, error_message);
+	}
+
+	/// <summary>
+	/// Start ReloadModel on a background thread. Poll GetReloadStatus for the outcome.
+	/// </summary>
+	/// <param name="model_path">Path to the new ONNX model file.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="options">Load options for the new model, as for LoadModelWithOptions.</param>
+	/// <returns>1 if the reload was started, 0 if a background reload is already running.</returns>
+	DLLExport int BeginReloadModel(const char* model_path, const char* execution_provider, const char* options) {
+		{
+			std::lock_guard<std::mutex> lock(status_mutex);
+			if (reload_status == 0) return 0;
+			reload_status = 0;
+		}
+
+		std::thread([path = std::string(model_path), provider = std::string(execution_provider), option_string = std::string(options)]() {
+			std::string exception_message;
+			std::string message = reloadModel(path.c_str(), provider.c_str(), option_string.c_str(), exception_message);
+
+			std::lock_guard<std::mutex> lock(status_mutex);
+			reload_message = message;
+			reload_status = (message == "Model reloaded successfully.") ? 1 : -1;
+		}).detach();
+		return 1;
+	}
+
+	/// <summary>
+	/// Get the state of the most recent BeginReloadModel. Wait for it to finish before calling FreeResources.
+	/// </summary>
+	/// <returns>0 while the reload is running, 1 if it succeeded or none was started, -1 if it failed.</returns>
+	DLLExport int GetReloadStatus() {
+		std::lock_guard<std::mutex> lock(status_mutex);
+		return reload_status;
+	}
+
+	/// <summary>
+	/// Get the message of the most recent background reload.
+	/// </summary>
+	/// <returns>The message, valid until the next background reload finishes.</returns>
+	DLLExport const char* GetReloadMessage() {
+		std::lock_guard<std::mutex> lock(status_mutex);
+		return reload_message.c_str();
+	}
+
+	/// <summary>
+	/// Get the timings of the most recent successful reload.
+	/// </summary>
+	/// <param name="stats">Receives the reload statistics.</param>
+	/// <returns></returns>
+	DLLExport void GetReloadStats(ReloadStats* stats) {
+		std::lock_guard<std::mutex> lock(status_mutex);
+		*stats = reload_stats;
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/// <summary>
+/// Timings of the most recent successful ReloadModel.
+/// </summary>
+struct ReloadStats {
+	int reloads;                      // Successful reloads since the plugin was loaded
+	double build_ms;                  // Time to create the new sessions and request contexts, off the inference path
+	double swap_us;                   // Time to publish the new model; the only step inference calls can observe
+	double drain_ms;                  // Time from the swap until the last call on the old model returned and released it, or -1 while calls are still running
+	int in_flight_at_swap;            // Calls still running on the old model when it was replaced
+};
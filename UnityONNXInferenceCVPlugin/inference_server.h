@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+// Protocol shared by the plugin's inference server client and UnityONNXInferenceServer.
+//
+// A client connects to the server's AF_UNIX stream socket and receives a ServerInfo describing a
+// shared-memory section created for that client. The section holds slot_count slots, each with room
+// for one input image followed by one output array. To run a frame, the client writes the image into
+// a free slot, sends a Submit message naming the slot, and waits for the matching Done message, after
+// which the slot's output area holds the result. Frames and outputs never pass through the socket.
+const uint32_t server_protocol_version = 1;
+const char default_server_socket_name[] = "UnityONNXInferenceServer.sock"; // Created in the user's temp directory
+
+enum class ServerMessageType : uint32_t {
+	Submit = 1,                       // Client to server: run the frame in a slot
+	Done = 2                          // Server to client: the slot's output is ready
+};
+
+/// <summary>
+/// A control message sent over the socket.
+/// </summary>
+struct ServerMessage {
+	ServerMessageType type;
+	uint32_t slot;                    // Slot the message refers to
+	int32_t length;                   // Submit: number of output floats to write
+	int32_t status;                   // Done: 1 on success, 0 if the request was invalid
+	uint64_t server_ns;               // Done: time the server spent running the frame
+};
+
+/// <summary>
+/// Sent by the server when a client connects.
+/// </summary>
+struct ServerInfo {
+	uint32_t version;                 // server_protocol_version
+	int32_t image_dims[2];            // Image dimensions the server's model was loaded with
+	uint32_t slot_count;              // Number of slots in the shared-memory section
+	uint64_t image_bytes;             // Size of each slot's image area
+	uint64_t output_floats;           // Capacity of each slot's output area
+	char mapping_name[64];            // Name of the shared-memory section to open
+};
+
+/// <summary>
+/// Round a size up to a whole number of 64-byte cache lines.
+/// </summary>
+inline uint64_t alignToCacheLine(uint64_t bytes) {
+	return (bytes + 63) & ~static_cast<uint64_t>(63);
+}
+
+/// <summary>
+/// Distance between consecutive slots, keeping every area cache-line aligned.
+/// </summary>
+inline uint64_t serverSlotStride(const ServerInfo& info) {
+	return alignToCacheLine(alignToCacheLine(info.image_bytes) + info.output_floats * sizeof(float));
+}
+
+/// <summary>
+/// Offset of a slot's image area from the start of the section.
+/// </summary>
+inline uint64_t serverSlotImageOffset(const ServerInfo& info, uint32_t slot) {
+	return slot * serverSlotStride(info);
+}
+
+/// <summary>
+/// Offset of a slot's output area from the start of the section.
+/// </summary>
+inline uint64_t serverSlotOutputOffset(const ServerInfo& info, uint32_t slot) {
+	return serverSlotImageOffset(info, slot) + alignToCacheLine(info.image_bytes);
+}
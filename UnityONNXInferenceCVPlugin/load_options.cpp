@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "load_options.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+	/// <summary>
+	/// Parse an integer option value no smaller than a minimum.
+	/// </summary>
+	int parseInt(const std::string& key, const std::string& value, int minimum) {
+		size_t parsed = 0;
+		int result = 0;
+		try {
+			result = std::stoi(value, &parsed);
+		}
+		catch (const std::exception&) {
+			parsed = 0;
+		}
+		if (value.empty() || parsed != value.size() || result < minimum) {
+			throw std::invalid_argument("Invalid value for load option '" + key + "': " + value);
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Parse a boolean option value ("1"/"0" or "true"/"false").
+	/// </summary>
+	bool parseBool(const std::string& key, const std::string& value) {
+		if (value == "1" || value == "true") return true;
+		if (value == "0" || value == "false") return false;
+		throw std::invalid_argument("Invalid value for load option '" + key + "': " + value);
+	}
+
+	/// <summary>
+	/// Parse a list of zero-based logical processor indices and ranges, e.g., "0-3,8,10-11".
+	/// </summary>
+	std::vector<int> parseCpuList(const std::string& key, const std::string& value) {
+		std::vector<int> cpus;
+		std::stringstream stream(value);
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			size_t dash = item.find('-');
+			int first = parseInt(key, item.substr(0, dash), 0);
+			int last = (dash == std::string::npos) ? first : parseInt(key, item.substr(dash + 1), 0);
+			if (last < first) throw std::invalid_argument("Invalid processor range for load option '" + key + "': " + item);
+			for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+		}
+		if (cpus.empty()) throw std::invalid_argument("Load option '" + key + "' lists no processors.");
+		return cpus;
+	}
+}
+
+LoadOptions parseLoadOptions(const char* options) {
+	LoadOptions result;
+	if (!options) return result;
+
+	std::stringstream stream(options);
+	std::string pair;
+	while (std::getline(stream, pair, ';')) {
+		if (pair.empty()) continue;
+
+		size_t separator = pair.find('=');
+		if (separator == std::string::npos) {
+			throw std::invalid_argument("Load option is missing a value: " + pair);
+		}
+		std::string key = pair.substr(0, separator);
+		std::string value = pair.substr(separator + 1);
+
+		if (key == "pool_size") {
+			result.pool_size = parseInt(key, value, 1);
+		}
+		else if (key == "denormals_as_zero") {
+			result.denormals_as_zero = parseBool(key, value);
+		}
+		else if (key == "intra_op_cpus") {
+			result.intra_op_cpus = parseCpuList(key, value);
+		}
+		else if (key == "worker_cpus") {
+			result.worker_cpus = parseCpuList(key, value);
+		}
+		else if (key == "numa_node") {
+			result.numa_node = parseInt(key, value, 0);
+		}
+		else if (key == "numa_replicas") {
+			result.numa_replicas = parseBool(key, value);
+		}
+		else if (key == "map_external_data") {
+			result.map_external_data = parseBool(key, value);
+		}
+		else {
+			throw std::invalid_argument("Unknown load option: " + key);
+		}
+	}
+
+	if (result.numa_node >= 0 && result.numa_replicas) {
+		throw std::invalid_argument("Load options 'numa_node' and 'numa_replicas' cannot be combined.");
+	}
+	return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Load-time settings passed to LoadModelWithOptions as "key=value" pairs separated by semicolons.
+/// </summary>
+struct LoadOptions {
+	int pool_size = 2;                // pool_size: number of preallocated request contexts (maximum concurrent PerformInference calls)
+	bool denormals_as_zero = false;   // denormals_as_zero: flush denormals to zero on ONNX Runtime's threads and the plugin's calling threads
+	std::vector<int> intra_op_cpus;   // intra_op_cpus: logical processors for ONNX Runtime's intra-op threads, one thread pinned to each (e.g., "0-3,8")
+	std::vector<int> worker_cpus;     // worker_cpus: logical processors the plugin's own worker threads may run on
+	int numa_node = -1;               // numa_node: NUMA node to bind the session's threads and buffers to, or -1 for no binding
+	bool numa_replicas = false;       // numa_replicas: create one session per NUMA node and route each call to its caller's node
+	bool map_external_data = true;    // map_external_data: serve initializers stored in external data files from read-only memory mappings
+};
+
+/// <summary>
+/// Parse a load options string, e.g., "pool_size=4;denormals_as_zero=1".
+/// </summary>
+/// <param name="options">The options string. Null or empty selects the defaults.</param>
+/// <returns>The parsed options. Throws std::invalid_argument for unknown keys or malformed values.</returns>
+LoadOptions parseLoadOptions(const char* options);
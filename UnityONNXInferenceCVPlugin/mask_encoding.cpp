@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "plugin.h"
+#include "mask_encoding.h"
+#include "segmentation.h"
+#include <intrin.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	/// <summary>
+	/// Append a LEB128 varint.
+	/// </summary>
+	void writeVarint(uint64_t value, std::vector<uint8_t>& out) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	/// <summary>
+	/// Read a LEB128 varint.
+	/// </summary>
+	/// <returns>False if the data ends inside the varint or it does not fit 64 bits.</returns>
+	bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64 && data < end; shift += 7) {
+			uint8_t byte = *data++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	/// <summary>
+	/// Find the first pixel at or after x whose bit differs from value, scanning 32 pixels at a time.
+	/// </summary>
+	/// <returns>The pixel's column, or width if the rest of the row matches value.</returns>
+	int nextChange(const uint8_t* row, int row_bytes, int width, int x, bool value) {
+		uint32_t invert = value ? 0xFFFFFFFFu : 0u;
+		for (int byte = x / 8; byte < row_bytes; byte += 4) {
+			uint32_t word = 0;
+			int available = row_bytes - byte;
+			if (available >= 4) {
+				std::memcpy(&word, row + byte, 4);
+				word ^= invert;
+			}
+			else {
+				std::memcpy(&word, row + byte, available);
+				word = (word ^ invert) & ((1u << (available * 8)) - 1);
+			}
+
+			// Ignore the pixels before x in the first word
+			int first = byte * 8;
+			if (first < x) word &= ~0u << (x - first);
+
+			unsigned long bit;
+			if (_BitScanForward(&bit, word)) return std::min(first + static_cast<int>(bit), width);
+		}
+		return width;
+	}
+}
+
+size_t encodeMaskRle(const uint8_t* bits, int width, int height, int row_bytes, std::vector<uint8_t>& encoded) {
+	size_t start = encoded.size();
+	bool value = false;
+	uint64_t run = 0;
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = bits + static_cast<size_t>(y) * row_bytes;
+		int x = 0;
+		while (x < width) {
+			int next = nextChange(row, row_bytes, width, x, value);
+			run += next - x;
+			x = next;
+			if (x < width) {
+				writeVarint(run, encoded);
+				run = 0;
+				value = !value;
+			}
+		}
+	}
+	writeVarint(run, encoded);
+	return encoded.size() - start;
+}
+
+void decodeMaskBits(const uint8_t* bits, int width, int height, int row_bytes, uint8_t* pixels, ptrdiff_t pixel_stride, uint8_t value) {
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = bits + static_cast<size_t>(y) * row_bytes;
+		uint8_t* out = pixels + y * pixel_stride;
+		for (int x = 0; x < width; x += 8) {
+			uint8_t byte = row[x / 8];
+			if (byte == 0) continue;
+
+			// Fill a stretch of fully set bytes with one memset
+			if (byte == 0xFF) {
+				int end = x + 8;
+				while (end < width && row[end / 8] == 0xFF) end += 8;
+				std::memset(out + x, value, std::min(end, width) - x);
+				x = end - 8;
+				continue;
+			}
+			int count = std::min(8, width - x);
+			for (int bit = 0; bit < count; bit++) {
+				if (byte & (1 << bit)) out[x + bit] = value;
+			}
+		}
+	}
+}
+
+bool decodeMaskRle(const uint8_t* encoded, size_t size, int width, int height, uint8_t* pixels, ptrdiff_t pixel_stride, uint8_t value) {
+	const uint8_t* end = encoded + size;
+	uint64_t total = static_cast<uint64_t>(width) * height;
+	uint64_t position = 0;
+	bool set = false;
+	while (encoded < end) {
+		uint64_t run;
+		if (!readVarint(encoded, end, run) || run > total - position) return false;
+
+		// Set runs may span several rows
+		if (set && width > 0) {
+			uint64_t remaining = run;
+			int y = static_cast<int>(position / width);
+			int x = static_cast<int>(position % width);
+			while (remaining > 0) {
+				int count = static_cast<int>(std::min<uint64_t>(remaining, width - x));
+				std::memset(pixels + y * pixel_stride + x, value, count);
+				remaining -= count;
+				x = 0;
+				y++;
+			}
+		}
+		position += run;
+		set = !set;
+	}
+	return position == total;
+}
+
+extern "C" {
+	/// <summary>
+	/// Paint one mask returned by PerformInferenceInstanceMasks into a byte image of the input's size, e.g., an R8
+	/// texture or a label map shared by every instance. Pixels outside the mask are left untouched.
+	/// </summary>
+	/// <param name="mask">The mask's entry.</param>
+	/// <param name="mask_data">The mask buffer passed to PerformInferenceInstanceMasks.</param>
+	/// <param name="encoding">The MaskEncoding the mask was produced with.</param>
+	/// <param name="image">Image of image_width x image_height bytes.</param>
+	/// <param name="image_width">Width of the image, that of the model input.</param>
+	/// <param name="image_height">Height of the image.</param>
+	/// <param name="value">Value written for the mask's pixels, e.g., 255 or a label.</param>
+	/// <param name="flip_rows">1 to write the image bottom row first, as Unity textures expect.</param>
+	/// <returns>1 on success, 0 if the mask lies outside the image, the encoding is unknown, or the run lengths are corrupt.</returns>
+	DLLExport int DecodeInstanceMask(const InstanceMask* mask, const uint8_t* mask_data, int encoding, uint8_t* image, int image_width, int image_height, uint8_t value, int flip_rows) {
+		if (mask->x < 0 || mask->y < 0 || mask->x + mask->width > image_width || mask->y + mask->height > image_height) return 0;
+
+		// Flipped images are written from the mask's top row upwards
+		ptrdiff_t stride = flip_rows ? -static_cast<ptrdiff_t>(image_width) : image_width;
+		int first_row = flip_rows ? image_height - 1 - mask->y : mask->y;
+		uint8_t* pixels = image + static_cast<ptrdiff_t>(first_row) * image_width + mask->x;
+
+		const uint8_t* data = mask_data + mask->offset;
+		switch (static_cast<MaskEncoding>(encoding)) {
+		case MaskEncoding::Bits:
+			decodeMaskBits(data, mask->width, mask->height, mask->row_bytes, pixels, stride, value);
+			return 1;
+		case MaskEncoding::Rle:
+			return decodeMaskRle(data, mask->size, mask->width, mask->height, pixels, stride, value) ? 1 : 0;
+		default:
+			return 0;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Run-length encoded masks cover the mask's pixels in row-major order, continuing from one row to the next.
+// They hold the lengths of alternating runs of unset and set pixels, starting with unset (so the first run may
+// be empty) and summing to width x height. Each length is a LEB128 varint: seven bits per byte, lowest bits
+// first, with the high bit set on every byte but the last.
+
+/// <summary>
+/// Binary mask encodings of PerformInferenceInstanceMasks.
+/// </summary>
+enum class MaskEncoding : int {
+	Bits = 0,                         // Bit-packed rows: one bit per pixel, least significant bit first, rows padded to a byte
+	Rle = 1                           // Varint run lengths
+};
+
+/// <summary>
+/// Run-length encode a bit-packed mask.
+/// </summary>
+/// <param name="bits">The mask: height rows of row_bytes bytes, with the padding bits of each row clear.</param>
+/// <param name="width">Width of the mask in pixels.</param>
+/// <param name="height">Height of the mask in pixels.</param>
+/// <param name="row_bytes">Bytes per row.</param>
+/// <param name="encoded">The encoding is appended to it.</param>
+/// <returns>Number of bytes appended.</returns>
+size_t encodeMaskRle(const uint8_t* bits, int width, int height, int row_bytes, std::vector<uint8_t>& encoded);
+
+/// <summary>
+/// Paint the set pixels of a bit-packed mask into a byte image, leaving the other pixels untouched.
+/// </summary>
+/// <param name="bits">The mask: height rows of row_bytes bytes.</param>
+/// <param name="width">Width of the mask in pixels.</param>
+/// <param name="height">Height of the mask in pixels.</param>
+/// <param name="row_bytes">Bytes per row.</param>
+/// <param name="pixels">Destination of the mask's first pixel.</param>
+/// <param name="pixel_stride">Distance in bytes between destination rows; negative to write the rows bottom to top.</param>
+/// <param name="value">Value written for set pixels.</param>
+void decodeMaskBits(const uint8_t* bits, int width, int height, int row_bytes, uint8_t* pixels, ptrdiff_t pixel_stride, uint8_t value);
+
+/// <summary>
+/// Paint the set pixels of a run-length encoded mask into a byte image, leaving the other pixels untouched.
+/// </summary>
+/// <param name="encoded">The encoded mask.</param>
+/// <param name="size">Bytes in the encoding.</param>
+/// <param name="width">Width of the mask in pixels.</param>
+/// <param name="height">Height of the mask in pixels.</param>
+/// <param name="pixels">Destination of the mask's first pixel.</param>
+/// <param name="pixel_stride">Distance in bytes between destination rows; negative to write the rows bottom to top.</param>
+/// <param name="value">Value written for set pixels.</param>
+/// <returns>False if the encoding is truncated or its runs do not cover the mask exactly; pixels may be partly written.</returns>
+bool decodeMaskRle(const uint8_t* encoded, size_t size, int width, int height, uint8_t* pixels, ptrdiff_t pixel_stride, uint8_t value);
@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "model_file.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+	const uint32_t lz4_magic = 0x184D2204;
+	const uint32_t lz4_skippable_magic = 0x184D2A50;  // Low four bits are free
+	const uint32_t zstd_magic = 0xFD2FB528;
+
+	uint32_t readLe32(const uint8_t* p) {
+		return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	/// <summary>
+	/// Read exactly size bytes from the file.
+	/// </summary>
+	void readExact(std::ifstream& file, void* buffer, size_t size) {
+		file.read(static_cast<char*>(buffer), static_cast<std::streamsize>(size));
+		if (static_cast<size_t>(file.gcount()) != size) throw std::runtime_error("Compressed model file is truncated.");
+	}
+
+	/// <summary>
+	/// Decode one LZ4 block to output + output_size. Matches may reach back into earlier blocks of the
+	/// same frame, which start at frame_start.
+	/// </summary>
+	/// <returns>The output size after the block.</returns>
+	size_t decodeLz4Block(const uint8_t* block, size_t block_size, uint8_t* output, size_t frame_start, size_t output_size, size_t output_capacity) {
+		const uint8_t* ip = block;
+		const uint8_t* const input_end = block + block_size;
+		uint8_t* op = output + output_size;
+		uint8_t* const output_end = output + output_capacity;
+		const uint8_t* const window = output + frame_start;
+		const char* corrupt = "Compressed model file is corrupt.";
+
+		while (true) {
+			if (ip >= input_end) throw std::runtime_error(corrupt);
+			unsigned token = *ip++;
+
+			// Literals
+			size_t literal_length = token >> 4;
+			if (literal_length == 15) {
+				uint8_t extra;
+				do {
+					if (ip >= input_end) throw std::runtime_error(corrupt);
+					extra = *ip++;
+					literal_length += extra;
+				} while (extra == 255);
+			}
+			if (literal_length > static_cast<size_t>(input_end - ip) || literal_length > static_cast<size_t>(output_end - op)) {
+				throw std::runtime_error(corrupt);
+			}
+			std::memcpy(op, ip, literal_length);
+			ip += literal_length;
+			op += literal_length;
+
+			// The last sequence of a block has literals only
+			if (ip == input_end) break;
+
+			// Match
+			if (input_end - ip < 2) throw std::runtime_error(corrupt);
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > static_cast<size_t>(op - window)) throw std::runtime_error(corrupt);
+
+			size_t match_length = token & 15;
+			if (match_length == 15) {
+				uint8_t extra;
+				do {
+					if (ip >= input_end) throw std::runtime_error(corrupt);
+					extra = *ip++;
+					match_length += extra;
+				} while (extra == 255);
+			}
+			match_length += 4;
+			if (match_length > static_cast<size_t>(output_end - op)) throw std::runtime_error(corrupt);
+
+			// Overlapping matches repeat the last offset bytes; copy in chunks that double each step
+			const uint8_t* match = op - offset;
+			while (match_length > 0) {
+				size_t chunk = std::min(static_cast<size_t>(op - match), match_length);
+				std::memcpy(op, match, chunk);
+				op += chunk;
+				match_length -= chunk;
+			}
+		}
+		return op - output;
+	}
+
+	/// <summary>
+	/// Make room for block_max more bytes, growing geometrically when the content size is unknown.
+	/// </summary>
+	void reserveOutput(std::vector<uint8_t>& output, size_t output_size, size_t block_max) {
+		if (output.size() - output_size >= block_max) return;
+		output.resize(std::max(output_size + block_max, output.size() + output.size() / 2));
+	}
+}
+
+ModelCompression detectModelCompression(const char* model_path) {
+	std::ifstream file(model_path, std::ios::binary);
+	uint8_t magic[4];
+	if (!file.read(reinterpret_cast<char*>(magic), sizeof(magic))) return ModelCompression::None;
+
+	uint32_t value = readLe32(magic);
+	if (value == lz4_magic || (value & 0xFFFFFFF0) == lz4_skippable_magic) return ModelCompression::Lz4;
+	if (value == zstd_magic) return ModelCompression::Zstd;
+	return ModelCompression::None;
+}
+
+std::vector<uint8_t> decompressLz4File(const char* model_path) {
+	std::ifstream file(model_path, std::ios::binary);
+	if (!file) throw std::runtime_error("Unable to open the compressed model file.");
+
+	std::vector<uint8_t> output;
+	std::vector<uint8_t> block;
+	size_t output_size = 0;
+	uint8_t magic[4];
+
+	// A file may hold several concatenated frames
+	while (file.read(reinterpret_cast<char*>(magic), sizeof(magic))) {
+		uint32_t frame_magic = readLe32(magic);
+		if ((frame_magic & 0xFFFFFFF0) == lz4_skippable_magic) {
+			uint8_t size[4];
+			readExact(file, size, sizeof(size));
+			file.seekg(readLe32(size), std::ios::cur);
+			continue;
+		}
+		if (frame_magic != lz4_magic) throw std::runtime_error("Compressed model file is not an LZ4 frame.");
+
+		// Frame descriptor: flags, block size, optional content size and dictionary ID, header checksum
+		uint8_t descriptor[10];
+		readExact(file, descriptor, 2);
+		uint8_t flags = descriptor[0];
+		if ((flags >> 6) != 1) throw std::runtime_error("Unsupported LZ4 frame version.");
+		if (flags & 0x01) throw std::runtime_error("LZ4 frames with dictionaries are not supported.");
+		bool block_checksums = (flags & 0x10) != 0;
+		bool has_content_size = (flags & 0x08) != 0;
+		bool content_checksum = (flags & 0x04) != 0;
+		int block_size_id = (descriptor[1] >> 4) & 0x7;
+		if (block_size_id < 4) throw std::runtime_error("Compressed model file is corrupt.");
+		size_t block_max = static_cast<size_t>(1) << (8 + 2 * block_size_id);
+
+		size_t descriptor_size = 2;
+		if (has_content_size) {
+			readExact(file, descriptor + 2, 8);
+			descriptor_size += 8;
+		}
+		uint8_t header_checksum;
+		readExact(file, &header_checksum, 1);
+		if (((hashBytes32(descriptor, descriptor_size) >> 8) & 0xFF) != header_checksum) {
+			throw std::runtime_error("Compressed model file is corrupt.");
+		}
+
+		// Allocate the whole model up front when its size is known; otherwise start from twice the file size
+		if (has_content_size) {
+			uint64_t content_size = 0;
+			for (int i = 7; i >= 0; i--) content_size = (content_size << 8) | descriptor[2 + i];
+			if (content_size > SIZE_MAX - output_size) throw std::runtime_error("Compressed model file is too large.");
+			output.resize(output_size + static_cast<size_t>(content_size));
+		}
+		else if (output.empty()) {
+			std::streampos position = file.tellg();
+			file.seekg(0, std::ios::end);
+			size_t file_size = static_cast<size_t>(file.tellg());
+			file.seekg(position);
+			output.resize(file_size * 2);
+		}
+		block.resize(block_max);
+
+		// Blocks, read and decoded one at a time
+		size_t frame_start = output_size;
+		while (true) {
+			uint8_t header[4];
+			readExact(file, header, sizeof(header));
+			uint32_t block_header = readLe32(header);
+			if (block_header == 0) break;
+
+			bool uncompressed = (block_header & 0x80000000) != 0;
+			size_t block_size = block_header & 0x7FFFFFFF;
+			if (block_size > block_max) throw std::runtime_error("Compressed model file is corrupt.");
+			if (!has_content_size) reserveOutput(output, output_size, block_max);
+
+			if (uncompressed) {
+				if (block_size > output.size() - output_size) throw std::runtime_error("Compressed model file is corrupt.");
+				readExact(file, output.data() + output_size, block_size);
+				if (block_checksums) {
+					uint8_t checksum[4];
+					readExact(file, checksum, sizeof(checksum));
+					if (hashBytes32(output.data() + output_size, block_size) != readLe32(checksum)) {
+						throw std::runtime_error("Compressed model file failed its checksum.");
+					}
+				}
+				output_size += block_size;
+				continue;
+			}
+
+			readExact(file, block.data(), block_size);
+			if (block_checksums) {
+				uint8_t checksum[4];
+				readExact(file, checksum, sizeof(checksum));
+				if (hashBytes32(block.data(), block_size) != readLe32(checksum)) {
+					throw std::runtime_error("Compressed model file failed its checksum.");
+				}
+			}
+			output_size = decodeLz4Block(block.data(), block_size, output.data(), frame_start, output_size, output.size());
+		}
+
+		if (content_checksum) {
+			uint8_t checksum[4];
+			readExact(file, checksum, sizeof(checksum));
+			if (hashBytes32(output.data() + frame_start, output_size - frame_start) != readLe32(checksum)) {
+				throw std::runtime_error("Compressed model file failed its checksum.");
+			}
+		}
+		if (has_content_size && output_size != output.size()) throw std::runtime_error("Compressed model file is corrupt.");
+	}
+
+	// Trim the spare space left by geometric growth; shrinking the allocation would copy the whole model
+	output.resize(output_size);
+	return output;
+}
+
+ModelSource openModel(const char* model_path, bool map_external_data) {
+	ModelSource source;
+	source.path = model_path;
+	switch (detectModelCompression(model_path)) {
+	case ModelCompression::Lz4:
+		source.bytes = decompressLz4File(model_path);
+		break;
+	case ModelCompression::Zstd:
+		throw std::runtime_error("Zstandard-compressed models are not supported. Compress the model with LZ4 instead.");
+	default:
+		break;
+	}
+	if (map_external_data) source.external_initializers = mapExternalInitializers(source.path, source.bytes);
+	return source;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "external_data.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Compression format of a model file, detected from its first bytes.
+/// </summary>
+enum class ModelCompression {
+	None,
+	Lz4,      // LZ4 frame format, as written by the lz4 command-line tool
+	Zstd      // Zstandard frame format (detected only, to report a clear error)
+};
+
+/// <summary>
+/// A model ready for session creation: a path ONNX Runtime reads itself, or the decompressed bytes of a
+/// compressed model file, plus any initializers served from memory-mapped external data files.
+/// </summary>
+struct ModelSource {
+	std::string path;
+	std::vector<uint8_t> bytes;       // Decompressed model, or empty to load from path
+	std::shared_ptr<ExternalInitializers> external_initializers; // Mapped external data, or null; must outlive the sessions
+};
+
+/// <summary>
+/// Detect whether a model file is compressed.
+/// </summary>
+/// <param name="model_path">Path to the model file.</param>
+/// <returns>The compression format, or None if the file is uncompressed or cannot be read.</returns>
+ModelCompression detectModelCompression(const char* model_path);
+
+/// <summary>
+/// Decompress an LZ4 frame file into one buffer. Compressed blocks are read and decoded one at a time,
+/// so only a single block of compressed data is held in memory. When the frame records the content size
+/// (lz4 --content-size), the output buffer is allocated once at its final size.
+/// </summary>
+/// <param name="model_path">Path to the compressed file.</param>
+/// <returns>The decompressed contents. Throws std::runtime_error if the file is unreadable or malformed.</returns>
+std::vector<uint8_t> decompressLz4File(const char* model_path);
+
+/// <summary>
+/// Prepare a model file for session creation, decompressing it into memory if it is compressed.
+/// </summary>
+/// <param name="model_path">Path to an ONNX model, or to an LZ4-compressed ONNX model.</param>
+/// <param name="map_external_data">True to memory-map the model's external data files instead of letting ONNX Runtime read them.</param>
+/// <returns>The model source. Throws std::runtime_error if a compressed file cannot be decompressed or an external data file cannot be mapped.</returns>
+ModelSource openModel(const char* model_path, bool map_external_data);
@@ -0,0 +1,64 @@
+#include "pch.h"
+#include "numa.h"
+#include <psapi.h>
+#include <cstdint>
+
+int numaNodeCount() {
+	ULONG highest_node = 0;
+	if (!GetNumaHighestNodeNumber(&highest_node)) return 1;
+	return static_cast<int>(highest_node) + 1;
+}
+
+std::vector<int> numaNodeCpus(int node) {
+	std::vector<int> cpus;
+	GROUP_AFFINITY affinity;
+	if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) return cpus;
+
+	for (int bit = 0; bit < 64; bit++) {
+		if (affinity.Mask & (static_cast<ULONG_PTR>(1) << bit)) cpus.push_back(affinity.Group * 64 + bit);
+	}
+	return cpus;
+}
+
+int currentNumaNode() {
+	PROCESSOR_NUMBER processor;
+	USHORT node = 0;
+	GetCurrentProcessorNumberEx(&processor);
+	if (!GetNumaProcessorNodeEx(&processor, &node)) return 0;
+	return node;
+}
+
+void* numaAlloc(size_t bytes, int node) {
+	if (node < 0) return ::operator new(bytes, std::nothrow);
+
+	// Pages are committed on the preferred node when first touched
+	return VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(node));
+}
+
+void numaFree(void* memory, int node) {
+	if (!memory) return;
+	if (node < 0) ::operator delete(memory);
+	else VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+void numaPagePlacement(const void* memory, size_t bytes, int node, size_t& resident_pages, size_t& node_pages) {
+	if (!memory || bytes == 0) return;
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	uintptr_t page_size = system_info.dwPageSize;
+	uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+
+	std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages;
+	for (uintptr_t page = start / page_size * page_size; page < start + bytes; page += page_size) {
+		PSAPI_WORKING_SET_EX_INFORMATION info = {};
+		info.VirtualAddress = reinterpret_cast<void*>(page);
+		pages.push_back(info);
+	}
+	if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), static_cast<DWORD>(pages.size() * sizeof(pages[0])))) return;
+
+	for (const PSAPI_WORKING_SET_EX_INFORMATION& page : pages) {
+		if (!page.VirtualAttributes.Valid) continue;
+		resident_pages++;
+		if (static_cast<int>(page.VirtualAttributes.Node) == node) node_pages++;
+	}
+}
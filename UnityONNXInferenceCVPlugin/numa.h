@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/// <summary>
+/// Number of NUMA nodes on the machine (1 on single-socket systems).
+/// </summary>
+int numaNodeCount();
+
+/// <summary>
+/// Zero-based logical processor indices belonging to a NUMA node.
+/// </summary>
+std::vector<int> numaNodeCpus(int node);
+
+/// <summary>
+/// NUMA node of the processor the calling thread is currently running on.
+/// </summary>
+int currentNumaNode();
+
+/// <summary>
+/// Allocate memory whose pages are placed on a NUMA node.
+/// </summary>
+/// <param name="bytes">Size of the allocation.</param>
+/// <param name="node">Preferred NUMA node, or -1 for the default placement.</param>
+/// <returns>The allocation, or nullptr on failure.</returns>
+void* numaAlloc(size_t bytes, int node);
+
+/// <summary>
+/// Free memory returned by numaAlloc.
+/// </summary>
+void numaFree(void* memory, int node);
+
+/// <summary>
+/// Add a buffer's resident pages to resident_pages, and those on a NUMA node to node_pages.
+/// Pages that have not been touched yet are not resident and are not counted.
+/// </summary>
+/// <param name="memory">Start of the buffer.</param>
+/// <param name="bytes">Size of the buffer.</param>
+/// <param name="node">NUMA node the buffer should be placed on.</param>
+void numaPagePlacement(const void* memory, size_t bytes, int node, size_t& resident_pages, size_t& node_pages);
+
+/// <summary>
+/// STL allocator that places container storage on a NUMA node. With node -1 it behaves like std::allocator.
+/// Assigning or swapping containers carries the node along, so a container assigned from one built for a node
+/// keeps that node's storage instead of copying it into its own.
+/// </summary>
+template <typename T>
+struct NumaAllocator {
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	int node = -1;
+
+	NumaAllocator() = default;
+	explicit NumaAllocator(int node) : node(node) {}
+	template <typename U>
+	NumaAllocator(const NumaAllocator<U>& other) : node(other.node) {}
+
+	T* allocate(size_t count) {
+		void* memory = numaAlloc(count * sizeof(T), node);
+		if (!memory) throw std::bad_alloc();
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T* memory, size_t) {
+		numaFree(memory, node);
+	}
+
+	template <typename U>
+	bool operator==(const NumaAllocator<U>& other) const { return node == other.node; }
+	template <typename U>
+	bool operator!=(const NumaAllocator<U>& other) const { return node != other.node; }
+};
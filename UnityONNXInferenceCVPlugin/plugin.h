@@ -0,0 +1,156 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include "ann_index.h"
+#include "gallery.h"
+#include "load_options.h"
+#include "model_file.h"
+#include "request_pool.h"
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define DLLExport __declspec (dllexport)
+
+/// <summary>
+/// The output of one run of the loaded model, valid only inside the handler passed to runModel.
+/// </summary>
+struct ModelOutput {
+	OrtValue* tensor;                 // The output tensor, for its shape
+	void* data;                       // Output elements of element_type
+	size_t count;                     // Number of elements in the output
+	ONNXTensorElementDataType element_type;
+	RequestContext* context;          // The call's request context, whose scratch buffer postprocessing may use
+	int input_w;                      // Width of the image the model ran on
+	int input_h;                      // Height of the image the model ran on
+	std::vector<OrtValue*> extra_tensors; // The model's further outputs in model order, when runModel was asked for all outputs
+};
+
+// Postprocessing run on the output of runModel
+using ModelOutputHandler = std::function<void(const ModelOutput&)>;
+
+struct LoadedModel;
+struct InstanceMaskOptions;
+struct InstanceMask;
+struct InstanceMaskInfo;
+
+// Plugin state and exported entry points shared between the plugin's source files
+extern "C" {
+	extern const int n_channels;      // Number of color channels in the input image (3 for RGB)
+	extern const OrtApi* ort;         // Pointer to the ONNX Runtime C API, used for most ONNX operations
+
+	std::wstring stringToWstring(const std::string& str);
+
+	// Inference stages shared by PerformInference and the benchmark suite
+	void preprocessImage(const byte* image_data, float* input, int pixel_count);
+	void preprocessImageUint8(const byte* image_data, uint8_t* input, int pixel_count);
+	void preprocessInput(const byte* image_data, void* input, ONNXTensorElementDataType element_type, int pixel_count);
+	size_t inputTensorBytes(ONNXTensorElementDataType element_type, int pixel_count);
+	OrtValue* createInputTensor(void* input, ONNXTensorElementDataType element_type, int width, int height);
+	void writeOutput(const void* data, size_t count, float* output_array, ONNXTensorElementDataType element_type);
+	void copyOutput(OrtValue* output_tensor, float* output_array, int length, ONNXTensorElementDataType element_type);
+
+	// Session creation shared by LoadModelWithOptions and the scheduler
+	ONNXTensorElementDataType getElementType(OrtSession* session, bool is_input);
+	OrtSession* createSession(OrtEnv* session_env, const ModelSource& model, const char* execution_provider, const LoadOptions& load_options, const std::vector<int>& intra_op_cpus, bool global_threads);
+
+	// Inference shared by PerformInference and the native postprocessing stages
+	bool runModel(byte* image_data, const ModelOutputHandler& handler, bool all_outputs = false);
+	bool runModelOn(LoadedModel& model, byte* image_data, const ModelOutputHandler& handler, bool all_outputs = false);
+
+	DLLExport void FreeResources();
+	DLLExport const char* LoadModelWithOptions(const char* model_path, const char* execution_provider, int image_dims[2], const char* options);
+	DLLExport const char* LoadModel(const char* model_path, const char* execution_provider, int image_dims[2]);
+	DLLExport void PerformInference(byte* image_data, float* output_array, int length);
+	DLLExport int PerformInferenceInstanceMasks(byte* image_data, const InstanceMaskOptions* options, InstanceMask* masks, int max_masks, uint8_t* mask_bits, int mask_bytes, InstanceMaskInfo* info);
+	DLLExport int DecodeInstanceMask(const InstanceMask* mask, const uint8_t* mask_data, int encoding, uint8_t* image, int image_width, int image_height, uint8_t value, int flip_rows);
+}
+
+/// <summary>
+/// Deleter that releases ONNX Runtime objects through the C API, for OrtPtr.
+/// </summary>
+struct OrtReleaser {
+	void operator()(OrtEnv* env) const { ort->ReleaseEnv(env); }
+	void operator()(OrtSession* session) const { ort->ReleaseSession(session); }
+	void operator()(OrtSessionOptions* options) const { ort->ReleaseSessionOptions(options); }
+	void operator()(OrtThreadingOptions* options) const { ort->ReleaseThreadingOptions(options); }
+	void operator()(OrtRunOptions* options) const { ort->ReleaseRunOptions(options); }
+	void operator()(OrtMemoryInfo* memory_info) const { ort->ReleaseMemoryInfo(memory_info); }
+	void operator()(OrtValue* value) const { ort->ReleaseValue(value); }
+};
+
+// Owning pointer to an ONNX Runtime object
+template <typename T>
+using OrtPtr = std::unique_ptr<T, OrtReleaser>;
+
+/// <summary>
+/// A session for the loaded model together with the request contexts used to run it.
+/// The numa_replicas load option creates one per NUMA node; otherwise there is exactly one.
+/// </summary>
+struct SessionReplica {
+	OrtSession* session = nullptr;    // Session whose intra-op threads run on numa_node's processors
+	int numa_node = -1;               // NUMA node the session and its buffers are bound to, or -1 for no binding
+	RequestContextPool pool;          // Request contexts allocated on numa_node
+
+	~SessionReplica() {
+		pool.Clear();
+		if (session) ort->ReleaseSession(session);
+	}
+};
+
+/// <summary>
+/// Runs a callback when destroyed. As the first member of a LoadedModel it runs after the model's sessions are released.
+/// </summary>
+struct ReleaseCallback {
+	std::function<void()> callback;
+	~ReleaseCallback() { if (callback) callback(); }
+};
+
+/// <summary>
+/// The sessions of a loaded model and what PerformInference needs to run them.
+/// Each call holds a reference for its whole duration, so ReloadModel can publish a new model
+/// while calls already running on the old one finish undisturbed.
+/// </summary>
+struct LoadedModel {
+	ReleaseCallback on_released;      // Run on whichever thread drops the last reference; set by ReloadModel to time the drain
+	std::shared_ptr<OrtEnv> env;      // The runtime context's environment; declared first so it outlives the sessions
+	uint64_t generation = 0;          // Increases with every model built; keys the result cache together with the frame hash
+	std::shared_ptr<ExternalInitializers> external_initializers; // Mapped external weights the sessions use, or null
+	std::vector<std::unique_ptr<SessionReplica>> replicas; // One per NUMA node with numa_replicas, otherwise one
+	std::string input_name;
+	std::string output_name;
+	std::vector<std::string> extra_output_names; // Names of the outputs after the first, fetched only by stages that need them
+	int input_w = 0;                  // Width of the input image
+	int input_h = 0;                  // Height of the input image
+	int n_pixels = 0;                 // Total number of pixels in the input image (width x height)
+	ONNXTensorElementDataType input_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+	ONNXTensorElementDataType output_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+	LoadOptions options;
+	std::shared_ptr<EmbeddingGallery> gallery = std::make_shared<EmbeddingGallery>(); // Reference embeddings for PerformInferenceEmbeddingSearch, in this model's embedding space
+	std::shared_ptr<AnnIndex> ann_index; // Approximate index for PerformInferenceAnnSearch, or null; read and replaced with std::atomic_load and std::atomic_store
+};
+
+// The loaded model, or null. Read with std::atomic_load and replaced with publishModel; code that runs the model
+// takes one reference up front and uses only that model's sessions, names and types until it returns
+extern std::shared_ptr<LoadedModel> loaded_model;
+
+// Model construction shared by LoadModelWithOptions and ReloadModel
+std::string getTensorName(OrtSession* session, bool is_input, size_t index = 0);
+const char* buildModel(const char* model_path, const char* execution_provider, const LoadOptions& load_options, int width, int height, std::shared_ptr<LoadedModel>& model);
+std::shared_ptr<LoadedModel> publishModel(std::shared_ptr<LoadedModel> model);
+
+// Embedding inference shared by the gallery and the approximate nearest-neighbor index
+bool runEmbedding(byte* image_data, const std::function<void(const float*, int)>& handler);
+
+/// <summary>
+/// Throw the message of a failed ONNX Runtime call as a std::runtime_error.
+/// </summary>
+/// <param name="status">The status returned by an OrtApi function.</param>
+inline void checkStatus(OrtStatus* status) {
+	if (!status) return;
+	std::string message = ort->GetErrorMessage(status);
+	ort->ReleaseStatus(status);
+	throw std::runtime_error(message);
+}
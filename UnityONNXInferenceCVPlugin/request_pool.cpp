@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "plugin.h"
+#include "request_pool.h"
+
+namespace {
+	/// <summary>
+	/// Get the shape of the session's first output if it is a float or float16 tensor of fixed size.
+	/// A dynamic leading (batch) dimension is treated as 1.
+	/// </summary>
+	/// <returns>The shape, or an empty vector if the output cannot be preallocated.</returns>
+	std::vector<int64_t> getStaticOutputShape(OrtSession* session) {
+		OrtTypeInfo* type_info;
+		checkStatus(ort->SessionGetOutputTypeInfo(session, 0, &type_info));
+
+		const OrtTensorTypeAndShapeInfo* tensor_info;
+		ONNXTensorElementDataType element_type;
+		size_t dim_count;
+		std::vector<int64_t> shape;
+		ort->CastTypeInfoToTensorInfo(type_info, &tensor_info);
+		if (tensor_info) {
+			ort->GetTensorElementType(tensor_info, &element_type);
+			ort->GetDimensionsCount(tensor_info, &dim_count);
+			shape.resize(dim_count);
+			ort->GetDimensions(tensor_info, shape.data(), dim_count);
+		}
+		ort->ReleaseTypeInfo(type_info);
+
+		if (!tensor_info) return {};
+		if (element_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && element_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) return {};
+		for (size_t i = 0; i < shape.size(); i++) {
+			if (shape[i] > 0) continue;
+			if (i != 0) return {};
+			shape[i] = 1;
+		}
+		return shape;
+	}
+}
+
+void RequestContextPool::Reset(OrtSession* session, int capacity, int numa_node, ONNXTensorElementDataType input_type, ONNXTensorElementDataType output_type, int width, int height) {
+	Clear();
+
+	std::vector<int64_t> output_shape = getStaticOutputShape(session);
+	size_t output_count = 1;
+	for (int64_t dim : output_shape) output_count *= static_cast<size_t>(dim);
+	size_t element_size = (output_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) ? sizeof(uint16_t) : sizeof(float);
+
+	// Create a memory info instance for the tensor views
+	OrtMemoryInfo* memory_info;
+	checkStatus(ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault, &memory_info));
+
+	std::vector<std::unique_ptr<RequestContext>> new_contexts;
+	try {
+		for (int i = 0; i < capacity; i++) {
+			std::unique_ptr<RequestContext> context = std::make_unique<RequestContext>();
+
+			// Bind the input tensor to the context's buffer once
+			context->input = decltype(context->input)(inputTensorBytes(input_type, width * height), NumaAllocator<uint8_t>(numa_node));
+			context->input_tensor = createInputTensor(context->input.data(), input_type, width, height);
+
+			// Preallocate the output tensor when its shape is known ahead of time
+			if (!output_shape.empty()) {
+				context->output = decltype(context->output)(output_count * element_size, NumaAllocator<uint8_t>(numa_node));
+				context->output_count = output_count;
+				context->scratch = decltype(context->scratch)(output_count, NumaAllocator<float>(numa_node));
+				checkStatus(ort->CreateTensorWithDataAsOrtValue(
+					memory_info, context->output.data(), context->output.size(),
+					output_shape.data(), output_shape.size(), output_type, &context->output_tensor
+				));
+			}
+
+			new_contexts.push_back(std::move(context));
+		}
+	}
+	catch (...) {
+		ort->ReleaseMemoryInfo(memory_info);
+		for (auto& context : new_contexts) {
+			if (context->input_tensor) ort->ReleaseValue(context->input_tensor);
+			if (context->output_tensor) ort->ReleaseValue(context->output_tensor);
+		}
+		throw;
+	}
+	ort->ReleaseMemoryInfo(memory_info);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	contexts = std::move(new_contexts);
+	idle.reserve(contexts.size());
+	for (auto& context : contexts) idle.push_back(context.get());
+	peak_in_use = 0;
+	waits = 0;
+}
+
+void RequestContextPool::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	releaseTensors();
+	contexts.clear();
+	idle.clear();
+}
+
+void RequestContextPool::releaseTensors() {
+	for (auto& context : contexts) {
+		if (context->input_tensor) ort->ReleaseValue(context->input_tensor);
+		if (context->output_tensor) ort->ReleaseValue(context->output_tensor);
+		context->input_tensor = nullptr;
+		context->output_tensor = nullptr;
+	}
+}
+
+RequestContextPool::Lease RequestContextPool::Acquire() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (idle.empty()) {
+		waits++;
+		returned.wait(lock, [this]() { return !idle.empty(); });
+	}
+
+	RequestContext* context = idle.back();
+	idle.pop_back();
+	peak_in_use = std::max(peak_in_use, static_cast<int>(contexts.size() - idle.size()));
+	return Lease(this, context);
+}
+
+void RequestContextPool::release(RequestContext* context) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		idle.push_back(context);
+	}
+	returned.notify_one();
+}
+
+RequestPoolStats RequestContextPool::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	RequestPoolStats stats = {};
+	stats.capacity = static_cast<int>(contexts.size());
+	stats.in_use = static_cast<int>(contexts.size() - idle.size());
+	stats.peak_in_use = peak_in_use;
+	stats.waits = waits;
+	return stats;
+}
+
+void RequestContextPool::GetPagePlacement(size_t& resident_pages, size_t& node_pages) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& context : contexts) {
+		int node = context->input.get_allocator().node;
+		if (node < 0) continue;
+		numaPagePlacement(context->input.data(), context->input.size(), node, resident_pages, node_pages);
+		numaPagePlacement(context->output.data(), context->output.size(), node, resident_pages, node_pages);
+		numaPagePlacement(context->scratch.data(), context->scratch.size() * sizeof(float), node, resident_pages, node_pages);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include "numa.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Buffers and tensors for one in-flight PerformInference call, allocated once at load time
+/// on the NUMA node of the session that uses them.
+/// </summary>
+struct RequestContext {
+	std::vector<uint8_t, NumaAllocator<uint8_t>> input;   // Preprocessed model input, holding float or uint8 elements per the model's input type
+	OrtValue* input_tensor = nullptr;                     // Tensor view over input
+	std::vector<uint8_t, NumaAllocator<uint8_t>> output;  // Model output, holding float or float16 elements per the model's output type, when the output shape is fixed
+	size_t output_count = 0;                              // Number of elements in output
+	OrtValue* output_tensor = nullptr;                    // Tensor view over output, or nullptr to let ONNX Runtime allocate a dynamic-shape output
+	std::vector<float, NumaAllocator<float>> scratch;     // Postprocessing workspace, sized to the output
+};
+
+/// <summary>
+/// Usage statistics for the request context pool.
+/// </summary>
+struct RequestPoolStats {
+	int capacity;                         // Number of preallocated contexts
+	int in_use;                           // Contexts currently lent out
+	int peak_in_use;                      // Most contexts lent out at once since the model was loaded
+	long long waits;                      // Acquire calls that blocked because every context was in use
+};
+
+/// <summary>
+/// Fixed-capacity, thread-safe pool of request contexts. Acquire blocks when every context is in use,
+/// so steady-state inference never allocates.
+/// </summary>
+class RequestContextPool {
+public:
+	/// <summary>
+	/// A context borrowed from the pool, returned automatically when the lease goes out of scope.
+	/// </summary>
+	class Lease {
+	public:
+		Lease(RequestContextPool* pool, RequestContext* context) : pool(pool), context(context) {}
+		Lease(Lease&& other) noexcept : pool(other.pool), context(other.context) { other.context = nullptr; }
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		~Lease() { if (context) pool->release(context); }
+
+		RequestContext* operator->() { return context; }
+		RequestContext* get() { return context; }
+
+	private:
+		RequestContextPool* pool;
+		RequestContext* context;
+	};
+
+	/// <summary>
+	/// Release the current contexts and preallocate new ones for the loaded model.
+	/// Must not be called while any context is lent out.
+	/// </summary>
+	/// <param name="session">The loaded session, used to look up the output shape.</param>
+	/// <param name="capacity">Number of contexts to allocate.</param>
+	/// <param name="numa_node">NUMA node to place the buffers on, or -1 for the default placement.</param>
+	/// <param name="input_type">Element type of the model's input.</param>
+	/// <param name="output_type">Element type of the model's output.</param>
+	/// <param name="width">Width of the model's input image.</param>
+	/// <param name="height">Height of the model's input image.</param>
+	void Reset(OrtSession* session, int capacity, int numa_node, ONNXTensorElementDataType input_type, ONNXTensorElementDataType output_type, int width, int height);
+
+	/// <summary>
+	/// Release every context and its tensors.
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Borrow a context, waiting for one to be returned if all are in use.
+	/// </summary>
+	Lease Acquire();
+
+	RequestPoolStats GetStats();
+
+	/// <summary>
+	/// Count the resident pages of the contexts' buffers, and how many of them are on the NUMA node the buffers
+	/// were allocated for. Buffers with the default placement are skipped.
+	/// </summary>
+	/// <param name="resident_pages">Incremented by the number of resident pages.</param>
+	/// <param name="node_pages">Incremented by the number of those on the buffers' node.</param>
+	void GetPagePlacement(size_t& resident_pages, size_t& node_pages);
+
+private:
+	void release(RequestContext* context);
+	void releaseTensors();
+
+	std::mutex mutex;
+	std::condition_variable returned;
+	std::vector<std::unique_ptr<RequestContext>> contexts;
+	std::vector<RequestContext*> idle;    // Reserved to full capacity so returning a context never allocates
+	int peak_in_use = 0;
+	long long waits = 0;
+};
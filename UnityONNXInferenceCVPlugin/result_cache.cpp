@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "plugin.h"
+#include "result_cache.h"
+
+ResultCache result_cache;
+
+void ResultCache::SetCapacity(int max_entries, long long max_bytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->max_entries = max_entries > 0 ? max_entries : 0;
+	this->max_bytes = max_bytes > 0 ? max_bytes : 0;
+	enabled = this->max_entries > 0;
+	evict();
+}
+
+bool ResultCache::Lookup(uint64_t generation, uint64_t key, float* output_array, int length) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = index.find(key);
+	if (found == index.end() || found->second->generation != generation || found->second->output.size() != static_cast<size_t>(length)) {
+		misses++;
+		return false;
+	}
+
+	// Move the entry to the front of the recency list
+	entries.splice(entries.begin(), entries, found->second);
+	std::memcpy(output_array, found->second->output.data(), length * sizeof(float));
+	hits++;
+	return true;
+}
+
+void ResultCache::Insert(uint64_t generation, uint64_t key, const float* output_array, int length) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!enabled) return;
+
+	// Outputs larger than the byte budget would evict everything and still not fit
+	long long entry_bytes = static_cast<long long>(length) * sizeof(float);
+	if (max_bytes > 0 && entry_bytes > max_bytes) return;
+
+	// Replace an existing entry for the same key (e.g., a different output length or an older model). A call that
+	// finishes on a replaced model must not overwrite the current model's output, since generations only increase
+	auto found = index.find(key);
+	if (found != index.end() && found->second->generation > generation) return;
+	if (found != index.end()) {
+		bytes -= found->second->output.size() * sizeof(float);
+		entries.erase(found->second);
+		index.erase(found);
+	}
+
+	// Reuse the last evicted buffer to avoid an allocation when the cache is full
+	Entry entry{ key, generation, std::move(spare) };
+	entry.output.assign(output_array, output_array + length);
+	spare = std::vector<float>();
+
+	entries.push_front(std::move(entry));
+	index[key] = entries.begin();
+	bytes += entry_bytes;
+	evict();
+}
+
+void ResultCache::evict() {
+	while (!entries.empty() &&
+		(static_cast<int>(entries.size()) > max_entries || (max_bytes > 0 && bytes > max_bytes))) {
+		Entry& oldest = entries.back();
+		bytes -= oldest.output.size() * sizeof(float);
+		index.erase(oldest.key);
+		spare = std::move(oldest.output);
+		entries.pop_back();
+		evictions++;
+	}
+}
+
+void ResultCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+	index.clear();
+	bytes = 0;
+}
+
+ResultCacheStats ResultCache::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	ResultCacheStats stats = {};
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.evictions = evictions;
+	stats.hit_rate = (hits + misses) > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+	stats.entries = static_cast<int>(entries.size());
+	stats.bytes = bytes;
+	return stats;
+}
+
+extern "C" {
+	/// <summary>
+	/// Enable the result cache in front of the session, or disable it with a zero entry limit.
+	/// </summary>
+	/// <param name="max_entries">Maximum number of cached outputs.</param>
+	/// <param name="max_bytes">Maximum total size of cached outputs in bytes, or 0 for no byte limit.</param>
+	/// <returns></returns>
+	DLLExport void SetResultCacheCapacity(int max_entries, long long max_bytes) {
+		result_cache.SetCapacity(max_entries, max_bytes);
+	}
+
+	/// <summary>
+	/// Drop all cached outputs, keeping the hit/miss counters.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void ClearResultCache() {
+		result_cache.Clear();
+	}
+
+	/// <summary>
+	/// Retrieve the result cache's hit rate and memory usage.
+	/// </summary>
+	/// <param name="stats">Receives the statistics.</param>
+	/// <returns></returns>
+	DLLExport void GetResultCacheStats(ResultCacheStats* stats) {
+		*stats = result_cache.GetStats();
+	}
+}
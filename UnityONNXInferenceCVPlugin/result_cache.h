@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Hit-rate and memory statistics for the result cache.
+/// </summary>
+struct ResultCacheStats {
+	long long hits;                   // Lookups answered from the cache
+	long long misses;                 // Lookups that fell through to the session
+	long long evictions;              // Entries dropped to stay within capacity
+	double hit_rate;                  // hits / (hits + misses), or 0 before any lookup
+	int entries;                      // Entries currently cached
+	long long bytes;                  // Output bytes currently cached
+};
+
+/// <summary>
+/// Bounded LRU cache of model outputs keyed by a 64-bit hash of the input frame and the generation of the
+/// model that produced them, so an output computed by a model that has since been replaced is never returned.
+/// </summary>
+class ResultCache {
+public:
+	/// <summary>
+	/// Set the cache bounds, evicting entries as needed. A zero entry limit disables the cache.
+	/// </summary>
+	void SetCapacity(int max_entries, long long max_bytes);
+
+	/// <summary>
+	/// Whether the cache has a nonzero capacity.
+	/// </summary>
+	bool IsEnabled() const { return enabled; }
+
+	/// <summary>
+	/// Copy a cached output to output_array and mark it as most recently used.
+	/// </summary>
+	/// <param name="generation">Generation of the model the caller runs.</param>
+	/// <param name="key">Hash of the input frame.</param>
+	/// <returns>True on a hit.</returns>
+	bool Lookup(uint64_t generation, uint64_t key, float* output_array, int length);
+
+	/// <summary>
+	/// Cache an output, evicting the least recently used entries if over capacity.
+	/// </summary>
+	/// <param name="generation">Generation of the model that produced the output.</param>
+	/// <param name="key">Hash of the input frame.</param>
+	void Insert(uint64_t generation, uint64_t key, const float* output_array, int length);
+
+	void Clear();
+	ResultCacheStats GetStats();
+
+private:
+	struct Entry {
+		uint64_t key;
+		uint64_t generation;
+		std::vector<float> output;
+	};
+
+	void evict();
+
+	std::mutex mutex;
+	std::atomic<bool> enabled{ false };                                 // Checked without the lock on the hot path
+	int max_entries = 0;
+	long long max_bytes = 0;
+	long long bytes = 0;
+	long long hits = 0;
+	long long misses = 0;
+	long long evictions = 0;
+	std::list<Entry> entries;                                           // Most recently used first
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index;     // Key to list position
+	std::vector<float> spare;                                           // Evicted buffer reused by the next insert
+};
+
+extern ResultCache result_cache;
@@ -0,0 +1,48 @@
+#include "pch.h"
+#include "runtime_context.h"
+#include "plugin.h"
+
+RuntimeContext& RuntimeContext::Get() {
+	// Never destroyed: releasing the environment from a static destructor would race the sessions
+	// other translation units release at DLL unload
+	static RuntimeContext* context = new RuntimeContext();
+	return *context;
+}
+
+RuntimeContext::RuntimeContext() {
+	// Get the ONNX Runtime API
+	ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+
+	// Copy the provider names and free ONNX Runtime's array
+	char** raw_provider_names;
+	int provider_count;
+	checkStatus(ort->GetAvailableProviders(&raw_provider_names, &provider_count));
+	providers.assign(raw_provider_names, raw_provider_names + provider_count);
+	ort->ReleaseAvailableProviders(raw_provider_names, provider_count);
+}
+
+std::shared_ptr<OrtEnv> RuntimeContext::Env() {
+	std::lock_guard<std::mutex> lock(env_mutex);
+	if (env) return env;
+
+	OrtThreadingOptions* threading_options;
+	checkStatus(ort->CreateThreadingOptions(&threading_options));
+	OrtPtr<OrtThreadingOptions> threading_options_owner(threading_options);
+	checkStatus(ort->SetGlobalIntraOpNumThreads(threading_options, global_intra_op_threads));
+
+	// Create an ONNX Runtime environment with a given logging level
+	OrtEnv* new_env;
+	checkStatus(ort->CreateEnvWithGlobalThreadPools(ORT_LOGGING_LEVEL_WARNING, "inference-session", threading_options, &new_env));
+	env = std::shared_ptr<OrtEnv>(new_env, OrtReleaser());
+
+	// Disable telemetry events
+	ort->DisableTelemetryEvents(new_env);
+	return env;
+}
+
+bool RuntimeContext::SetGlobalIntraOpThreads(int threads) {
+	std::lock_guard<std::mutex> lock(env_mutex);
+	if (env) return threads == global_intra_op_threads;
+	global_intra_op_threads = threads;
+	return true;
+}
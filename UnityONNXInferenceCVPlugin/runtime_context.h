@@ -0,0 +1,52 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Process-wide ONNX Runtime state shared by every session the plugin creates: the API table, the list of
+/// available execution providers, and the environment. ONNX Runtime allows one environment per process, so
+/// LoadModel, ReloadModel and the scheduler all create their sessions in this one.
+/// </summary>
+class RuntimeContext {
+public:
+	/// <summary>
+	/// Get the context, fetching the API and the provider list on first use. Safe to call from any thread.
+	/// </summary>
+	static RuntimeContext& Get();
+
+	RuntimeContext(const RuntimeContext&) = delete;
+	RuntimeContext& operator=(const RuntimeContext&) = delete;
+
+	/// <summary>
+	/// Names of the execution providers available in this build of ONNX Runtime, e.g., DmlExecutionProvider.
+	/// </summary>
+	const std::vector<std::string>& Providers() const { return providers; }
+
+	/// <summary>
+	/// Get the environment, creating it on first use. It owns global thread pools for sessions that
+	/// opt out of per-session threads; other sessions keep their own. The global intra-op pool has only
+	/// the calling thread unless SetGlobalIntraOpThreads asked for more first, so processes that never
+	/// use the scheduler start no idle pool.
+	/// </summary>
+	/// <returns>The environment. Throws if it cannot be created.</returns>
+	std::shared_ptr<OrtEnv> Env();
+
+	/// <summary>
+	/// Set the size of the global intra-op thread pool, which is fixed once the environment exists.
+	/// </summary>
+	/// <param name="threads">Number of threads, or 0 for one per core.</param>
+	/// <returns>False if the environment already exists with a different size.</returns>
+	bool SetGlobalIntraOpThreads(int threads);
+
+private:
+	RuntimeContext();
+
+	std::vector<std::string> providers;
+	std::mutex env_mutex;
+	std::shared_ptr<OrtEnv> env;
+	int global_intra_op_threads = 1;
+};
@@ -0,0 +1,522 @@
+#include "pch.h"
+#include "plugin.h"
+#include "affinity.h"
+#include "runtime_context.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Scheduler for several models sharing the CPU. Each model gets a priority and a relative deadline.
+// Submitted requests wait in one ready queue and a small, fixed set of executor threads runs them in
+// priority order, earliest deadline first within a priority. Sessions share the scheduler environment's
+// global intra-op thread pool, so the executors, not the call order, decide which model's run gets the
+// cores. When every executor is busy and a request arrives that outranks a running one, the running
+// one is cancelled through its run options and requeued.
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	/// <summary>
+	/// A model loaded with LoadScheduledModel.
+	/// </summary>
+	struct ScheduledModel {
+		std::shared_ptr<ExternalInitializers> external_initializers; // Mapped external weights the session uses, or null
+		OrtSession* session = nullptr;
+		std::string input_name;
+		std::string output_name;
+		ONNXTensorElementDataType input_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+		ONNXTensorElementDataType output_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+		int input_w = 0;
+		int input_h = 0;
+		int priority = 0;                     // Larger values run first
+		Clock::duration deadline = Clock::duration::zero(); // Relative deadline of each request, or zero for none
+
+		int queued = 0;                       // Requests in the ready queue
+		int running = 0;                      // Requests on an executor
+		bool unloading = false;               // Set by unloadModel; preempted runs then fail instead of being requeued
+		std::vector<std::vector<uint8_t>> spare_inputs; // Input buffers of finished requests, reused by later submissions
+
+		long long completed = 0;
+		long long failed = 0;
+		long long deadline_misses = 0;
+		long long preemptions = 0;
+		long long started = 0;                // Requests that have started running at least once
+		double total_wait_ms = 0.0;
+		double total_latency_ms = 0.0;
+		double max_latency_ms = 0.0;
+
+		~ScheduledModel() {
+			if (session) ort->ReleaseSession(session);
+		}
+	};
+
+	enum class RequestState { Queued, Running, Done, Failed };
+
+	/// <summary>
+	/// One submitted inference, kept until WaitScheduledInference collects it.
+	/// </summary>
+	struct ScheduledRequest {
+		ScheduledModel* model = nullptr;
+		std::vector<uint8_t> input;           // Preprocessed model input
+		float* output_array = nullptr;
+		int length = 0;
+		Clock::time_point submitted;
+		Clock::time_point deadline;           // Absolute deadline, or Clock::time_point::max() for none
+		RequestState state = RequestState::Queued;
+		bool started = false;                 // Whether a run has started, for the queue wait statistic
+		bool preempted = false;               // Whether the current run has been asked to terminate
+		OrtRunOptions* run_options = nullptr; // Run options of the executor running the request
+	};
+
+	std::mutex scheduler_mutex;
+	std::condition_variable work_available;
+	std::condition_variable request_finished;
+
+	std::shared_ptr<OrtEnv> scheduler_env;    // The runtime context's environment, whose global thread pool the sessions share
+	int executor_count = 1;                   // Runs in flight at once
+	int intra_op_threads = 0;                 // Size of the shared intra-op pool if the scheduler creates the environment, or 0 for one thread per core
+	bool preemption_enabled = true;
+
+	std::vector<std::unique_ptr<ScheduledModel>> models;  // Indexed by handle; unloaded models leave a null entry
+	std::unordered_map<int, std::unique_ptr<ScheduledRequest>> requests; // Submitted requests by ID
+	std::vector<ScheduledRequest*> ready_queue;
+	std::vector<ScheduledRequest*> running;
+	std::vector<std::thread> executors;
+	bool stopping = false;
+	int next_request_id = 1;
+
+	/// <summary>
+	/// Order requests by priority, then by earliest deadline, then by submission.
+	/// </summary>
+	bool runsBefore(const ScheduledRequest* a, const ScheduledRequest* b) {
+		if (a->model->priority != b->model->priority) return a->model->priority > b->model->priority;
+		if (a->deadline != b->deadline) return a->deadline < b->deadline;
+		return a->submitted < b->submitted;
+	}
+
+	double millisecondsSince(Clock::time_point start, Clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	ScheduledModel* findModel(int handle) {
+		if (handle < 0 || handle >= static_cast<int>(models.size())) return nullptr;
+		return models[handle].get();
+	}
+
+	/// <summary>
+	/// Run one request on its model's session and copy the output. Called without the scheduler lock.
+	/// </summary>
+	/// <returns>False if the run failed or was cancelled.</returns>
+	bool runRequest(ScheduledRequest& request, OrtRunOptions* run_options) {
+		ScheduledModel& model = *request.model;
+		OrtValue* input_tensor = createInputTensor(request.input.data(), model.input_type, model.input_w, model.input_h);
+
+		const char* input_names[] = { model.input_name.c_str() };
+		const char* output_names[] = { model.output_name.c_str() };
+		OrtValue* output_tensor = nullptr;
+		OrtStatus* status = ort->Run(model.session, run_options, input_names, (const OrtValue* const*)&input_tensor, 1, output_names, 1, &output_tensor);
+		ort->ReleaseValue(input_tensor);
+		if (status) {
+			ort->ReleaseStatus(status);
+			if (output_tensor) ort->ReleaseValue(output_tensor);
+			return false;
+		}
+
+		// Never copy more than the model produced, and only from an output of the type checked at load time
+		OrtTensorTypeAndShapeInfo* shape_info;
+		size_t count = 0;
+		ONNXTensorElementDataType element_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+		ort->GetTensorTypeAndShape(output_tensor, &shape_info);
+		ort->GetTensorShapeElementCount(shape_info, &count);
+		ort->GetTensorElementType(shape_info, &element_type);
+		ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+
+		bool succeeded = element_type == model.output_type;
+		if (succeeded) copyOutput(output_tensor, request.output_array, static_cast<int>(std::min(count, static_cast<size_t>(request.length))), element_type);
+		ort->ReleaseValue(output_tensor);
+		return succeeded;
+	}
+
+	/// <summary>
+	/// Record a request's outcome and wake its waiters. Called with the scheduler lock held.
+	/// </summary>
+	void finishRequest(ScheduledRequest& request, bool succeeded) {
+		ScheduledModel& model = *request.model;
+		Clock::time_point now = Clock::now();
+		request.state = succeeded ? RequestState::Done : RequestState::Failed;
+
+		if (succeeded) {
+			double latency_ms = millisecondsSince(request.submitted, now);
+			model.completed++;
+			model.total_latency_ms += latency_ms;
+			model.max_latency_ms = std::max(model.max_latency_ms, latency_ms);
+			if (now > request.deadline) model.deadline_misses++;
+		}
+		else {
+			model.failed++;
+		}
+
+		model.spare_inputs.push_back(std::move(request.input));
+		request_finished.notify_all();
+	}
+
+	/// <summary>
+	/// Cancel the lowest-ranked running request if a newly queued one outranks it and no executor is free.
+	/// Called with the scheduler lock held.
+	/// </summary>
+	void preemptFor(const ScheduledRequest& request) {
+		if (!preemption_enabled || running.size() + ready_queue.size() <= executors.size()) return;
+
+		ScheduledRequest* victim = nullptr;
+		for (ScheduledRequest* candidate : running) {
+			// A run of a model being unloaded would fail rather than be requeued, so it is left to finish
+			if (candidate->preempted || candidate->model->unloading || candidate->model->priority >= request.model->priority) continue;
+			if (!victim || runsBefore(victim, candidate)) victim = candidate;
+		}
+		if (!victim) return;
+
+		// The executor clears the flag before its next run, so a run that already finished is unaffected
+		victim->preempted = true;
+		ort->RunOptionsSetTerminate(victim->run_options);
+	}
+
+	/// <summary>
+	/// Executor thread: repeatedly run the highest-ranked ready request.
+	/// </summary>
+	void executorLoop() {
+		initWorkerThread();
+
+		OrtRunOptions* run_options = nullptr;
+		ort->CreateRunOptions(&run_options);
+		OrtPtr<OrtRunOptions> run_options_owner(run_options);
+
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+		while (true) {
+			work_available.wait(lock, []() { return stopping || !ready_queue.empty(); });
+			if (ready_queue.empty()) break;
+
+			auto next = std::min_element(ready_queue.begin(), ready_queue.end(), runsBefore);
+			ScheduledRequest* request = *next;
+			ready_queue.erase(next);
+
+			ScheduledModel& model = *request->model;
+			model.queued--;
+			model.running++;
+			if (!request->started) {
+				request->started = true;
+				model.started++;
+				model.total_wait_ms += millisecondsSince(request->submitted, Clock::now());
+			}
+			request->state = RequestState::Running;
+			request->preempted = false;
+			request->run_options = run_options;
+			ort->RunOptionsUnsetTerminate(run_options);
+			running.push_back(request);
+
+			lock.unlock();
+			refreshWorkerThread();
+			bool succeeded = runRequest(*request, run_options);
+			lock.lock();
+
+			running.erase(std::find(running.begin(), running.end(), request));
+			request->run_options = nullptr;
+			model.running--;
+
+			// A cancelled run goes back in the queue behind the request that displaced it, unless its model is being
+			// unloaded, which has already failed the model's queued requests and now waits for running to reach zero
+			if (!succeeded && request->preempted && !stopping && !model.unloading) {
+				model.preemptions++;
+				model.queued++;
+				request->state = RequestState::Queued;
+				ready_queue.push_back(request);
+				work_available.notify_one();
+				request_finished.notify_all();
+				continue;
+			}
+			finishRequest(*request, succeeded);
+		}
+	}
+
+	/// <summary>
+	/// Take the shared environment and start the executors, if not already running.
+	/// Called with the scheduler lock held.
+	/// </summary>
+	void startScheduler() {
+		if (scheduler_env) return;
+
+		// Size the shared pool for the scheduled models unless LoadModel already created the environment with a minimal one
+		RuntimeContext::Get().SetGlobalIntraOpThreads(intra_op_threads);
+		scheduler_env = RuntimeContext::Get().Env();
+
+		stopping = false;
+		for (int i = 0; i < executor_count; i++) executors.emplace_back(executorLoop);
+	}
+
+	/// <summary>
+	/// Fail a model's queued requests and wait for its running ones, then release it.
+	/// Called with the scheduler lock held.
+	/// </summary>
+	void unloadModel(std::unique_lock<std::mutex>& lock, int handle) {
+		ScheduledModel* model = models[handle].get();
+		model->unloading = true;
+		for (auto it = ready_queue.begin(); it != ready_queue.end();) {
+			if ((*it)->model != model) {
+				++it;
+				continue;
+			}
+			model->queued--;
+			finishRequest(**it, false);
+			it = ready_queue.erase(it);
+		}
+		request_finished.wait(lock, [model]() { return model->running == 0; });
+		models[handle].reset();
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Configure the scheduler before the first scheduled model is loaded.
+	/// </summary>
+	/// <param name="executors">Number of requests run at once. One serializes runs so the highest-ranked request gets every core.</param>
+	/// <param name="threads">Size of the intra-op thread pool shared by all scheduled models, or 0 for one thread per core.
+	/// The pool belongs to the process-wide environment, so the size is fixed once any model has been loaded; an environment
+	/// created by LoadModel first has a single-thread pool.</param>
+	/// <param name="preemption">1 to cancel and requeue lower-priority runs when a higher-priority request is waiting, 0 to let them finish.</param>
+	/// <returns>1 if the settings were applied, 0 if the scheduler is already running, the environment already has a different pool size, or a value is invalid.</returns>
+	DLLExport int ConfigureScheduler(int executors, int threads, int preemption) {
+		std::lock_guard<std::mutex> lock(scheduler_mutex);
+		if (scheduler_env || executors <= 0 || threads < 0) return 0;
+		if (!RuntimeContext::Get().SetGlobalIntraOpThreads(threads)) return 0;
+		executor_count = executors;
+		intra_op_threads = threads;
+		preemption_enabled = preemption != 0;
+		return 1;
+	}
+
+	/// <summary>
+	/// Load a model into the scheduler. Scheduled models are independent of the model loaded with LoadModel.
+	/// </summary>
+	/// <param name="model_path">Path to the ONNX model file.</param>
+	/// <param name="execution_provider">The execution provider to use (e.g., "CPU" or "Dml").</param>
+	/// <param name="image_dims">Dimensions of the input image [width, height].</param>
+	/// <param name="options">Load options as for LoadModelWithOptions. Thread, denormal and NUMA placement options are ignored because the models share one thread pool.</param>
+	/// <param name="priority">Priority of the model's requests; larger values run first.</param>
+	/// <param name="deadline_ms">Time from submission within which each request should complete, or 0 for no deadline.</param>
+	/// <param name="handle">Receives the model handle, or -1 on failure.</param>
+	/// <returns>A message indicating the success or failure of the loading process.</returns>
+	DLLExport const char* LoadScheduledModel(const char* model_path, const char* execution_provider, int image_dims[2], const char* options, int priority, double deadline_ms, int* handle) {
+		// Holds exception messages after the exception itself is destroyed
+		static std::string error_message;
+		*handle = -1;
+
+		try {
+			LoadOptions load_options = parseLoadOptions(options);
+			if (image_dims[0] <= 0 || image_dims[1] <= 0) return "Invalid image dimensions.";
+
+			{
+				std::lock_guard<std::mutex> lock(scheduler_mutex);
+				startScheduler();
+			}
+
+			std::unique_ptr<ScheduledModel> model = std::make_unique<ScheduledModel>();
+			ModelSource source = openModel(model_path, load_options.map_external_data);
+			model->external_initializers = source.external_initializers;
+			model->session = createSession(scheduler_env.get(), source, execution_provider, load_options, {}, true);
+			if (!model->session) return "Unknown execution provider specified.";
+
+			model->input_name = getTensorName(model->session, true);
+			model->output_name = getTensorName(model->session, false);
+
+			model->input_type = getElementType(model->session, true);
+			if (model->input_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && model->input_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
+				return "Unsupported model input type. Expected a float or uint8 tensor.";
+			}
+			model->output_type = getElementType(model->session, false);
+			if (model->output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT && model->output_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+				return "Unsupported model output type. Expected a float or float16 tensor.";
+			}
+
+			model->input_w = image_dims[0];
+			model->input_h = image_dims[1];
+			model->priority = priority;
+			if (deadline_ms > 0) {
+				model->deadline = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(deadline_ms));
+			}
+
+			// Reuse the slot of an unloaded model, if any
+			std::lock_guard<std::mutex> lock(scheduler_mutex);
+			auto slot = std::find(models.begin(), models.end(), nullptr);
+			*handle = static_cast<int>(slot - models.begin());
+			if (slot == models.end()) models.push_back(std::move(model));
+			else *slot = std::move(model);
+			return "Model loaded successfully.";
+		}
+		catch (const std::exception& e) {
+			error_message = e.what();
+			return error_message.c_str();
+		}
+		catch (...) {
+			return "An unknown error occurred while loading the model.";
+		}
+	}
+
+	/// <summary>
+	/// Unload a scheduled model. Its queued requests fail; running ones finish first.
+	/// Must not be called while another thread is submitting requests for the same model.
+	/// </summary>
+	/// <param name="handle">The model handle from LoadScheduledModel.</param>
+	/// <returns>1 if the model was unloaded, 0 if the handle is invalid.</returns>
+	DLLExport int UnloadScheduledModel(int handle) {
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+		if (!findModel(handle)) return 0;
+		unloadModel(lock, handle);
+		return 1;
+	}
+
+	/// <summary>
+	/// Queue a frame for a scheduled model. The frame is preprocessed on the calling thread before this returns,
+	/// so image_data may be reused immediately; output_array must stay valid until the request is waited on.
+	/// </summary>
+	/// <param name="handle">The model handle from LoadScheduledModel.</param>
+	/// <param name="image_data">Raw RGB image data matching the model's image dimensions.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns>A request ID for WaitScheduledInference, or -1 if the handle is invalid or the model is being unloaded.</returns>
+	DLLExport int SubmitScheduledInference(int handle, byte* image_data, float* output_array, int length) {
+		std::unique_ptr<ScheduledRequest> request = std::make_unique<ScheduledRequest>();
+		{
+			std::lock_guard<std::mutex> lock(scheduler_mutex);
+			request->model = findModel(handle);
+			if (!request->model || request->model->unloading) return -1;
+			if (!request->model->spare_inputs.empty()) {
+				request->input = std::move(request->model->spare_inputs.back());
+				request->model->spare_inputs.pop_back();
+			}
+		}
+
+		// Preprocess outside the lock so other threads can submit in parallel
+		ScheduledModel& model = *request->model;
+		int pixel_count = model.input_w * model.input_h;
+		request->input.resize(inputTensorBytes(model.input_type, pixel_count));
+		preprocessInput(image_data, request->input.data(), model.input_type, pixel_count);
+		request->output_array = output_array;
+		request->length = length;
+		request->submitted = Clock::now();
+		request->deadline = model.deadline == Clock::duration::zero() ? Clock::time_point::max() : request->submitted + model.deadline;
+
+		std::lock_guard<std::mutex> lock(scheduler_mutex);
+		if (model.unloading) return -1;
+		int request_id = next_request_id++;
+		if (next_request_id < 0) next_request_id = 1;
+		ScheduledRequest* queued = request.get();
+		requests[request_id] = std::move(request);
+		ready_queue.push_back(queued);
+		model.queued++;
+		preemptFor(*queued);
+		work_available.notify_one();
+		return request_id;
+	}
+
+	/// <summary>
+	/// Wait for a submitted request. Finished requests are forgotten once waited on.
+	/// </summary>
+	/// <param name="request_id">The ID returned by SubmitScheduledInference.</param>
+	/// <param name="timeout_ms">Maximum time to wait, or a negative value to wait indefinitely.</param>
+	/// <returns>1 if the output is ready, 0 if the request failed, -1 if the ID is unknown, -2 if the wait timed out.</returns>
+	DLLExport int WaitScheduledInference(int request_id, int timeout_ms) {
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+		auto it = requests.find(request_id);
+		if (it == requests.end()) return -1;
+
+		ScheduledRequest* request = it->second.get();
+		auto finished = [request]() { return request->state == RequestState::Done || request->state == RequestState::Failed; };
+		if (timeout_ms < 0) request_finished.wait(lock, finished);
+		else if (!request_finished.wait_for(lock, std::chrono::milliseconds(timeout_ms), finished)) return -2;
+
+		int result = request->state == RequestState::Done ? 1 : 0;
+		requests.erase(it);
+		return result;
+	}
+
+	/// <summary>
+	/// Run a frame through the scheduler and wait for the result.
+	/// </summary>
+	/// <param name="handle">The model handle from LoadScheduledModel.</param>
+	/// <param name="image_data">Raw RGB image data matching the model's image dimensions.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns>1 if the output is ready, 0 if the request failed or the handle is invalid.</returns>
+	DLLExport int PerformScheduledInference(int handle, byte* image_data, float* output_array, int length) {
+		int request_id = SubmitScheduledInference(handle, image_data, output_array, length);
+		if (request_id < 0) return 0;
+		return WaitScheduledInference(request_id, -1) == 1 ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Get scheduling statistics for a scheduled model.
+	/// </summary>
+	/// <param name="handle">The model handle from LoadScheduledModel.</param>
+	/// <param name="stats">Receives the statistics.</param>
+	/// <returns>1 on success, 0 if the handle is invalid.</returns>
+	DLLExport int GetScheduledModelStats(int handle, ScheduledModelStats* stats) {
+		std::lock_guard<std::mutex> lock(scheduler_mutex);
+		ScheduledModel* model = findModel(handle);
+		if (!model) return 0;
+		stats->completed = model->completed;
+		stats->failed = model->failed;
+		stats->deadline_misses = model->deadline_misses;
+		stats->preemptions = model->preemptions;
+		stats->queued = model->queued;
+		stats->mean_wait_ms = model->started > 0 ? model->total_wait_ms / model->started : 0.0;
+		stats->mean_latency_ms = model->completed > 0 ? model->total_latency_ms / model->completed : 0.0;
+		stats->max_latency_ms = model->max_latency_ms;
+		return 1;
+	}
+
+	/// <summary>
+	/// Reset the statistics of a scheduled model.
+	/// </summary>
+	/// <param name="handle">The model handle from LoadScheduledModel.</param>
+	/// <returns>1 on success, 0 if the handle is invalid.</returns>
+	DLLExport int ResetScheduledModelStats(int handle) {
+		std::lock_guard<std::mutex> lock(scheduler_mutex);
+		ScheduledModel* model = findModel(handle);
+		if (!model) return 0;
+		model->completed = 0;
+		model->failed = 0;
+		model->deadline_misses = 0;
+		model->preemptions = 0;
+		model->started = 0;
+		model->total_wait_ms = 0.0;
+		model->total_latency_ms = 0.0;
+		model->max_latency_ms = 0.0;
+		return 1;
+	}
+
+	/// <summary>
+	/// Unload every scheduled model and stop the executors. The shared thread pool belongs to the runtime
+	/// context's environment and stays alive for later scheduled and LoadModel sessions.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void ShutdownScheduler() {
+		std::vector<std::thread> stopped;
+		{
+			std::unique_lock<std::mutex> lock(scheduler_mutex);
+			for (int handle = 0; handle < static_cast<int>(models.size()); handle++) {
+				if (models[handle]) unloadModel(lock, handle);
+			}
+			models.clear();
+			stopping = true;
+			stopped.swap(executors);
+		}
+		work_available.notify_all();
+		for (std::thread& executor : stopped) executor.join();
+
+		// Drop the scheduler's reference so the next scheduled load restarts the executors
+		std::lock_guard<std::mutex> lock(scheduler_mutex);
+		scheduler_env.reset();
+	}
+}
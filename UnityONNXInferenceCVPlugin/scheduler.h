@@ -0,0 +1,15 @@
+#pragma once
+
+/// <summary>
+/// Per-model statistics for models run through the scheduler.
+/// </summary>
+struct ScheduledModelStats {
+	long long completed;              // Requests that ran to completion
+	long long failed;                 // Requests that failed or were dropped when the model was unloaded
+	long long deadline_misses;        // Completed requests that finished after their deadline
+	long long preemptions;            // Runs cancelled to make room for a higher-priority request, then requeued
+	int queued;                       // Requests currently waiting for an executor
+	double mean_wait_ms;              // Mean time from submission to the first run starting
+	double mean_latency_ms;           // Mean time from submission to completion
+	double max_latency_ms;            // Longest time from submission to completion
+};
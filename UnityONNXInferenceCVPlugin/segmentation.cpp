@@ -0,0 +1,358 @@
+#include "pch.h"
+#include "segmentation.h"
+#include "cpu_features.h"
+#include "half.h"
+#include "mask_encoding.h"
+#include "plugin.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define SEGMENTATION_USE_AVX2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define SEGMENTATION_USE_NEON
+#endif
+
+namespace {
+	const int box_channels = 4;       // Center x, center y, width and height ahead of the class scores
+
+	/// <summary>
+	/// Add a scaled row to an accumulator row: out += a * x.
+	/// </summary>
+	void addScaledRow(float a, const float* x, float* out, int count) {
+		int i = 0;
+#if defined(SEGMENTATION_USE_AVX2)
+		if (cpuHasAvx2()) {
+			const __m256 scale = _mm256_set1_ps(a);
+			for (; i + 8 <= count; i += 8) {
+				__m256 sum = _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(scale, _mm256_loadu_ps(x + i)));
+				_mm256_storeu_ps(out + i, sum);
+			}
+		}
+#elif defined(SEGMENTATION_USE_NEON)
+		const float32x4_t scale = vdupq_n_f32(a);
+		for (; i + 4 <= count; i += 4) vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), scale, vld1q_f32(x + i)));
+#endif
+		for (; i < count; i++) out[i] += a * x[i];
+	}
+
+	/// <summary>
+	/// Interpolate between two rows: out = a + t * (b - a).
+	/// </summary>
+	void lerpRows(const float* a, const float* b, float t, float* out, int count) {
+		int i = 0;
+#if defined(SEGMENTATION_USE_AVX2)
+		if (cpuHasAvx2()) {
+			const __m256 weight = _mm256_set1_ps(t);
+			for (; i + 8 <= count; i += 8) {
+				__m256 va = _mm256_loadu_ps(a + i);
+				_mm256_storeu_ps(out + i, _mm256_add_ps(va, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_loadu_ps(b + i), va))));
+			}
+		}
+#elif defined(SEGMENTATION_USE_NEON)
+		const float32x4_t weight = vdupq_n_f32(t);
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t va = vld1q_f32(a + i);
+			vst1q_f32(out + i, vmlaq_f32(va, weight, vsubq_f32(vld1q_f32(b + i), va)));
+		}
+#endif
+		for (; i < count; i++) out[i] = a[i] + t * (b[i] - a[i]);
+	}
+
+	/// <summary>
+	/// Source sample of one destination pixel when resizing bilinearly with half-pixel centers.
+	/// </summary>
+	void bilinearSource(int destination, float scale, int source_size, int& first, int& second, float& weight) {
+		float position = std::min(std::max((destination + 0.5f) * scale - 0.5f, 0.0f), static_cast<float>(source_size - 1));
+		first = static_cast<int>(position);
+		second = std::min(first + 1, source_size - 1);
+		weight = position - first;
+	}
+
+	/// <summary>
+	/// Get a float view of a tensor, widening float16 data into a thread-local buffer.
+	/// </summary>
+	const float* floatTensorData(OrtValue* tensor, size_t count, std::vector<float>& widened) {
+		OrtTensorTypeAndShapeInfo* shape_info;
+		ort->GetTensorTypeAndShape(tensor, &shape_info);
+		ONNXTensorElementDataType element_type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+		ort->GetTensorElementType(shape_info, &element_type);
+		ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+
+		void* data = nullptr;
+		ort->GetTensorMutableData(tensor, &data);
+		if (element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) return static_cast<const float*>(data);
+		if (element_type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) return nullptr;
+		widened.resize(count);
+		halfToFloat(static_cast<const uint16_t*>(data), widened.data(), count);
+		return widened.data();
+	}
+
+	/// <summary>
+	/// Get a tensor's dimensions.
+	/// </summary>
+	std::vector<int64_t> tensorShape(OrtValue* tensor) {
+		OrtTensorTypeAndShapeInfo* shape_info;
+		ort->GetTensorTypeAndShape(tensor, &shape_info);
+		size_t dim_count = 0;
+		ort->GetDimensionsCount(shape_info, &dim_count);
+		std::vector<int64_t> shape(dim_count);
+		ort->GetDimensions(shape_info, shape.data(), dim_count);
+		ort->ReleaseTensorTypeAndShapeInfo(shape_info);
+		return shape;
+	}
+}
+
+bool decodeYolov8SegOutput(const float* output, int channel_count, int anchor_count, bool anchors_first, int coefficient_count,
+	float score_threshold, std::vector<Detection>& proposals, std::vector<float>& coefficients) {
+	proposals.clear();
+	coefficients.clear();
+	int class_count = channel_count - box_channels - coefficient_count;
+	if (class_count <= 0 || anchor_count <= 0) return false;
+
+	// Strides of the channel and anchor dimensions
+	size_t channel_stride = anchors_first ? 1 : anchor_count;
+	size_t anchor_stride = anchors_first ? channel_count : 1;
+
+	// Best class of every anchor, scanning one class at a time so the exported layout is read contiguously
+	thread_local std::vector<float> best_scores;
+	thread_local std::vector<int32_t> best_classes;
+	best_scores.assign(anchor_count, -INFINITY);
+	best_classes.assign(anchor_count, 0);
+	for (int c = 0; c < class_count; c++) {
+		const float* scores = output + (box_channels + c) * channel_stride;
+		for (int a = 0; a < anchor_count; a++) {
+			float score = scores[a * anchor_stride];
+			if (score > best_scores[a]) {
+				best_scores[a] = score;
+				best_classes[a] = c;
+			}
+		}
+	}
+
+	// Decode the boxes and gather the coefficients of the anchors that pass the threshold
+	for (int a = 0; a < anchor_count; a++) {
+		if (best_scores[a] < score_threshold) continue;
+		const float* anchor = output + a * anchor_stride;
+		Detection detection;
+		detection.width = anchor[2 * channel_stride];
+		detection.height = anchor[3 * channel_stride];
+		detection.x0 = anchor[0] - detection.width * 0.5f;
+		detection.y0 = anchor[channel_stride] - detection.height * 0.5f;
+		detection.score = best_scores[a];
+		detection.class_index = best_classes[a];
+		proposals.push_back(detection);
+
+		const float* anchor_coefficients = anchor + (box_channels + class_count) * channel_stride;
+		for (int k = 0; k < coefficient_count; k++) coefficients.push_back(anchor_coefficients[k * channel_stride]);
+	}
+	return true;
+}
+
+void placeInstanceMask(const Detection& detection, int image_width, int image_height, InstanceMask& mask) {
+	int x0 = std::max(static_cast<int>(std::floor(detection.x0)), 0);
+	int y0 = std::max(static_cast<int>(std::floor(detection.y0)), 0);
+	int x1 = std::min(static_cast<int>(std::ceil(detection.x0 + detection.width)), image_width);
+	int y1 = std::min(static_cast<int>(std::ceil(detection.y0 + detection.height)), image_height);
+
+	mask.detection = detection;
+	mask.x = x0;
+	mask.y = y0;
+	mask.width = std::max(x1 - x0, 0);
+	mask.height = std::max(y1 - y0, 0);
+	mask.row_bytes = (mask.width + 7) / 8;
+}
+
+void assembleInstanceMask(const PrototypeMasks& prototypes, const float* coefficients, int image_width, int image_height,
+	const InstanceMask& mask, float mask_threshold, uint8_t* bits) {
+	if (mask.width <= 0 || mask.height <= 0) return;
+	float scale_x = prototypes.width / static_cast<float>(image_width);
+	float scale_y = prototypes.height / static_cast<float>(image_height);
+
+	// sigmoid(v) > threshold exactly when v > logit(threshold)
+	float logit_threshold = std::log(mask_threshold / (1.0f - mask_threshold));
+
+	// Source columns and weights of each mask column
+	thread_local std::vector<int32_t> first_columns, second_columns;
+	thread_local std::vector<float> column_weights;
+	first_columns.resize(mask.width);
+	second_columns.resize(mask.width);
+	column_weights.resize(mask.width);
+	for (int x = 0; x < mask.width; x++) {
+		bilinearSource(mask.x + x, scale_x, prototypes.width, first_columns[x], second_columns[x], column_weights[x]);
+	}
+
+	// The crop of the prototype grid the mask samples
+	int crop_x0 = first_columns.front();
+	int crop_x1 = second_columns.back() + 1;
+	int crop_y0, crop_y1, unused_row;
+	float unused_weight;
+	bilinearSource(mask.y, scale_y, prototypes.height, crop_y0, unused_row, unused_weight);
+	bilinearSource(mask.y + mask.height - 1, scale_y, prototypes.height, unused_row, crop_y1, unused_weight);
+	crop_y1++;
+	int crop_width = crop_x1 - crop_x0;
+	for (int x = 0; x < mask.width; x++) {
+		first_columns[x] -= crop_x0;
+		second_columns[x] -= crop_x0;
+	}
+
+	// Coefficients x prototypes over the crop only, one row at a time so the accumulator row stays in cache
+	thread_local std::vector<float> logits;
+	logits.assign(static_cast<size_t>(crop_y1 - crop_y0) * crop_width, 0.0f);
+	size_t plane = static_cast<size_t>(prototypes.width) * prototypes.height;
+	for (int row = crop_y0; row < crop_y1; row++) {
+		float* out = logits.data() + static_cast<size_t>(row - crop_y0) * crop_width;
+		const float* source = prototypes.data + static_cast<size_t>(row) * prototypes.width + crop_x0;
+		for (int k = 0; k < prototypes.count; k++) addScaledRow(coefficients[k], source + k * plane, out, crop_width);
+	}
+
+	// Upsample each mask row from two logit rows, then threshold eight pixels into each byte
+	thread_local std::vector<float> row_logits;
+	row_logits.resize(crop_width);
+	for (int y = 0; y < mask.height; y++) {
+		int first_row, second_row;
+		float row_weight;
+		bilinearSource(mask.y + y, scale_y, prototypes.height, first_row, second_row, row_weight);
+		lerpRows(logits.data() + static_cast<size_t>(first_row - crop_y0) * crop_width,
+			logits.data() + static_cast<size_t>(second_row - crop_y0) * crop_width, row_weight, row_logits.data(), crop_width);
+
+		uint8_t* out = bits + static_cast<size_t>(y) * mask.row_bytes;
+		int x = 0;
+#if defined(SEGMENTATION_USE_AVX2)
+		if (cpuHasAvx2()) {
+			const __m256 threshold = _mm256_set1_ps(logit_threshold);
+			for (; x + 8 <= mask.width; x += 8) {
+				__m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first_columns.data() + x));
+				__m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second_columns.data() + x));
+				__m256 a = _mm256_i32gather_ps(row_logits.data(), first, 4);
+				__m256 b = _mm256_i32gather_ps(row_logits.data(), second, 4);
+				__m256 value = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(column_weights.data() + x), _mm256_sub_ps(b, a)));
+				// The sign mask of the comparison holds pixel x + i in bit i
+				out[x / 8] = static_cast<uint8_t>(_mm256_movemask_ps(_mm256_cmp_ps(value, threshold, _CMP_GT_OQ)));
+			}
+		}
+#endif
+		for (; x < mask.width; x += 8) {
+			uint8_t byte = 0;
+			for (int bit = 0; bit < 8 && x + bit < mask.width; bit++) {
+				float a = row_logits[first_columns[x + bit]];
+				float b = row_logits[second_columns[x + bit]];
+				if (a + column_weights[x + bit] * (b - a) > logit_threshold) byte |= static_cast<uint8_t>(1 << bit);
+			}
+			out[x / 8] = byte;
+		}
+	}
+}
+
+extern "C" {
+	/// <summary>
+	/// Run the loaded YOLOv8-seg style instance segmentation model and assemble the masks of the surviving detections
+	/// natively: decode and filter the boxes, then combine the prototype masks with each survivor's coefficients over its
+	/// box only, upsample to image resolution, threshold, and bit-pack or run-length encode. The model's first output holds the detections and
+	/// a later output of shape [1, prototypes, H, W] the prototype masks.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes.</param>
+	/// <param name="options">Score, overlap and mask thresholds, and the detection limit.</param>
+	/// <param name="masks">Receives one entry per detection, by descending score.</param>
+	/// <param name="max_masks">Capacity of masks.</param>
+	/// <param name="mask_bits">Receives the encoded masks, each starting at its entry's offset.</param>
+	/// <param name="mask_bytes">Capacity of mask_bits in bytes.</param>
+	/// <param name="info">Receives the number of detections and the bytes their masks need, or nullptr.</param>
+	/// <returns>The number of masks written, which stops short of the detections when masks or mask_bits is full,
+	/// or -1 if no model is loaded, the run failed, the options are invalid, or the outputs are not YOLOv8-seg outputs.</returns>
+	DLLExport int PerformInferenceInstanceMasks(byte* image_data, const InstanceMaskOptions* options, InstanceMask* masks, int max_masks, uint8_t* mask_bits, int mask_bytes, InstanceMaskInfo* info) {
+		if (!(options->mask_threshold > 0.0f && options->mask_threshold < 1.0f) || options->max_detections < 0) return -1;
+		if (options->encoding < 0 || options->encoding > static_cast<int>(MaskEncoding::Rle)) return -1;
+
+		int written = -1;
+		bool ran = runModel(image_data, [&](const ModelOutput& output) {
+			// The prototypes are the first further output with four dimensions
+			OrtValue* prototype_tensor = nullptr;
+			std::vector<int64_t> prototype_shape;
+			for (OrtValue* tensor : output.extra_tensors) {
+				prototype_shape = tensorShape(tensor);
+				if (prototype_shape.size() == 4 && prototype_shape[0] == 1) {
+					prototype_tensor = tensor;
+					break;
+				}
+			}
+			std::vector<int64_t> detection_shape = tensorShape(output.tensor);
+			if (!prototype_tensor || detection_shape.size() != 3 || detection_shape[0] != 1) return;
+
+			// Exported models put the anchors last; there are far more anchors than channels
+			bool anchors_first = detection_shape[1] > detection_shape[2];
+			int channel_count = static_cast<int>(anchors_first ? detection_shape[2] : detection_shape[1]);
+			int anchor_count = static_cast<int>(anchors_first ? detection_shape[1] : detection_shape[2]);
+
+			PrototypeMasks prototypes;
+			prototypes.count = static_cast<int>(prototype_shape[1]);
+			prototypes.height = static_cast<int>(prototype_shape[2]);
+			prototypes.width = static_cast<int>(prototype_shape[3]);
+			thread_local std::vector<float> widened_prototypes;
+			prototypes.data = floatTensorData(prototype_tensor, static_cast<size_t>(prototypes.count) * prototypes.width * prototypes.height, widened_prototypes);
+			if (!prototypes.data || prototypes.width <= 0 || prototypes.height <= 0) return;
+
+			// Half-precision detections are widened into the request context's scratch buffer
+			const float* detections = static_cast<const float*>(output.data);
+			thread_local std::vector<float> widened_detections;
+			if (output.element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+				float* buffer = output.context->scratch.data();
+				if (output.context->scratch.size() < output.count) {
+					widened_detections.resize(output.count);
+					buffer = widened_detections.data();
+				}
+				halfToFloat(static_cast<const uint16_t*>(output.data), buffer, output.count);
+				detections = buffer;
+			}
+
+			thread_local std::vector<Detection> proposals;
+			thread_local std::vector<float> coefficients;
+			thread_local std::vector<size_t> kept;
+			if (!decodeYolov8SegOutput(detections, channel_count, anchor_count, anchors_first, prototypes.count,
+				options->score_threshold, proposals, coefficients)) return;
+			nonMaxSuppressionIndices(proposals, options->iou_threshold, kept);
+			if (kept.size() > static_cast<size_t>(options->max_detections)) kept.resize(options->max_detections);
+
+			// Assemble masks only for the survivors, until either buffer is full. Bit-packed masks are assembled in place,
+			// and masks that no longer fit are only measured; run lengths are encoded from a staging buffer, since their
+			// size is known only afterwards
+			MaskEncoding encoding = static_cast<MaskEncoding>(options->encoding);
+			thread_local std::vector<uint8_t> staged_bits, encoded;
+			int count = 0;
+			long long needed_bytes = 0;
+			bool full = false;
+			for (size_t index : kept) {
+				InstanceMask mask;
+				placeInstanceMask(proposals[index], output.input_w, output.input_h, mask);
+				const float* mask_coefficients = coefficients.data() + index * prototypes.count;
+				long long bit_bytes = static_cast<long long>(mask.row_bytes) * mask.height;
+				long long size = bit_bytes;
+				if (encoding == MaskEncoding::Rle) {
+					staged_bits.resize(static_cast<size_t>(bit_bytes));
+					assembleInstanceMask(prototypes, mask_coefficients, output.input_w, output.input_h, mask, options->mask_threshold, staged_bits.data());
+					encoded.clear();
+					size = static_cast<long long>(encodeMaskRle(staged_bits.data(), mask.width, mask.height, mask.row_bytes, encoded));
+					mask.row_bytes = 0;
+				}
+
+				full = full || count >= max_masks || needed_bytes + size > mask_bytes;
+				if (!full) {
+					mask.offset = static_cast<int32_t>(needed_bytes);
+					mask.size = static_cast<int32_t>(size);
+					if (encoding == MaskEncoding::Rle) std::memcpy(mask_bits + needed_bytes, encoded.data(), encoded.size());
+					else assembleInstanceMask(prototypes, mask_coefficients, output.input_w, output.input_h, mask, options->mask_threshold, mask_bits + needed_bytes);
+					masks[count++] = mask;
+				}
+				needed_bytes += size;
+			}
+
+			if (info) *info = { static_cast<int>(kept.size()), static_cast<int>(needed_bytes) };
+			written = count;
+		}, true);
+		return ran ? written : -1;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "detections.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Settings for PerformInferenceInstanceMasks.
+/// </summary>
+struct InstanceMaskOptions {
+	float score_threshold;            // Minimum class score of a detection
+	float iou_threshold;              // Boxes overlapping a higher-scoring box by more than this are removed
+	float mask_threshold;             // Mask probability above which a pixel belongs to the instance, between 0 and 1 exclusive
+	int max_detections;               // Most detections to keep, highest scores first
+	int encoding;                     // MaskEncoding of the returned masks
+};
+
+/// <summary>
+/// One detected instance and where its mask is stored. Masks cover only the bounding box, clipped to the image.
+/// </summary>
+struct InstanceMask {
+	Detection detection;              // Bounding box, score and class, in input image pixels
+	int32_t x;                        // Left edge of the mask, in input image pixels
+	int32_t y;                        // Top edge of the mask
+	int32_t width;                    // Width of the mask in pixels
+	int32_t height;                   // Height of the mask in pixels
+	int32_t offset;                   // Byte offset of the mask in the mask buffer
+	int32_t size;                     // Bytes of the encoded mask
+	int32_t row_bytes;                // Bytes per row of bit-packed masks: one bit per pixel, least significant bit first, rows padded to a byte
+};
+
+/// <summary>
+/// Totals for one call of PerformInferenceInstanceMasks, so callers can size their buffers.
+/// </summary>
+struct InstanceMaskInfo {
+	int detections;                   // Detections left after NMS and max_detections
+	int mask_bytes;                   // Bytes the encoded masks of all those detections need
+};
+
+/// <summary>
+/// Planar (CHW) prototype masks of a segmentation model, which each instance's coefficients combine into its mask.
+/// </summary>
+struct PrototypeMasks {
+	const float* data;
+	int count;                        // Number of prototypes, and of coefficients per detection
+	int width;                        // Width of each prototype
+	int height;                       // Height of each prototype
+};
+
+/// <summary>
+/// Decode raw YOLOv8-seg detection output into proposals above a score threshold. Each anchor has
+/// (center x, center y, width, height, class scores..., mask coefficients...) in input image pixels.
+/// </summary>
+/// <param name="output">Model output for one image.</param>
+/// <param name="channel_count">Number of values per anchor.</param>
+/// <param name="anchor_count">Number of anchors.</param>
+/// <param name="anchors_first">False for the exported [channels, anchors] layout, true for [anchors, channels].</param>
+/// <param name="coefficient_count">Number of mask coefficients per anchor, the prototype count.</param>
+/// <param name="score_threshold">Minimum score of a proposal.</param>
+/// <param name="proposals">Receives the proposals, replacing its contents.</param>
+/// <param name="coefficients">Receives coefficient_count coefficients per proposal, replacing its contents.</param>
+/// <returns>False if the output has no room for class scores besides the box and coefficients.</returns>
+bool decodeYolov8SegOutput(const float* output, int channel_count, int anchor_count, bool anchors_first, int coefficient_count,
+	float score_threshold, std::vector<Detection>& proposals, std::vector<float>& coefficients);
+
+/// <summary>
+/// Place an instance's mask: its bounding box clipped to the image, and the packed row size.
+/// Leaves offset and size untouched.
+/// </summary>
+/// <param name="detection">The instance.</param>
+/// <param name="image_width">Width of the input image.</param>
+/// <param name="image_height">Height of the input image.</param>
+/// <param name="mask">Receives detection, x, y, width, height and row_bytes.</param>
+void placeInstanceMask(const Detection& detection, int image_width, int image_height, InstanceMask& mask);
+
+/// <summary>
+/// Assemble one instance's binary mask: combine the prototypes under the mask with the instance's coefficients,
+/// upsample the result bilinearly to image resolution and threshold it. Only the cropped region is computed, and the
+/// threshold is applied to the logits, so no sigmoid is evaluated.
+/// </summary>
+/// <param name="prototypes">The model's prototype masks, covering the whole input image.</param>
+/// <param name="coefficients">The instance's prototypes.count coefficients.</param>
+/// <param name="image_width">Width of the input image.</param>
+/// <param name="image_height">Height of the input image.</param>
+/// <param name="mask">The mask's placement, from placeInstanceMask.</param>
+/// <param name="mask_threshold">Mask probability above which a pixel is set, between 0 and 1 exclusive.</param>
+/// <param name="bits">Receives height rows of row_bytes bytes.</param>
+void assembleInstanceMask(const PrototypeMasks& prototypes, const float* coefficients, int image_width, int image_height,
+	const InstanceMask& mask, float mask_threshold, uint8_t* bits);
@@ -0,0 +1,419 @@
+#include "pch.h"
+#include "plugin.h"
+#include "inference_server.h"
+#include "server_client.h"
+#include <winsock2.h>
+#include <afunix.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace {
+	/// <summary>
+	/// Progress of a frame submitted to the server.
+	/// </summary>
+	enum class SlotState {
+		Free,
+		Writing,                      // Lent out by BeginFrame for the caller to fill
+		Submitted,                    // Waiting for the server's Done message
+		Done,
+		Failed
+	};
+
+	/// <summary>
+	/// Receive exactly size bytes from a socket.
+	/// </summary>
+	bool receiveAll(SOCKET socket, void* buffer, int size) {
+		char* bytes = static_cast<char*>(buffer);
+		while (size > 0) {
+			int received = recv(socket, bytes, size, 0);
+			if (received <= 0) return false;
+			bytes += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Connect a socket, giving up after timeout_ms. The socket is left in blocking mode.
+	/// </summary>
+	bool connectWithTimeout(SOCKET socket, const SOCKADDR_UN& address, int timeout_ms) {
+		u_long non_blocking = 1;
+		if (ioctlsocket(socket, FIONBIO, &non_blocking) == SOCKET_ERROR) return false;
+		if (connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+			if (WSAGetLastError() != WSAEWOULDBLOCK) return false;
+
+			// Winsock reports a completed connect as writable and a failed one as an exception
+			fd_set writable, failed;
+			FD_ZERO(&writable);
+			FD_ZERO(&failed);
+			FD_SET(socket, &writable);
+			FD_SET(socket, &failed);
+			timeval wait = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+			if (select(0, nullptr, &writable, &failed, &wait) <= 0 || FD_ISSET(socket, &failed)) return false;
+		}
+		non_blocking = 0;
+		return ioctlsocket(socket, FIONBIO, &non_blocking) != SOCKET_ERROR;
+	}
+
+	/// <summary>
+	/// Set how long recv may block on a socket, or 0 to block indefinitely.
+	/// </summary>
+	bool setReceiveTimeout(SOCKET socket, int timeout_ms) {
+		DWORD timeout = static_cast<DWORD>(timeout_ms);
+		return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) != SOCKET_ERROR;
+	}
+
+	/// <summary>
+	/// Connection to an inference server process. Frames are exchanged through a shared-memory section
+	/// and slots are signaled over the control socket, so a crash or stall in the server only fails
+	/// the frames in flight.
+	/// </summary>
+	class InferenceServerClient {
+	public:
+		~InferenceServerClient() {
+			// Runs when the plugin is unloaded or the process exits, under the loader lock, where joining the receiver
+			// would deadlock. Unblock it and let it go rather than let a joinable std::thread terminate the process
+			if (server != INVALID_SOCKET) shutdown(server, SD_BOTH);
+			if (receiver.joinable()) receiver.detach();
+		}
+
+		/// <summary>
+		/// Connect to a server and map the shared-memory section it created for this client.
+		/// The connection and handshake are bounded by the same timeout as frames.
+		/// </summary>
+		bool Connect(const std::string& socket_path, int timeout_ms) {
+			Disconnect();
+			if (timeout_ms <= 0) timeout_ms = 1000;
+
+			WSADATA wsa_data;
+			if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) return false;
+			wsa_started = true;
+
+			SOCKADDR_UN address = {};
+			address.sun_family = AF_UNIX;
+			if (socket_path.size() >= sizeof(address.sun_path)) return fail();
+			std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+			server = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (server == INVALID_SOCKET) return fail();
+			if (!connectWithTimeout(server, address, timeout_ms) || !setReceiveTimeout(server, timeout_ms)) return fail();
+			if (!receiveAll(server, &info, sizeof(info)) || info.version != server_protocol_version) return fail();
+
+			// Done messages may be far apart; EndFrame detects stalls on its own
+			if (!setReceiveTimeout(server, 0)) return fail();
+
+			// Map the section the server created for this connection
+			info.mapping_name[sizeof(info.mapping_name) - 1] = '\0';
+			mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, info.mapping_name);
+			if (!mapping) return fail();
+			view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+			if (!view) return fail();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slots.assign(info.slot_count, SlotState::Free);
+				server_ns.assign(info.slot_count, 0);
+				connected = true;
+				timeout = std::chrono::milliseconds(timeout_ms);
+			}
+			receiver = std::thread(&InferenceServerClient::receiveLoop, this);
+			return true;
+		}
+
+		/// <summary>
+		/// Close the connection, failing any frames in flight, and unmap the shared memory.
+		/// </summary>
+		void Disconnect() {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				connected = false;
+				changed.notify_all();
+
+				// Callers may still be copying out of the section
+				changed.wait(lock, [this]() { return active_calls == 0; });
+			}
+			if (server != INVALID_SOCKET) shutdown(server, SD_BOTH);
+			if (receiver.joinable()) receiver.join();
+			fail();
+		}
+
+		bool IsConnected() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return connected;
+		}
+
+		void GetImageDims(int image_dims[2]) {
+			image_dims[0] = info.image_dims[0];
+			image_dims[1] = info.image_dims[1];
+		}
+
+		/// <summary>
+		/// Lend out a free slot's image area for the caller to write a frame into.
+		/// </summary>
+		/// <returns>The image area, or nullptr if not connected.</returns>
+		uint8_t* BeginFrame(int* slot) {
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this]() { return !connected || std::find(slots.begin(), slots.end(), SlotState::Free) != slots.end(); });
+			if (!connected) return nullptr;
+
+			*slot = static_cast<int>(std::find(slots.begin(), slots.end(), SlotState::Free) - slots.begin());
+			slots[*slot] = SlotState::Writing;
+			active_calls++;
+			return view + serverSlotImageOffset(info, *slot);
+		}
+
+		/// <summary>
+		/// Submit a slot filled after BeginFrame, wait for the server, and copy the output out.
+		/// The slot is returned to the pool whether or not the frame succeeds.
+		/// </summary>
+		bool EndFrame(int slot, float* output_array, int length) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (slot < 0 || slot >= static_cast<int>(slots.size()) || slots[slot] != SlotState::Writing) return false;
+			}
+			length = std::max(0, std::min(length, static_cast<int>(info.output_floats)));
+
+			auto start = std::chrono::steady_clock::now();
+			bool succeeded = submit(slot, length);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			if (succeeded) {
+				if (!changed.wait_for(lock, timeout, [&]() { return !connected || slots[slot] == SlotState::Done || slots[slot] == SlotState::Failed; })) {
+					// Treat a stalled server like a crashed one; the slot may still be written, so drop the connection
+					markBroken();
+				}
+				succeeded = slots[slot] == SlotState::Done;
+			}
+			auto end = std::chrono::steady_clock::now();
+
+			if (succeeded) {
+				const float* output = reinterpret_cast<const float*>(view + serverSlotOutputOffset(info, slot));
+				std::copy(output, output + length, output_array);
+				recordFrame(std::chrono::duration<double, std::milli>(end - start).count(), server_ns[slot] / 1e6);
+			}
+			else {
+				failures++;
+			}
+
+			slots[slot] = SlotState::Free;
+			active_calls--;
+			changed.notify_all();
+			return succeeded;
+		}
+
+		InferenceServerStats GetStats() {
+			std::lock_guard<std::mutex> lock(mutex);
+			InferenceServerStats stats = {};
+			stats.frames = frames;
+			stats.failures = failures;
+			if (frames > 0) {
+				stats.mean_round_trip_ms = total_round_trip_ms / frames;
+				stats.mean_server_ms = total_server_ms / frames;
+				stats.mean_overhead_ms = (total_round_trip_ms - total_server_ms) / frames;
+				stats.max_overhead_ms = max_overhead_ms;
+			}
+			return stats;
+		}
+
+		void ResetStats() {
+			std::lock_guard<std::mutex> lock(mutex);
+			frames = 0;
+			failures = 0;
+			total_round_trip_ms = 0.0;
+			total_server_ms = 0.0;
+			max_overhead_ms = 0.0;
+		}
+
+	private:
+		/// <summary>
+		/// Send a Submit message for a slot.
+		/// </summary>
+		bool submit(int slot, int length) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!connected) return false;
+				slots[slot] = SlotState::Submitted;
+			}
+
+			ServerMessage message = {};
+			message.type = ServerMessageType::Submit;
+			message.slot = static_cast<uint32_t>(slot);
+			message.length = length;
+
+			std::lock_guard<std::mutex> lock(send_mutex);
+			return send(server, reinterpret_cast<const char*>(&message), sizeof(message), 0) == sizeof(message);
+		}
+
+		/// <summary>
+		/// Mark submitted slots as done as the server's replies arrive.
+		/// </summary>
+		void receiveLoop() {
+			ServerMessage message;
+			while (receiveAll(server, &message, sizeof(message))) {
+				if (message.type != ServerMessageType::Done || message.slot >= info.slot_count) break;
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (slots[message.slot] != SlotState::Submitted) continue;
+				slots[message.slot] = message.status ? SlotState::Done : SlotState::Failed;
+				server_ns[message.slot] = message.server_ns;
+				changed.notify_all();
+			}
+
+			// The server exited, crashed or sent garbage
+			std::lock_guard<std::mutex> lock(mutex);
+			connected = false;
+			changed.notify_all();
+		}
+
+		/// <summary>
+		/// Stop using the connection after a stall. The caller holds the mutex.
+		/// </summary>
+		void markBroken() {
+			connected = false;
+			if (server != INVALID_SOCKET) shutdown(server, SD_BOTH);
+			changed.notify_all();
+		}
+
+		/// <summary>
+		/// Accumulate one frame's timings. The caller holds the mutex.
+		/// </summary>
+		void recordFrame(double round_trip_ms, double frame_server_ms) {
+			frames++;
+			total_round_trip_ms += round_trip_ms;
+			total_server_ms += frame_server_ms;
+			max_overhead_ms = std::max(max_overhead_ms, round_trip_ms - frame_server_ms);
+		}
+
+		/// <summary>
+		/// Release the socket and section.
+		/// </summary>
+		/// <returns>False, for use in failed connection attempts.</returns>
+		bool fail() {
+			if (view) UnmapViewOfFile(view);
+			if (mapping) CloseHandle(mapping);
+			if (server != INVALID_SOCKET) closesocket(server);
+			if (wsa_started) WSACleanup();
+			view = nullptr;
+			mapping = nullptr;
+			server = INVALID_SOCKET;
+			wsa_started = false;
+			return false;
+		}
+
+		SOCKET server = INVALID_SOCKET;   // Control socket
+		HANDLE mapping = nullptr;         // Shared-memory section created by the server
+		uint8_t* view = nullptr;          // The section mapped into this process
+		ServerInfo info = {};
+		bool wsa_started = false;
+		std::thread receiver;             // Reads Done messages from the server
+
+		std::mutex mutex;                 // Guards the slot states, connection flag and statistics
+		std::mutex send_mutex;            // Serializes Submit messages from concurrent callers
+		std::condition_variable changed;  // Signaled when a slot changes state or the connection drops
+		std::vector<SlotState> slots;
+		std::vector<uint64_t> server_ns;  // Server time reported for each slot's last frame
+		bool connected = false;
+		int active_calls = 0;             // Slots lent out to callers
+		std::chrono::milliseconds timeout{ 1000 };
+
+		long long frames = 0;
+		long long failures = 0;
+		double total_round_trip_ms = 0.0;
+		double total_server_ms = 0.0;
+		double max_overhead_ms = 0.0;
+	};
+
+	InferenceServerClient server_client;
+}
+
+extern "C" {
+	/// <summary>
+	/// Connect to a running UnityONNXInferenceServer process.
+	/// </summary>
+	/// <param name="socket_path">Path of the server's control socket.</param>
+	/// <param name="timeout_ms">How long to wait for a frame before treating the server as stalled.</param>
+	/// <param name="image_dims">Receives the image dimensions [width, height] the server's model was loaded with.</param>
+	/// <returns>1 if connected, 0 otherwise.</returns>
+	DLLExport int ConnectInferenceServer(const char* socket_path, int timeout_ms, int image_dims[2]) {
+		if (!server_client.Connect(socket_path, timeout_ms)) return 0;
+		server_client.GetImageDims(image_dims);
+		return 1;
+	}
+
+	/// <summary>
+	/// Disconnect from the inference server. Frames in flight fail.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void DisconnectInferenceServer() {
+		server_client.Disconnect();
+	}
+
+	/// <summary>
+	/// Check whether the server connection is still usable. It drops when the server exits, crashes or stalls.
+	/// </summary>
+	/// <returns>1 if connected, 0 otherwise.</returns>
+	DLLExport int IsInferenceServerConnected() {
+		return server_client.IsConnected() ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Borrow a shared-memory slot to write a frame into directly, avoiding a copy of the image.
+	/// Every successful call must be followed by EndRemoteFrame.
+	/// </summary>
+	/// <param name="slot">Receives the slot to pass to EndRemoteFrame.</param>
+	/// <returns>The slot's image area of width * height * 3 bytes, or nullptr if not connected.</returns>
+	DLLExport byte* BeginRemoteFrame(int* slot) {
+		return server_client.BeginFrame(slot);
+	}
+
+	/// <summary>
+	/// Run the frame written after BeginRemoteFrame on the server and copy out its output.
+	/// </summary>
+	/// <param name="slot">The slot returned by BeginRemoteFrame.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns>1 on success, 0 if the server disconnected, stalled or rejected the frame.</returns>
+	DLLExport int EndRemoteFrame(int slot, float* output_array, int length) {
+		return server_client.EndFrame(slot, output_array, length) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Perform inference on the inference server, like PerformInference. Safe to call from multiple threads.
+	/// </summary>
+	/// <param name="image_data">Raw image data as bytes, matching the server's image dimensions.</param>
+	/// <param name="output_array">Array to store the inferred results.</param>
+	/// <param name="length">Length of the output_array.</param>
+	/// <returns>1 on success, 0 on failure, e.g., to fall back to a locally loaded model.</returns>
+	DLLExport int PerformInferenceRemote(byte* image_data, float* output_array, int length) {
+		int slot;
+		byte* frame = server_client.BeginFrame(&slot);
+		if (!frame) return 0;
+
+		int image_dims[2];
+		server_client.GetImageDims(image_dims);
+		std::memcpy(frame, image_data, static_cast<size_t>(image_dims[0]) * image_dims[1] * n_channels);
+		return server_client.EndFrame(slot, output_array, length) ? 1 : 0;
+	}
+
+	/// <summary>
+	/// Get round-trip statistics for frames run on the inference server.
+	/// </summary>
+	/// <param name="stats">Receives the statistics.</param>
+	/// <returns></returns>
+	DLLExport void GetInferenceServerStats(InferenceServerStats* stats) {
+		*stats = server_client.GetStats();
+	}
+
+	/// <summary>
+	/// Reset the inference server statistics.
+	/// </summary>
+	/// <returns></returns>
+	DLLExport void ResetInferenceServerStats() {
+		server_client.ResetStats();
+	}
+}
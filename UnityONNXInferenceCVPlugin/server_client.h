@@ -0,0 +1,13 @@
+#pragma once
+
+/// <summary>
+/// Round-trip statistics for frames run on the inference server.
+/// </summary>
+struct InferenceServerStats {
+	long long frames;                 // Frames that completed successfully
+	long long failures;               // Frames that failed because the server disconnected, stalled or rejected them
+	double mean_round_trip_ms;        // Mean time from submitting a frame to its output being ready
+	double mean_server_ms;            // Mean time the server spent running a frame
+	double mean_overhead_ms;          // Mean round trip minus server time: signaling, scheduling and wake-up latency
+	double max_overhead_ms;           // Largest overhead of any frame
+};
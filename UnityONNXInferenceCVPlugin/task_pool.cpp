@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "task_pool.h"
+#include "affinity.h"
+#include <objbase.h>
+#include <algorithm>
+
+namespace {
+	// Identifies the pool and deque of the worker running on the current thread
+	thread_local TaskPool* current_pool = nullptr;
+	thread_local int current_worker = -1;
+}
+
+TaskPool::TaskPool(int worker_count, std::function<void()> thread_init) {
+	if (worker_count <= 0) worker_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	for (int i = 0; i < worker_count; i++) queues.push_back(std::make_unique<WorkerQueue>());
+	for (int i = 0; i < worker_count; i++) workers.emplace_back(&TaskPool::workerLoop, this, i, thread_init);
+}
+
+TaskPool::~TaskPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (std::thread& worker : workers) worker.join();
+}
+
+void TaskPool::Submit(std::function<void()> task) {
+	// Workers keep their own tasks local; other threads spread theirs over the deques
+	int queue = (current_pool == this) ? current_worker : static_cast<int>(next_queue++ % queues.size());
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->tasks.push_back(std::move(task));
+	}
+	pending++;
+
+	// Taking the lock orders the increment before a sleeping worker's check of pending
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	work_available.notify_one();
+}
+
+bool TaskPool::popLocal(int worker, std::function<void()>& task) {
+	WorkerQueue& queue = *queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) return false;
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	pending--;
+	return true;
+}
+
+bool TaskPool::steal(int thief, std::function<void()>& task) {
+	// Start after the thief's own deque so steals spread over the victims
+	int count = static_cast<int>(queues.size());
+	for (int offset = 1; offset <= count; offset++) {
+		int victim = (thief + offset) % count;
+		if (victim == thief) continue;
+		WorkerQueue& queue = *queues[victim];
+		std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || queue.tasks.empty()) continue;
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		pending--;
+		steals++;
+		return true;
+	}
+	return false;
+}
+
+bool TaskPool::TryRunOne() {
+	std::function<void()> task;
+	bool found = (current_pool == this) ? popLocal(current_worker, task) || steal(current_worker, task) : steal(-1, task);
+	if (!found) return false;
+	task();
+	return true;
+}
+
+void TaskPool::workerLoop(int worker, std::function<void()> thread_init) {
+	current_pool = this;
+	current_worker = worker;
+	if (thread_init) thread_init();
+
+	std::function<void()> task;
+	while (true) {
+		if (popLocal(worker, task) || steal(worker, task)) {
+			// Pick up the worker options of a model loaded since the pool started
+			refreshWorkerThread();
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		// Sleep until a task is queued; a steal that lost a try_lock race is retried on wake-up
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		work_available.wait(lock, [this]() { return stopping || pending > 0; });
+		if (stopping && pending == 0) return;
+	}
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		remaining++;
+	}
+	pool.Submit([this, task = std::move(task)]() {
+		task();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--remaining == 0) finished.notify_all();
+	});
+}
+
+void TaskGroup::Wait() {
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (remaining == 0) return;
+		}
+		// Help with queued work; once nothing is left to take, the group's tasks are all running elsewhere
+		if (!pool.TryRunOne()) {
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [this]() { return remaining == 0; });
+			return;
+		}
+	}
+}
+
+TaskPool& sharedTaskPool() {
+	// Never destroyed: joining threads from a static destructor would deadlock on the loader lock at DLL unload
+	static TaskPool* pool = new TaskPool(0, []() {
+		initWorkerThread();
+		CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	});
+	return *pool;
+}
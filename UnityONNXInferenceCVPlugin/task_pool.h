@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Work-stealing thread pool for the small, uneven tasks of pre- and postprocessing.
+/// Each worker owns a deque: tasks a worker submits go to the back of its own deque and it runs them
+/// newest first, while idle workers steal the oldest tasks from the front of other deques. Tasks
+/// submitted from other threads are spread round-robin over the deques.
+/// </summary>
+class TaskPool {
+public:
+	/// <param name="worker_count">Number of worker threads, or 0 for one per logical processor.</param>
+	/// <param name="thread_init">Called on each worker thread before it runs any task, or empty.</param>
+	explicit TaskPool(int worker_count, std::function<void()> thread_init = std::function<void()>());
+	~TaskPool();
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	/// <summary>
+	/// Queue a task. Must not be called after the pool starts shutting down.
+	/// </summary>
+	void Submit(std::function<void()> task);
+
+	/// <summary>
+	/// Run one queued task on the calling thread, taking it from the caller's own deque if it is a worker
+	/// and stealing otherwise.
+	/// </summary>
+	/// <returns>False if no task was queued.</returns>
+	bool TryRunOne();
+
+	int WorkerCount() const { return static_cast<int>(workers.size()); }
+
+	/// <summary>
+	/// Number of tasks taken from another worker's deque since the pool started.
+	/// </summary>
+	long long StealCount() const { return steals; }
+
+private:
+	// Padded to a cache line so workers touching neighbouring deques do not contend
+	struct alignas(64) WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	bool popLocal(int worker, std::function<void()>& task);
+	bool steal(int thief, std::function<void()>& task);
+	void workerLoop(int worker, std::function<void()> thread_init);
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<int> pending{ 0 };        // Tasks queued in any deque
+	std::atomic<unsigned> next_queue{ 0 }; // Round-robin position for external submissions
+	std::atomic<long long> steals{ 0 };
+	std::mutex sleep_mutex;
+	std::condition_variable work_available;
+	bool stopping = false;
+};
+
+/// <summary>
+/// Tracks a set of tasks submitted to a pool so the caller can wait for all of them.
+/// Waiting threads run queued tasks instead of blocking, so groups may be nested inside tasks.
+/// </summary>
+class TaskGroup {
+public:
+	explicit TaskGroup(TaskPool& pool) : pool(pool) {}
+	~TaskGroup() { Wait(); }
+
+	void Run(std::function<void()> task);
+
+	/// <summary>
+	/// Wait for every task run through the group, helping with queued work in the meantime.
+	/// </summary>
+	void Wait();
+
+private:
+	TaskPool& pool;
+	std::mutex mutex;
+	std::condition_variable finished;
+	int remaining = 0;
+};
+
+/// <summary>
+/// The plugin's shared task pool, created on first use with one worker per logical processor.
+/// Workers are prepared with initWorkerThread and joined to the COM multithreaded apartment for image decoding,
+/// and reapply the worker load options before each task once a different model is loaded.
+/// </summary>
+TaskPool& sharedTaskPool();
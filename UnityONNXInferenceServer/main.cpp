@@ -0,0 +1,282 @@
+// UnityONNXInferenceServer: hosts a model loaded with the plugin in a separate process and serves frames
+// to plugin clients through per-client shared-memory slots and an AF_UNIX control socket.
+
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include "inference_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#pragma comment(lib, "ws2_32.lib")
+
+// Entry points imported from UnityONNXInferenceCVPlugin.dll
+extern "C" {
+	__declspec(dllimport) void InitOrtAPI();
+	__declspec(dllimport) const char* LoadModelWithOptions(const char* model_path, const char* execution_provider, int image_dims[2], const char* options);
+	__declspec(dllimport) void PerformInference(uint8_t* image_data, float* output_array, int length);
+	__declspec(dllimport) void FreeResources();
+}
+
+namespace {
+	/// <summary>
+	/// Command-line settings.
+	/// </summary>
+	struct ServerOptions {
+		std::string model_path;
+		std::string execution_provider;
+		int image_dims[2] = { 0, 0 };
+		std::string load_options;         // Passed to LoadModelWithOptions
+		std::string socket_path;          // Control socket path
+		int slot_count = 4;               // Shared-memory slots per client, and frames each client may have in flight
+		int output_floats = 1 << 20;      // Output capacity of each slot
+	};
+
+	std::atomic<bool> stopping{ false };
+	SOCKET listener = INVALID_SOCKET;
+
+	// Connected clients, so their sockets can be shut down on exit
+	std::mutex clients_mutex;
+	std::list<SOCKET> client_sockets;
+
+	/// <summary>
+	/// Print usage information.
+	/// </summary>
+	void printUsage() {
+		std::printf(
+			"Usage: UnityONNXInferenceServer <model_path> <execution_provider> <width> <height> [options]\n"
+			"  --options <string>    Load options passed to LoadModelWithOptions, e.g., \"pool_size=4\"\n"
+			"  --socket <path>       Control socket path (default: %%TEMP%%\\%s)\n"
+			"  --slots <n>           Frames each client may have in flight (default: 4)\n"
+			"  --max-output <n>      Largest output length, in floats, a client may request (default: 1048576)\n",
+			default_server_socket_name);
+	}
+
+	/// <summary>
+	/// Parse the command line.
+	/// </summary>
+	/// <returns>False if the arguments are incomplete or malformed.</returns>
+	bool parseArguments(int argc, char** argv, ServerOptions& options) {
+		if (argc < 5) return false;
+		options.model_path = argv[1];
+		options.execution_provider = argv[2];
+		options.image_dims[0] = std::atoi(argv[3]);
+		options.image_dims[1] = std::atoi(argv[4]);
+		if (options.image_dims[0] <= 0 || options.image_dims[1] <= 0) return false;
+
+		char temp_path[MAX_PATH];
+		GetTempPathA(MAX_PATH, temp_path);
+		options.socket_path = std::string(temp_path) + default_server_socket_name;
+
+		for (int i = 5; i + 1 < argc; i += 2) {
+			std::string key = argv[i];
+			const char* value = argv[i + 1];
+			if (key == "--options") options.load_options = value;
+			else if (key == "--socket") options.socket_path = value;
+			else if (key == "--slots") options.slot_count = std::atoi(value);
+			else if (key == "--max-output") options.output_floats = std::atoi(value);
+			else return false;
+		}
+		return options.slot_count > 0 && options.output_floats > 0 && (argc - 5) % 2 == 0;
+	}
+
+	/// <summary>
+	/// Receive exactly size bytes from a socket.
+	/// </summary>
+	bool receiveAll(SOCKET socket, void* buffer, int size) {
+		char* bytes = static_cast<char*>(buffer);
+		while (size > 0) {
+			int received = recv(socket, bytes, size, 0);
+			if (received <= 0) return false;
+			bytes += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Serve one client until it disconnects: create its shared-memory section, then run the frames it
+	/// submits on slot_count worker threads so it can keep several frames in flight.
+	/// </summary>
+	void serveClient(SOCKET client, int client_id, const ServerOptions& options) {
+		ServerInfo info = {};
+		info.version = server_protocol_version;
+		info.image_dims[0] = options.image_dims[0];
+		info.image_dims[1] = options.image_dims[1];
+		info.slot_count = options.slot_count;
+		info.image_bytes = static_cast<uint64_t>(options.image_dims[0]) * options.image_dims[1] * 3;
+		info.output_floats = options.output_floats;
+		std::snprintf(info.mapping_name, sizeof(info.mapping_name), "Local\\UnityONNXInferenceServer-%lu-%d", GetCurrentProcessId(), client_id);
+
+		// Pagefile-backed section shared with the client
+		uint64_t section_bytes = serverSlotStride(info) * info.slot_count;
+		HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(section_bytes >> 32), static_cast<DWORD>(section_bytes), info.mapping_name);
+		uint8_t* view = mapping ? static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)) : nullptr;
+		if (!view || send(client, reinterpret_cast<const char*>(&info), sizeof(info), 0) != sizeof(info)) {
+			std::printf("Client %d: failed to set up shared memory\n", client_id);
+			if (view) UnmapViewOfFile(view);
+			if (mapping) CloseHandle(mapping);
+			closesocket(client);
+			return;
+		}
+		std::printf("Client %d connected\n", client_id);
+
+		// Submitted frames waiting for a worker
+		std::mutex queue_mutex;
+		std::condition_variable queue_changed;
+		std::deque<ServerMessage> queue;
+		bool closing = false;
+
+		std::mutex send_mutex;
+		std::atomic<long long> frames{ 0 };
+		std::atomic<long long> total_ns{ 0 };
+
+		std::vector<std::thread> workers;
+		for (uint32_t w = 0; w < info.slot_count; w++) {
+			workers.emplace_back([&]() {
+				while (true) {
+					ServerMessage request;
+					{
+						std::unique_lock<std::mutex> lock(queue_mutex);
+						queue_changed.wait(lock, [&]() { return closing || !queue.empty(); });
+						if (queue.empty()) return;
+						request = queue.front();
+						queue.pop_front();
+					}
+
+					ServerMessage reply = {};
+					reply.type = ServerMessageType::Done;
+					reply.slot = request.slot;
+
+					// Run the frame directly on the shared memory
+					bool valid = request.slot < info.slot_count && request.length >= 0 && static_cast<uint64_t>(request.length) <= info.output_floats;
+					if (valid) {
+						auto start = std::chrono::steady_clock::now();
+						PerformInference(view + serverSlotImageOffset(info, request.slot),
+							reinterpret_cast<float*>(view + serverSlotOutputOffset(info, request.slot)), request.length);
+						reply.server_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+						reply.status = 1;
+						frames++;
+						total_ns += reply.server_ns;
+					}
+
+					std::lock_guard<std::mutex> lock(send_mutex);
+					send(client, reinterpret_cast<const char*>(&reply), sizeof(reply), 0);
+				}
+			});
+		}
+
+		// Queue submissions until the client disconnects
+		ServerMessage message;
+		while (receiveAll(client, &message, sizeof(message)) && message.type == ServerMessageType::Submit) {
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex);
+				queue.push_back(message);
+			}
+			queue_changed.notify_one();
+		}
+
+		// Finish the frames already submitted before releasing the section
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			closing = true;
+		}
+		queue_changed.notify_all();
+		for (std::thread& worker : workers) worker.join();
+
+		UnmapViewOfFile(view);
+		CloseHandle(mapping);
+		{
+			std::lock_guard<std::mutex> lock(clients_mutex);
+			client_sockets.remove(client);
+		}
+		closesocket(client);
+
+		double mean_ms = frames > 0 ? total_ns / 1e6 / frames : 0.0;
+		std::printf("Client %d disconnected after %lld frames (mean run %.3f ms)\n", client_id, frames.load(), mean_ms);
+	}
+
+	/// <summary>
+	/// Stop accepting clients on Ctrl+C or when the console closes.
+	/// </summary>
+	BOOL WINAPI consoleHandler(DWORD) {
+		stopping = true;
+		closesocket(listener);
+		return TRUE;
+	}
+}
+
+int main(int argc, char** argv) {
+	ServerOptions options;
+	if (!parseArguments(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+
+	// Load the model through the plugin
+	InitOrtAPI();
+	std::string load_message = LoadModelWithOptions(options.model_path.c_str(), options.execution_provider.c_str(), options.image_dims, options.load_options.c_str());
+	std::printf("%s\n", load_message.c_str());
+	if (load_message != "Model loaded successfully.") return 1;
+
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) return 1;
+
+	// Replace a socket file left behind by a previous server
+	SOCKADDR_UN address = {};
+	address.sun_family = AF_UNIX;
+	if (options.socket_path.size() >= sizeof(address.sun_path)) {
+		std::printf("Socket path is too long: %s\n", options.socket_path.c_str());
+		return 1;
+	}
+	std::copy(options.socket_path.begin(), options.socket_path.end(), address.sun_path);
+	DeleteFileA(options.socket_path.c_str());
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET
+		|| bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+		|| listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+		std::printf("Unable to listen on %s (error %d)\n", options.socket_path.c_str(), WSAGetLastError());
+		return 1;
+	}
+	SetConsoleCtrlHandler(consoleHandler, TRUE);
+	std::printf("Listening on %s\n", options.socket_path.c_str());
+
+	// Serve each client on its own thread
+	std::vector<std::thread> client_threads;
+	int next_client_id = 0;
+	while (!stopping) {
+		SOCKET client = accept(listener, nullptr, nullptr);
+		if (client == INVALID_SOCKET) break;
+		{
+			std::lock_guard<std::mutex> lock(clients_mutex);
+			client_sockets.push_back(client);
+		}
+		client_threads.emplace_back(serveClient, client, next_client_id++, std::cref(options));
+	}
+
+	// Disconnect the remaining clients and wait for their frames to finish
+	{
+		std::lock_guard<std::mutex> lock(clients_mutex);
+		for (SOCKET client : client_sockets) shutdown(client, SD_BOTH);
+	}
+	for (std::thread& thread : client_threads) thread.join();
+
+	DeleteFileA(options.socket_path.c_str());
+	WSACleanup();
+	FreeResources();
+	return 0;
+}
@@ -0,0 +1,42 @@
+"""Compress an ONNX model into the LZ4 frame format the plugin loads directly.
+
+The frame records the decompressed size, so the plugin allocates the model buffer once, and a
+content checksum, so a damaged download fails to load instead of producing a broken session.
+Files written by the lz4 command-line tool also load, but without --content-size the plugin has
+to grow its buffer while decompressing.
+
+Example:
+    python compress_model.py yolox_tiny.onnx yolox_tiny.onnx.lz4 --level 9
+"""
+
+import argparse
+import os
+
+import lz4.frame
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="path of the ONNX model to compress")
+    parser.add_argument("output", help="path of the compressed model to write")
+    parser.add_argument("--level", type=int, default=9, help="compression level, 0 (fast) to 16 (high compression)")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as source:
+        data = source.read()
+
+    compressed = lz4.frame.compress(
+        data,
+        compression_level=args.level,
+        block_size=lz4.frame.BLOCKSIZE_MAX4MB,
+        content_checksum=True,
+        store_size=True,
+    )
+    with open(args.output, "wb") as target:
+        target.write(compressed)
+
+    print(f"{args.input}: {len(data) / 2**20:.1f} MB -> {os.path.getsize(args.output) / 2**20:.1f} MB")
+
+
+if __name__ == "__main__":
+    main()
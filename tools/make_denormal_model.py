@@ -0,0 +1,57 @@
+"""Generate a reference model whose activations stay in the float denormal range.
+
+The model scales its input into the denormal range and then runs a stack of 3x3 convolutions
+whose weights keep the activation magnitude roughly constant. On x86 CPUs, every multiply on a
+denormal operand takes a microcode assist, so this model shows the effect of the plugin's
+denormals_as_zero load option (see BenchmarkDenormalModes).
+
+Example:
+    python make_denormal_model.py denormal.onnx --width 320 --height 320
+"""
+
+import argparse
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper, numpy_helper
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output", help="path of the model to write")
+    parser.add_argument("--width", type=int, default=320)
+    parser.add_argument("--height", type=int, default=320)
+    parser.add_argument("--channels", type=int, default=16, help="channels in the hidden convolutions")
+    parser.add_argument("--layers", type=int, default=8, help="number of hidden convolutions")
+    args = parser.parse_args()
+
+    rng = np.random.default_rng(0)
+    initializers = [numpy_helper.from_array(np.array(1e-39, dtype=np.float32), "denormal_scale")]
+    nodes = [helper.make_node("Mul", ["images", "denormal_scale"], ["x0"])]
+
+    in_channels = 3
+    for layer in range(args.layers):
+        # Positive weights summing to ~1 per output keep activations near their input magnitude
+        fan_in = in_channels * 9
+        weight = rng.uniform(0.5, 1.5, (args.channels, in_channels, 3, 3)).astype(np.float32) / fan_in
+        initializers.append(numpy_helper.from_array(weight, f"w{layer}"))
+        nodes.append(helper.make_node("Conv", [f"x{layer}", f"w{layer}"], [f"x{layer + 1}"], pads=[1, 1, 1, 1]))
+        in_channels = args.channels
+
+    nodes.append(helper.make_node("Identity", [f"x{args.layers}"], ["output"]))
+    graph = helper.make_graph(
+        nodes,
+        "denormal_reference",
+        [helper.make_tensor_value_info("images", TensorProto.FLOAT, [1, 3, args.height, args.width])],
+        [helper.make_tensor_value_info("output", TensorProto.FLOAT, [1, args.channels, args.height, args.width])],
+        initializers,
+    )
+    model = helper.make_model(graph, opset_imports=[helper.make_opsetid("", 13)])
+    model.ir_version = 8
+    onnx.checker.check_model(model)
+    onnx.save(model, args.output)
+    print(f"Wrote {args.output}")
+
+
+if __name__ == "__main__":
+    main()
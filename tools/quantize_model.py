@@ -0,0 +1,189 @@
+"""Quantize an ONNX model to int8 using frames recorded with the plugin's StartCapture.
+
+The script
+  1. reads frames from one or more capture files and preprocesses them exactly like the plugin,
+  2. optionally rewrites the model to take uint8 CHW input (Cast + Mul(1/255) in the graph),
+     so the plugin feeds bytes from preprocessing directly,
+  3. runs static quantization (QDQ or QOperator format) calibrated on the frames, and
+  4. benchmarks the fp32 and int8 models on the CPU for latency and output drift.
+
+Example:
+    python quantize_model.py model.onnx model-int8.onnx --captures scene1.cap scene2.cap --uint8-input
+"""
+
+import argparse
+import struct
+import tempfile
+import time
+from pathlib import Path
+
+import numpy as np
+import onnx
+import onnxruntime as ort
+from onnx import TensorProto, helper, numpy_helper
+from onnxruntime.quantization import CalibrationDataReader, QuantFormat, QuantType, quantize_static
+
+CAPTURE_MAGIC = b"OCVC"
+CAPTURE_VERSION = 2  # Version 2 added the load options string to load records
+RECORD_LOAD = 1
+RECORD_FRAME = 2
+
+
+def read_capture_frames(path):
+    """Yield (width, height, HWC uint8 frame) for every frame record in a capture file."""
+    with open(path, "rb") as file:
+        magic, version = struct.unpack("<4sI", file.read(8))
+        if magic != CAPTURE_MAGIC or version not in (1, CAPTURE_VERSION):
+            raise ValueError(f"{path} is not a version 1 or {CAPTURE_VERSION} capture file")
+
+        width = height = None
+        while True:
+            header = file.read(9)
+            if len(header) < 9:
+                return
+            record_type, _timestamp_ns = struct.unpack("<BQ", header)
+
+            if record_type == RECORD_LOAD:
+                for _ in range(2):  # model path, execution provider
+                    (length,) = struct.unpack("<I", file.read(4))
+                    file.read(length)
+                width, height = struct.unpack("<ii", file.read(8))
+                if version >= 2:  # load options
+                    (length,) = struct.unpack("<I", file.read(4))
+                    file.read(length)
+            elif record_type == RECORD_FRAME:
+                _output_length, byte_count = struct.unpack("<iI", file.read(8))
+                data = file.read(byte_count)
+                if width is None or len(data) != width * height * 3:
+                    raise ValueError(f"{path} has a frame that does not match its load record")
+                yield width, height, np.frombuffer(data, dtype=np.uint8).reshape(height, width, 3)
+            else:
+                raise ValueError(f"{path} has an unknown record type {record_type}")
+
+
+def preprocess(frame, uint8_input):
+    """Match the plugin's preprocessing: HWC -> NCHW, normalized to [0, 1] unless the model takes uint8."""
+    chw = np.ascontiguousarray(frame.transpose(2, 0, 1))[np.newaxis]
+    return chw if uint8_input else chw.astype(np.float32) / 255.0
+
+
+def load_frames(captures, max_frames):
+    frames = []
+    for capture in captures:
+        for _width, _height, frame in read_capture_frames(capture):
+            frames.append(frame)
+            if len(frames) >= max_frames:
+                return frames
+    if not frames:
+        raise ValueError("The capture files contain no frames")
+    return frames
+
+
+def add_uint8_input(model_path, output_path):
+    """Replace the model's float input with a uint8 input followed by Cast and Mul(1/255)."""
+    model = onnx.load(model_path)
+    graph = model.graph
+    original = graph.input[0]
+    name = original.name
+
+    uint8_input = onnx.ValueInfoProto()
+    uint8_input.CopyFrom(original)
+    uint8_input.name = f"{name}_uint8"
+    uint8_input.type.tensor_type.elem_type = TensorProto.UINT8
+
+    scale = numpy_helper.from_array(np.array(1.0 / 255.0, dtype=np.float32), f"{name}_scale")
+    cast = helper.make_node("Cast", [uint8_input.name], [f"{name}_float"], to=TensorProto.FLOAT)
+    normalize = helper.make_node("Mul", [f"{name}_float", scale.name], [name])
+
+    graph.input.remove(original)
+    graph.input.insert(0, uint8_input)
+    graph.initializer.append(scale)
+    graph.node.insert(0, normalize)
+    graph.node.insert(0, cast)
+    onnx.save(model, output_path)
+
+
+class FrameReader(CalibrationDataReader):
+    def __init__(self, input_name, frames, uint8_input):
+        self.input_name = input_name
+        self.frames = iter(frames)
+        self.uint8_input = uint8_input
+
+    def get_next(self):
+        frame = next(self.frames, None)
+        return None if frame is None else {self.input_name: preprocess(frame, self.uint8_input)}
+
+
+def benchmark(fp32_path, int8_path, frames, uint8_input, runs):
+    """Compare latency and output drift between the fp32 and int8 models on the CPU."""
+    fp32 = ort.InferenceSession(str(fp32_path), providers=["CPUExecutionProvider"])
+    int8 = ort.InferenceSession(str(int8_path), providers=["CPUExecutionProvider"])
+
+    def timed(session, inputs):
+        name = session.get_inputs()[0].name
+        session.run(None, {name: inputs[0]})  # warm up
+        times, outputs = [], []
+        for _ in range(runs):
+            for data in inputs:
+                start = time.perf_counter()
+                session.run(None, {name: data})
+                times.append((time.perf_counter() - start) * 1000.0)
+        for data in inputs:
+            outputs.append(session.run(None, {name: data})[0].astype(np.float32).ravel())
+        return np.array(times), outputs
+
+    fp32_times, fp32_outputs = timed(fp32, [preprocess(f, False) for f in frames])
+    int8_times, int8_outputs = timed(int8, [preprocess(f, uint8_input) for f in frames])
+
+    abs_diff = np.concatenate([np.abs(a - b) for a, b in zip(fp32_outputs, int8_outputs)])
+    cosine = np.mean([
+        float(np.dot(a, b) / (np.linalg.norm(a) * np.linalg.norm(b) + 1e-12))
+        for a, b in zip(fp32_outputs, int8_outputs)
+    ])
+
+    print(f"{'model':<6} {'mean ms':>9} {'p50 ms':>9} {'p90 ms':>9}")
+    for label, times in (("fp32", fp32_times), ("int8", int8_times)):
+        print(f"{label:<6} {times.mean():9.3f} {np.percentile(times, 50):9.3f} {np.percentile(times, 90):9.3f}")
+    print(f"speedup (p50): {np.percentile(fp32_times, 50) / np.percentile(int8_times, 50):.2f}x")
+    print(f"output drift: max abs {abs_diff.max():.6f}, mean abs {abs_diff.mean():.6f}, mean cosine similarity {cosine:.6f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("model", type=Path, help="fp32 ONNX model")
+    parser.add_argument("output", type=Path, help="path of the quantized model to write")
+    parser.add_argument("--captures", nargs="+", required=True, help="capture files recorded with StartCapture")
+    parser.add_argument("--max-frames", type=int, default=200, help="maximum number of calibration frames")
+    parser.add_argument("--format", choices=["qdq", "qoperator"], default="qdq", help="quantized model format")
+    parser.add_argument("--per-channel", action="store_true", help="quantize weights per channel")
+    parser.add_argument("--uint8-input", action="store_true", help="make the quantized model take uint8 CHW input")
+    parser.add_argument("--benchmark-frames", type=int, default=20, help="frames used for the fp32/int8 comparison")
+    parser.add_argument("--benchmark-runs", type=int, default=5, help="passes over the benchmark frames")
+    args = parser.parse_args()
+
+    frames = load_frames(args.captures, args.max_frames)
+    print(f"Loaded {len(frames)} calibration frames")
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        source = args.model
+        if args.uint8_input:
+            source = Path(temp_dir) / "uint8_input.onnx"
+            add_uint8_input(args.model, source)
+
+        input_name = onnx.load(str(source)).graph.input[0].name
+        quantize_static(
+            str(source),
+            str(args.output),
+            FrameReader(input_name, frames, args.uint8_input),
+            quant_format=QuantFormat.QDQ if args.format == "qdq" else QuantFormat.QOperator,
+            activation_type=QuantType.QUInt8,
+            weight_type=QuantType.QInt8,
+            per_channel=args.per_channel,
+        )
+    print(f"Wrote {args.output}")
+
+    benchmark(args.model, args.output, frames[:args.benchmark_frames], args.uint8_input, args.benchmark_runs)
+
+
+if __name__ == "__main__":
+    main()